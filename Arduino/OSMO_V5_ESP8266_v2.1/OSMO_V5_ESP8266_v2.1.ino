@@ -1,5 +1,6 @@
 // LIBRERÍAS
 #include <ESP8266WiFi.h>
+#include <ESP8266mDNS.h>
 #include <PubSubClient.h>
 #include <ArduinoJson.h>
 
@@ -18,14 +19,47 @@ const int pumpPins[8] = {5, 4, 0, 2, 14, 12, 13, 15}; // pines donde están las
 bool pumpIsActive[8] = {false};
 unsigned long pumpStopTime[8] = {0};
 
-// Variable para gestionar el tiempo de reconexión a MQTT
-long lastReconnectAttempt = 0;
+// Variables para gestionar la reconexión a MQTT con backoff exponencial + jitter
+const unsigned long RECONNECT_BASE_MS = 1000;  // primer reintento
+const unsigned long RECONNECT_MAX_MS = 60000;  // tope entre reintentos
+unsigned long nextReconnectAttempt = 0;
+uint8_t reconnectFailures = 0;
+bool wasConnected = false;
+uint32_t jitterState = 0; // xorshift32 sembrado con el chip ID
+
+// Si mqtt_server deja de responder se busca el broker por mDNS (_mqtt._tcp)
+const uint8_t REDISCOVER_AFTER = 3;   // fallos seguidos antes de preguntar
+IPAddress discoveredBroker;           // último broker encontrado (se conserva hasta reiniciar)
+uint16_t discoveredPort = 0;
+bool mdnsStarted = false;
 // --------------------------------------------------------------------
 
 // Clientes de Red y MQTT
 WiFiClient espClient;
 PubSubClient client(espClient);
 
+// Generador pseudoaleatorio propio de la unidad: cada Osmo reintenta en
+// momentos distintos aunque todos pierdan el broker a la vez
+uint32_t nextJitter() {
+  uint32_t x = jitterState;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  jitterState = x;
+  return x;
+}
+
+// Calcula la espera antes del próximo intento ("equal jitter": mitad fija + mitad aleatoria)
+unsigned long computeReconnectDelay() {
+  uint8_t shift = reconnectFailures < 16 ? reconnectFailures : 16;
+  unsigned long ceiling = RECONNECT_BASE_MS << shift;
+  if (ceiling > RECONNECT_MAX_MS) {
+    ceiling = RECONNECT_MAX_MS;
+  }
+  unsigned long half = ceiling / 2;
+  return half + nextJitter() % (half + 1);
+}
+
 // Función para procesar los comandos recibidos
 void processCommand(JsonObject doc) {
   const char* action = doc["action"];
@@ -92,19 +126,60 @@ void setup_wifi() {
   Serial.println(WiFi.localIP());
 }
 
+// Pregunta por _mqtt._tcp y apunta el cliente al primer broker que responda
+void rediscoverBroker() {
+  if (!mdnsStarted) {
+    // Nombre de host válido: sin '_' (osmo_norte -> osmo-norte)
+    char hostname[32];
+    strncpy(hostname, UNIT_ID, sizeof(hostname) - 1);
+    hostname[sizeof(hostname) - 1] = '\0';
+    for (char* c = hostname; *c; c++) {
+      if (*c == '_') *c = '-';
+    }
+    mdnsStarted = MDNS.begin(hostname);
+  }
+  int found = MDNS.queryService("mqtt", "tcp");
+  Serial.print("\n🔎 mDNS _mqtt._tcp: ");
+  Serial.println(found);
+  if (found > 0 && MDNS.IP(0).isSet()) {
+    discoveredBroker = MDNS.IP(0);
+    discoveredPort = MDNS.port(0);
+    client.setServer(discoveredBroker, discoveredPort);
+    Serial.print("📇 Broker ahora en ");
+    Serial.println(discoveredBroker);
+  }
+  MDNS.removeQuery();
+}
+
+// Se presenta en el topic común para que el director la registre
+void announce() {
+  char payload[160];
+  snprintf(payload, sizeof(payload), "{\"unit_id\":\"%s\",\"ip\":\"%s\",\"broker_source\":\"%s\"}",
+           UNIT_ID, WiFi.localIP().toString().c_str(), discoveredPort ? "mdns" : "config");
+  client.publish("motete/osmo/discovery", payload);
+}
+
 // Función para reconectar al Broker MQTT
 void reconnect() {
   Serial.print("Intentando conexión MQTT...");
   if (client.connect(UNIT_ID, mqtt_user, mqtt_password)) {
     Serial.println("✅ Conectado al Broker MQTT");
+    reconnectFailures = 0;
     char commandTopic[50];
     sprintf(commandTopic, "motete/director/commands/%s", UNIT_ID);
     client.subscribe(commandTopic);
     Serial.print("Suscrito a: ");
     Serial.println(commandTopic);
+    announce();
   } else {
     Serial.print("falló, rc=");
     Serial.print(client.state());
+    if (reconnectFailures < 255) {
+      reconnectFailures++;
+    }
+    if (reconnectFailures % REDISCOVER_AFTER == 0) {
+      rediscoverBroker();
+    }
   }
 }
 
@@ -119,20 +194,29 @@ void setup() {
   setup_wifi();
   client.setServer(mqtt_server, mqtt_port);
   client.setCallback(callback);
+
+  jitterState = ESP.getChipId() ^ 0x9E3779B9;
+  // Primer intento también desfasado: tras un corte de luz arrancan todos juntos
+  nextReconnectAttempt = millis() + nextJitter() % (RECONNECT_BASE_MS + 1);
 }
 
 void loop() {
   // --- LÓGICA DE RECONEXIÓN NO BLOQUEANTE ---
   if (!client.connected()) {
-    long now = millis();
-    // Intenta reconectar solo cada 5 segundos
-    if (now - lastReconnectAttempt > 5000) {
-      lastReconnectAttempt = now;
+    unsigned long now = millis();
+    if (wasConnected) {
+      // Conexión recién perdida: desfasar el primer reintento respecto del resto de la flota
+      wasConnected = false;
+      nextReconnectAttempt = now + computeReconnectDelay();
+    }
+    // Intenta reconectar cuando vence la espera con backoff
+    if ((long)(now - nextReconnectAttempt) >= 0) {
       Serial.println("Intentando reconexión MQTT...");
       reconnect(); // Intenta conectar una vez
+      nextReconnectAttempt = millis() + computeReconnectDelay();
     }
   } else {
-     Serial.println("conectado...");
+     wasConnected = true;
     // Solo procesa mensajes si está conectado
     client.loop();
   }
@@ -29,6 +29,21 @@ int aroma2 = 4;
 int aroma3 = 5;
 //const int pulsoTiempo= 5000;
 const uint32_t TiempoEsperaWifi = 5000;
+const uint32_t TiempoEsperaDirecto = 1500;  // Intento directo al último AP antes de escanear
+//--Último AP bueno: sobrevive a reset y brownout (no a un corte de energía)--//
+struct WifiGuardado {
+  uint32_t firma;
+  uint8_t red;       // 0 = ssid_1, 1 = ssid_2
+  uint8_t canal;
+  uint8_t bssid[6];
+};
+const uint32_t FirmaWifi = 0x57494649;  // "WIFI"
+#if defined(ESP32)
+RTC_DATA_ATTR WifiGuardado wifiGuardado;
+#else
+WifiGuardado wifiGuardado;
+const uint32_t OffsetRtcWifi = 32;  // Bloques de 4 bytes; los primeros 128 bytes son de eboot (OTA)
+#endif
 // Variables para almacenar el tiempo de activación de cada botón
 unsigned long tiempoInicio1 = 0;
 unsigned long tiempoInicio2 = 0;
@@ -111,6 +126,55 @@ void setTiempo3() {
   server.send(200, "text/plain", "Tiempo AROMA 3: " + String(tiempoActivacion3 / 1000) + "s");
 }
 /////////////////////////////////////
+//--Conexión rápida: canal y BSSID guardados, sin escanear--//
+uint32_t firmaWifi(const WifiGuardado& w) {
+  uint32_t firma = FirmaWifi ^ ((uint32_t)w.red << 8) ^ w.canal;
+  for (int i = 0; i < 6; i++) {
+    firma = (firma << 5) ^ (firma >> 27) ^ w.bssid[i];
+  }
+  return firma;
+}
+
+bool leerWifiGuardado() {
+#if defined(ESP8266)
+  if (!ESP.rtcUserMemoryRead(OffsetRtcWifi, (uint32_t*)&wifiGuardado, sizeof(wifiGuardado))) {
+    return false;
+  }
+#endif
+  return wifiGuardado.firma == firmaWifi(wifiGuardado) && wifiGuardado.red < 2 &&
+         wifiGuardado.canal >= 1 && wifiGuardado.canal <= 14;
+}
+
+void guardarWifi() {
+  wifiGuardado.red = (WiFi.SSID() == ssid_1) ? 0 : 1;
+  wifiGuardado.canal = WiFi.channel();
+  memcpy(wifiGuardado.bssid, WiFi.BSSID(), sizeof(wifiGuardado.bssid));
+  wifiGuardado.firma = firmaWifi(wifiGuardado);
+#if defined(ESP8266)
+  ESP.rtcUserMemoryWrite(OffsetRtcWifi, (uint32_t*)&wifiGuardado, sizeof(wifiGuardado));
+#endif
+}
+
+bool conectarDirecto() {
+  if (!leerWifiGuardado()) {
+    return false;
+  }
+  const char* ssid = wifiGuardado.red == 0 ? ssid_1 : ssid_2;
+  const char* password = wifiGuardado.red == 0 ? password_1 : password_2;
+  WiFi.begin(ssid, password, wifiGuardado.canal, wifiGuardado.bssid);
+  uint32_t inicio = millis();
+  while (WiFi.status() != WL_CONNECTED && millis() - inicio < TiempoEsperaDirecto) {
+    delay(10);
+  }
+  if (WiFi.status() == WL_CONNECTED) {
+    return true;
+  }
+  //--El AP cambió de canal o no está: se descarta y se escanea--//
+  wifiGuardado.firma = 0;
+  WiFi.disconnect();
+  return false;
+}
+/////////////////////////////////////
 void setup() {
   //--Iniciando multiwifi--//
   Serial.begin(9600);
@@ -131,11 +195,18 @@ void setup() {
               IPAddress(192, 168, 0, 1),      // Dirección IP de la puerta de enlace (router)
               IPAddress(255, 255, 255, 0));   // Máscara de subred (comúnmente 255.255.255.0)
   Serial.print("Conectando a Wifi ..");
-  //--Damos tiempo para conectar--//
-  while (wifiMulti.run(TiempoEsperaWifi) != WL_CONNECTED) {
-    Serial.print(".");
+  uint32_t inicioWifi = millis();
+  //--Primero directo al último AP; si falla, escaneo con multiwifi--//
+  bool directo = conectarDirecto();
+  if (!directo) {
+    while (wifiMulti.run(TiempoEsperaWifi) != WL_CONNECTED) {
+      Serial.print(".");
+    }
   }
-  Serial.println(".. Conectado");
+  guardarWifi();
+  Serial.print(".. Conectado en ");
+  Serial.print(millis() - inicioWifi);
+  Serial.println(directo ? " ms (directo)" : " ms");
   Serial.print("SSID: ");
   Serial.print(WiFi.SSID());
   Serial.print(" ID: ");
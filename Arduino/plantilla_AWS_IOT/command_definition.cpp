@@ -292,7 +292,7 @@ bool processCommand(const MQTTCommand& cmd) {
         
         // Aquí se integrará con StatusPublisher
         // String status = statusPublisher.createStatusJSON();
-        // networkManager.publishWithQoS(statusTopic, status.c_str(), 1);
+        // networkManager.enqueue(PublishClass::Status, statusTopic, status.c_str());
         
         return true;
     }
@@ -85,7 +85,8 @@ gqMQXA5NbVXka2bcVGzCJFMx2i8tJ4kZHfwgB4Az6fMCsxiG/bZ8rQ==
 )EOF",
     .qos = 1,
     .keepAlive = 60,
-    .cleanSession = true
+    .cleanSession = true,
+    .connectByCachedIP = false  // true solo para brokers de prueba sin SNI (Mosquitto local)
 };
 
 MQTTConfig mqttConfig = {
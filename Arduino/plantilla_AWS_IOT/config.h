@@ -18,6 +18,7 @@ struct AWSConfig {
     int qos;                    // QoS por defecto
     int keepAlive;              // Tiempo en segundos entre mensajes de "estoy vivo"
     bool cleanSession;          // Si es true, el broker olvida la sesión anterior al reconectar
+    bool connectByCachedIP;     // Conectar a la IP resuelta: BearSSL no manda SNI ni valida el nombre; AWS exige SNI: dejar en false
 };
 
 // Configuración MQTT (mantener para compatibilidad)
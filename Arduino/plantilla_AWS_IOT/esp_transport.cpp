@@ -0,0 +1,31 @@
+#include "esp_transport.h"
+
+#ifndef OSMO_HOST_BUILD
+
+void EspTcpTransport::setConnectTimeout(unsigned long timeoutMs) {
+    wifiClient.setTimeout(timeoutMs);
+}
+
+void EspTlsTransport::setConnectTimeout(unsigned long timeoutMs) {
+    secureClient.setTimeout(timeoutMs);
+}
+
+void EspTlsTransport::setClientCertificate(const BearSSL::X509List* cert, const BearSSL::PrivateKey* key) {
+    if (key->isEC()) {
+        secureClient.setClientECCert(cert, key, BR_KEYTYPE_KEYX | BR_KEYTYPE_SIGN, BR_KEYTYPE_EC);
+    } else {
+        secureClient.setClientRSACert(cert, key);
+    }
+}
+
+void EspTlsTransport::useEcdheSuites() {
+    static const uint16_t suites[] = {
+        BR_TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256,
+        BR_TLS_ECDHE_ECDSA_WITH_CHACHA20_POLY1305_SHA256,
+        BR_TLS_ECDHE_RSA_WITH_AES_128_GCM_SHA256,   // Servidores con certificado RSA
+        BR_TLS_ECDHE_RSA_WITH_CHACHA20_POLY1305_SHA256
+    };
+    secureClient.setCiphers(suites, sizeof(suites) / sizeof(suites[0]));
+}
+
+#endif
@@ -1,6 +1,7 @@
 #include "main_controller.h"
 #include "pump_controller.h"
 #include "status_publisher.h"
+#include "topic_table.h"
 #include <Arduino.h>
 #include <ArduinoJson.h>
 // Inicializar la variable estática
@@ -23,6 +24,10 @@ void MainController::initialize() {
     Serial.begin(115200);
     delay(8000);
     Serial.println("🚀 Iniciando sistema...");
+    // Los topics se arman una sola vez; los publicadores solo usan punteros
+    if (topicTable.build(deviceConfig.unitId, awsConfig.thingName)) {
+        Serial.println("✅ Topics construidos");
+    }
     Serial.println("📌 Paso 1: Configurando LED...");
     // Configurar LED indicador
     pinMode(2, OUTPUT);
@@ -35,6 +40,8 @@ void MainController::initialize() {
     Serial.println("📌 Paso 3: Configurando callback MQTT...");
     networkManager.setCallback(messageCallback);
     Serial.println("✅ Callback MQTT configurado");
+    Serial.println("📌 Paso 4: Iniciando conexión (no bloqueante)...");
+    networkManager.connect();
     Serial.println("✅ Sistema iniciado completamente"); 
     
     
@@ -218,41 +225,17 @@ void MainController::publishStatus() {
 void MainController::sendCommandResponse(const CommandResponse& response) {
     String responseJSON = createResponseJSON(response);
     
-    // Publicar respuesta en topic simple (sin Device Shadow)
-    char topic[100];
-    sprintf(topic, "motete/osmo/%s/response", deviceConfig.unitId);
-    
-    Serial.print("📤 Intentando enviar respuesta a AWS IoT Core: ");
-    Serial.println(response.message);
-    
-    // Probar con método simple primero
-    if (networkManager.publish(topic, responseJSON.c_str())) {
-        Serial.print("✅ Respuesta enviada a AWS IoT Core: ");
+    // Publicar respuesta en topic simple (sin Device Shadow); nunca se descarta de la cola
+    if (networkManager.enqueue(PublishClass::Response, topicTable.get(Topic::Response), responseJSON.c_str())) {
+        Serial.print("📤 Respuesta encolada: ");
         Serial.println(response.message);
     } else {
-        Serial.println("❌ Error con método simple, intentando QoS 0...");
-        if (networkManager.publishWithQoS(topic, responseJSON.c_str(), 0)) {
-            Serial.print("✅ Respuesta enviada a AWS IoT Core (QoS 0): ");
-            Serial.println(response.message);
-        } else {
-            Serial.println("❌ Error al enviar respuesta a AWS IoT Core");
-        }
+        Serial.println("❌ Error al enviar respuesta a AWS IoT Core");
     }
 }
 
 void MainController::loop() {
-    static bool firstConnection = true;  
-    
-    if (firstConnection) {
-        Serial.println(" Intentando primera conexión...");
-        if (networkManager.connect()) {
-            Serial.println("✅ Primera conexión exitosa");
-        } else {
-            Serial.println("❌ Primera conexión fallida - reintentando en loop");
-        }
-        firstConnection = false;
-    }
-    
+    // Avanza un paso de la conexión; nunca bloquea más que un intento de connect
     networkManager.loop();
     
     // Configuración inicial de bombas (una sola vez después de conectar)
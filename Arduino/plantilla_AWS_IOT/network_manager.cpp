@@ -1,70 +1,127 @@
 #include "network_manager.h"
+#include "topic_table.h"
 #include <ArduinoJson.h>
 #include <time.h>
+#include <lwip/dns.h>
+
+// Tiempos de la máquina de estados de conexión
+namespace {
+    const unsigned long WIFI_CONNECT_TIMEOUT = 20000;  // ms antes de reiniciar WiFi.begin
+    const unsigned long WIFI_DIRECTED_TIMEOUT = 4000;  // ms del intento directo (asociación + DHCP) antes de escanear
+    const unsigned long NTP_SYNC_TIMEOUT = 10000;      // ms esperando la hora
+    const unsigned long DNS_TIMEOUT = 10000;           // ms esperando al DNS antes de reintentar
+    const unsigned long MQTT_BACKOFF_BASE = 5000;      // ms del primer reintento (TLS es caro)
+    const unsigned long MQTT_BACKOFF_MAX = 120000;     // ms máximo entre reintentos
+    const time_t MIN_VALID_TIME = 8 * 3600 * 2;        // Antes de esto la hora no es válida
+    // Buffers TLS/MQTT: se negocia MFLN para no pagar 16 KB de recepción
+    const uint16_t TLS_FRAGMENT = 1024;       // Fragmento pedido: entra el estado completo
+    const uint16_t TLS_RX_NO_MFLN = 16384;    // Sin MFLN el servidor puede mandar registros de 16 KB
+    const uint16_t TLS_RX_LOW_HEAP = 4096;    // Si no hay bloque libre para 16 KB
+    const uint32_t HEAP_MARGIN = 8192;        // Heap que debe quedar libre tras los buffers
+    const uint16_t MQTT_PACKET_OVERHEAD = 7;  // Cabecera fija + largo del topic
+    const uint8_t DRAIN_BUDGET = 4;           // Publicaciones por tick de red
+}
 
 // Función para sincronizar tiempo con NTP (necesario para TLS)
 void NetworkManager::setCurrentTime() {
     Serial.println("Sincronizando tiempo con NTP...");
     configTime(0, 0, "pool.ntp.org", "time.nist.gov");
-    
-    Serial.print("Esperando sincronización NTP");
+    setState(ConnectionState::TimeSyncing);
+}
+
+// Espera de NTP sin bloquear: se consulta una vez por iteración de loop()
+void NetworkManager::pollTime() {
     time_t now = time(nullptr);
-    int attempts = 0;
-    while (now < 8 * 3600 * 2 && attempts < 20) {
-        delay(500);
-        Serial.print(".");
-        now = time(nullptr);
-        attempts++;
-    }
-    Serial.println();
-    
-    if (now < 8 * 3600 * 2) {
-        Serial.println("ERROR: No se pudo sincronizar el tiempo!");
-    } else {
+    if (now >= MIN_VALID_TIME) {
         struct tm timeinfo;
         gmtime_r(&now, &timeinfo);
         Serial.print("Tiempo sincronizado: ");
         Serial.println(asctime(&timeinfo));
+        nextMQTTAttempt = millis() + backoff.initialDelay();
+        setState(ConnectionState::MqttWaiting);
+        return;
     }
-} 
+    
+    if (millis() - stateSince > NTP_SYNC_TIMEOUT) {
+        // Se intenta igual: el handshake fallará si el certificado no valida
+        Serial.println("ERROR: No se pudo sincronizar el tiempo!");
+        nextMQTTAttempt = millis() + backoff.initialDelay();
+        setState(ConnectionState::MqttWaiting);
+    }
+}
 
-NetworkManager::NetworkManager() : mqttClient(espClient), isConnected(false) {
+NetworkManager::NetworkManager()
+    : mqttClient(transport.client()), isConnected(false),
+      state(ConnectionState::WiFiIdle), stateSince(0), nextMQTTAttempt(0), attemptCount(0),
+      backoff(MQTT_BACKOFF_BASE, MQTT_BACKOFF_MAX), dnsPending(false), dnsAnswered(false), dnsStartedAt(0),
+      mflnProbed(false), tlsBuffersSized(false), mflnSupported(false), tlsRxSize(0), tlsTxSize(0), mqttBufferSize(0),
+      wifiDirected(false) {
     // Configurar certificados para AWS IoT Core (ESP8266 Core 3.1.2+)
     // Crear objetos X509List y PrivateKey desde strings
     static X509List caCert(awsConfig.caCert);
     static X509List deviceCert(awsConfig.deviceCert);
     static PrivateKey privateKey(awsConfig.privateKey);
     
-    // CRÍTICO: Configurar buffers BearSSL para ESP8266
-    espClient.setBufferSizes(256, 256); // rx_buffer, tx_buffer (reducidos)
+    // Los buffers BearSSL y de PubSubClient se dimensionan al primer intento (sizeTlsBuffers)
     
-    espClient.setTrustAnchors(&caCert);
-    espClient.setClientRSACert(&deviceCert, &privateKey);
+    transport.tls().setTrustAnchors(&caCert);
+    // Certificado RSA o ECDSA según la clave; ECDSA abarata el handshake
+    transport.setClientCertificate(&deviceCert, &privateKey);
+    transport.useEcdheSuites();
+    // Reconexiones con reanudación de sesión en lugar del handshake completo
+    transport.enableSessionCache();
     
     // Configurar servidor AWS IoT Core
     mqttClient.setServer(awsConfig.endpoint, awsConfig.port);
     
-    // CRÍTICO: Configurar buffer y timeout de PubSubClient
-    mqttClient.setBufferSize(256); // Reducido para ahorrar memoria
-    mqttClient.setSocketTimeout(15);
+    // CRÍTICO: Configurar timeout de PubSubClient
+    mqttClient.setSocketTimeout(5); // Acota cuánto bloquea un intento
     mqttClient.setKeepAlive(60); // Keep-alive de 60 segundos
 }
 
-void NetworkManager::setupWiFi() {
-    Serial.print("Conectando a WiFi...");
-    
-    WiFi.begin(wifiConfig.ssid, wifiConfig.password);
-    
-    // TIMEOUT de 20 segundos
-    unsigned long startTime = millis();
-    while (WiFi.status() != WL_CONNECTED && (millis() - startTime) < 20000) {
-        delay(500);
-        yield();
-        Serial.print(".");
+const char* NetworkManager::stateName(ConnectionState s) {
+    switch (s) {
+        case ConnectionState::WiFiIdle: return "WiFiIdle";
+        case ConnectionState::WiFiConnecting: return "WiFiConnecting";
+        case ConnectionState::TimeSyncing: return "TimeSyncing";
+        case ConnectionState::MqttWaiting: return "MqttWaiting";
+        case ConnectionState::MqttConnected: return "MqttConnected";
+    }
+    return "UNKNOWN";
+}
+
+void NetworkManager::setState(ConnectionState newState) {
+    if (state == newState) {
+        return;
     }
+    Serial.print("🔀 Red: ");
+    Serial.print(stateName(state));
+    Serial.print(" -> ");
+    Serial.println(stateName(newState));
+    state = newState;
+    stateSince = millis();
+}
+
+void NetworkManager::startWiFi() {
+    WiFi.persistent(false);  // Sin escribir credenciales en flash en cada begin
+    WiFi.mode(WIFI_STA);
     
+    // Con un AP guardado: canal y BSSID fijos (sin escaneo); la IP, por DHCP
+    wifiDirected = wifiCache.load(wifiConfig.ssid);
+    if (wifiDirected) {
+        Serial.printf("Conectando a WiFi (directo, canal %d)...\n", wifiCache.getChannel());
+        WiFi.begin(wifiConfig.ssid, wifiConfig.password, wifiCache.getChannel(), wifiCache.getBssid());
+    } else {
+        Serial.println("Conectando a WiFi...");
+        WiFi.begin(wifiConfig.ssid, wifiConfig.password);
+    }
+    setState(ConnectionState::WiFiConnecting);
+}
+
+void NetworkManager::pollWiFi() {
     if (WiFi.status() == WL_CONNECTED) {
-        Serial.println("\n✅ WiFi conectado");
+        Serial.printf("✅ WiFi conectado en %lu ms%s\n", millis() - stateSince, wifiDirected ? " (directo)" : "");
+        rememberAccessPoint();
         Serial.print("IP: ");
         Serial.println(WiFi.localIP());
         Serial.print("RSSI: ");
@@ -73,93 +130,220 @@ void NetworkManager::setupWiFi() {
         
         // CRÍTICO: Sincronizar tiempo con NTP (necesario para TLS)
         setCurrentTime();
+        return;
+    }
+    
+    // El AP cambió de canal o se apagó: escaneo normal
+    if (wifiDirected && millis() - stateSince > WIFI_DIRECTED_TIMEOUT) {
+        Serial.println("⚠️ Conexión directa falló, escaneando");
+        wifiCache.invalidate();
+        wifiDirected = false;
+        WiFi.disconnect();
+        setState(ConnectionState::WiFiIdle);
+        return;
+    }
+    
+    if (millis() - stateSince > WIFI_CONNECT_TIMEOUT) {
+        Serial.println("❌ Timeout WiFi - reintentando");
+        WiFi.disconnect();
+        setState(ConnectionState::WiFiIdle);
+    }
+}
+
+// Guarda el AP para el próximo arranque
+void NetworkManager::rememberAccessPoint() {
+    wifiCache.save(wifiConfig.ssid, WiFi.BSSID(), WiFi.channel());
+}
+
+// El callback de lwIP corre entre vueltas de loop(): no hay concurrencia real
+struct BrokerDnsCallback {
+    static void found(const char* name, const ip_addr_t* ipaddr, void* arg) {
+        (void)name;
+        NetworkManager* self = (NetworkManager*)arg;
+        if (!self->dnsPending) {
+            return;  // Respuesta de una consulta que ya venció
+        }
+        self->dnsPending = false;
+        self->dnsAnswered = true;
+        self->brokerIP = ipaddr ? IPAddress(*ipaddr) : IPAddress();
+    }
+};
+
+// Resuelve el endpoint sin bloquear. Con la respuesta en la tabla DNS de lwIP
+// se conecta por nombre: el hostByName interno de WiFiClientSecure la encuentra
+// ahí y no espera. Por IP no se puede: connect(IPAddress) de BearSSL no manda
+// SNI ni valida el nombre del certificado, y AWS exige SNI.
+NetworkManager::DnsResult NetworkManager::resolveBroker() {
+    if (dnsPending) {
+        if (millis() - dnsStartedAt < DNS_TIMEOUT) {
+            return DnsResult::Pending;
+        }
+        dnsPending = false;  // Si contesta tarde, el callback la ignora
+    } else if (dnsAnswered) {
+        dnsAnswered = false;
+        if (brokerIP.isSet()) {
+            Serial.printf("🌐 Endpoint resuelto a %s en %lu ms\n", brokerIP.toString().c_str(), millis() - dnsStartedAt);
+            if (awsConfig.connectByCachedIP) {
+                mqttClient.setServer(brokerIP, awsConfig.port);
+            }
+            return DnsResult::Ready;
+        }
+    } else {
+        ip_addr_t addr;
+        dnsStartedAt = millis();
+        dnsPending = true;
+        err_t err = dns_gethostbyname(awsConfig.endpoint, &addr, BrokerDnsCallback::found, this);
+        if (err == ERR_OK) {
+            // Todavía vigente en la tabla de lwIP (TTL del registro)
+            dnsPending = false;
+            brokerIP = IPAddress(addr);
+            if (awsConfig.connectByCachedIP) {
+                mqttClient.setServer(brokerIP, awsConfig.port);
+            }
+            return DnsResult::Ready;
+        }
+        if (err == ERR_INPROGRESS) {
+            return DnsResult::Pending;
+        }
+        dnsPending = false;
+    }
+    Serial.println("❌ No se pudo resolver el endpoint");
+    return DnsResult::Failed;
+}
+
+// Pregunta al servidor por Max Fragment Length y dimensiona los buffers TLS y
+// MQTT según lo que acepte. El probe abre una conexión aparte y bloquea un
+// handshake entero: se hace una sola vez por arranque (el endpoint es fijo).
+// Solo un registro más grande que el buffer obliga a redimensionar.
+void NetworkManager::sizeTlsBuffers() {
+    if (tlsBuffersSized) {
+        return;
+    }
+    if (!mflnProbed) {
+        mflnSupported = WiFiClientSecure::probeMaxFragmentLength(awsConfig.endpoint, awsConfig.port, TLS_FRAGMENT);
+        mflnProbed = true;
+    }
+    
+    if (mflnSupported) {
+        tlsRxSize = TLS_FRAGMENT;
+        tlsTxSize = TLS_FRAGMENT;
     } else {
-        Serial.println("\n❌ Timeout WiFi - continuando sin conexión");
+        // Sin MFLN: recepción de 16 KB si el heap lo permite; si no, 4 KB y se
+        // confía en que el servidor mande registros chicos (MQTT lo hace)
+        tlsTxSize = TLS_FRAGMENT;
+        tlsRxSize = ESP.getMaxFreeBlockSize() > (uint32_t)TLS_RX_NO_MFLN + tlsTxSize + HEAP_MARGIN
+                        ? TLS_RX_NO_MFLN : TLS_RX_LOW_HEAP;
     }
+    transport.tls().setBufferSizes(tlsRxSize, tlsTxSize);
+    
+    // El paquete MQTT entra en un fragmento: el estado completo ya no falla en silencio
+    mqttBufferSize = TLS_FRAGMENT;
+    mqttClient.setBufferSize(mqttBufferSize);
+    tlsBuffersSized = true;
+    
+    Serial.printf("📐 MFLN %s: TLS rx=%u tx=%u, buffer MQTT=%u (heap libre %u)\n",
+                  mflnSupported ? "negociado" : "no soportado",
+                  tlsRxSize, tlsTxSize, mqttBufferSize, ESP.getFreeHeap());
 }
 
-void NetworkManager::setupMQTT() {
-    Serial.println("🔐 Configurando conexión AWS IoT Core...");
-    Serial.print("Endpoint: ");
-    Serial.println(awsConfig.endpoint);
-    Serial.print("Puerto: ");
-    Serial.println(awsConfig.port);
-    Serial.print("Thing Name: ");
-    Serial.println(awsConfig.thingName);
-    Serial.print("Memoria libre: ");
-    Serial.println(ESP.getFreeHeap());
+// Un único intento de conexión a AWS IoT Core; el reintento lo agenda loop()
+void NetworkManager::attemptMQTT() {
+    switch (resolveBroker()) {
+        case DnsResult::Pending:
+            return;  // loop() vuelve a llamar mientras espera la respuesta
+        case DnsResult::Failed:
+            scheduleRetry();
+            return;
+        case DnsResult::Ready:
+            break;
+    }
     
-    // Verificar conectividad TCP
-    Serial.print("Probando conectividad TCP a ");
+    attemptCount++;
+    Serial.print("Intento #");
+    Serial.print(attemptCount);
+    Serial.print(" - Conectando a AWS IoT Core (");
     Serial.print(awsConfig.endpoint);
     Serial.print(":");
-    Serial.println(awsConfig.port);
+    Serial.print(awsConfig.port);
+    Serial.print(", memoria libre: ");
+    Serial.print(ESP.getFreeHeap());
+    Serial.print(")...");
     
-    WiFiClient testClient;
-    if (testClient.connect(awsConfig.endpoint, awsConfig.port)) {
-        Serial.println("✅ Conectividad TCP exitosa");
-        testClient.stop();
-    } else {
-        Serial.println("❌ Error de conectividad TCP");
-    }
+    sizeTlsBuffers();
     
-    unsigned long startTime = millis();
-    int attemptCount = 0;
+    // Medición del handshake (con sesión reanudada debería bajar mucho)
+    unsigned long handshakeStart = millis();
+    uint32_t heapBefore = ESP.getFreeHeap();
     
-    while (!mqttClient.connected() && (millis() - startTime) < 30000) {  // 30 segundos timeout
-        attemptCount++;
-        Serial.print("Intento #");
-        Serial.print(attemptCount);
-        Serial.print(" - Conectando a AWS IoT Core...");
+    // AWS IoT Core no requiere usuario/contraseña, solo certificados
+    // Probar con Client ID más simple
+    bool connected = mqttClient.connect("ESP82_Client");
+    Serial.printf("⏱️ Handshake TLS+MQTT: %lu ms, heap %u -> %u, bloque máx %u\n",
+                  millis() - handshakeStart, heapBefore, ESP.getFreeHeap(), ESP.getMaxFreeBlockSize());
+    
+    if (connected) {
+        Serial.println("✅ AWS IoT Core conectado");
+        isConnected = true;
+        backoff.reset();
+        attemptCount = 0;
+        setState(ConnectionState::MqttConnected);
         
-        // AWS IoT Core no requiere usuario/contraseña, solo certificados
-        // Probar con Client ID más simple
-        if (mqttClient.connect("ESP82_Client")) {
-            Serial.println("✅ AWS IoT Core conectado");
-            isConnected = true;
-            
-            // Suscribirse solo a topics básicos (sin Device Shadow)
-            char commandTopic[100];
-            sprintf(commandTopic, "motete/director/commands/%s", deviceConfig.unitId);
-            Serial.print("Suscribiéndose a: ");
-            Serial.println(commandTopic);
-            subscribe(commandTopic);
-            
-            return;
-        } else {
-            int state = mqttClient.state();
-            Serial.print("❌ AWS IoT Core falló, rc=");
-            Serial.print(state);
-            Serial.print(" (");
-            
-            // Explicar códigos de error
-            switch(state) {
-                case -4: Serial.print("MQTT_CONNECTION_TIMEOUT"); break;
-                case -3: Serial.print("MQTT_CONNECTION_LOST"); break;
-                case -2: Serial.print("MQTT_CONNECT_FAILED"); break;
-                case -1: Serial.print("MQTT_DISCONNECTED"); break;
-                case 1: Serial.print("MQTT_CONNECT_BAD_PROTOCOL"); break;
-                case 2: Serial.print("MQTT_CONNECT_BAD_CLIENT_ID"); break;
-                case 3: Serial.print("MQTT_CONNECT_UNAVAILABLE"); break;
-                case 4: Serial.print("MQTT_CONNECT_BAD_CREDENTIALS"); break;
-                case 5: Serial.print("MQTT_CONNECT_UNAUTHORIZED"); break;
-                default: Serial.print("UNKNOWN_ERROR"); break;
-            }
-            Serial.println(")");
-            
-            delay(3000); // Aumentar delay entre intentos
-            yield();
-        }
+        // Suscribirse solo a topics básicos (sin Device Shadow)
+        const char* commandTopic = topicTable.get(Topic::Commands);
+        Serial.print("Suscribiéndose a: ");
+        Serial.println(commandTopic);
+        subscribe(commandTopic);
+        return;
+    }
+    
+    int rc = mqttClient.state();
+    // El servidor mandó un registro que no entra en el buffer de recepción: el
+    // fragmento negociado no se respetó o 4 KB no alcanzan. Se redimensiona
+    // sin MFLN (sin repetir el probe) en el próximo intento
+    if (transport.tls().getLastSSLError() == BR_ERR_TOO_LARGE) {
+        Serial.printf("📐 Registro TLS mayor que el buffer rx=%u: se redimensiona\n", tlsRxSize);
+        mflnSupported = false;
+        tlsBuffersSized = false;
     }
+    Serial.print("❌ AWS IoT Core falló, rc=");
+    Serial.print(rc);
+    Serial.print(" (");
     
-    if (!mqttClient.connected()) {
-        Serial.println("❌ Timeout AWS IoT Core - continuando sin conexión");
+    // Explicar códigos de error
+    switch(rc) {
+        case -4: Serial.print("MQTT_CONNECTION_TIMEOUT"); break;
+        case -3: Serial.print("MQTT_CONNECTION_LOST"); break;
+        case -2: Serial.print("MQTT_CONNECT_FAILED"); break;
+        case -1: Serial.print("MQTT_DISCONNECTED"); break;
+        case 1: Serial.print("MQTT_CONNECT_BAD_PROTOCOL"); break;
+        case 2: Serial.print("MQTT_CONNECT_BAD_CLIENT_ID"); break;
+        case 3: Serial.print("MQTT_CONNECT_UNAVAILABLE"); break;
+        case 4: Serial.print("MQTT_CONNECT_BAD_CREDENTIALS"); break;
+        case 5: Serial.print("MQTT_CONNECT_UNAUTHORIZED"); break;
+        default: Serial.print("UNKNOWN_ERROR"); break;
     }
+    Serial.println(")");
+    
+    scheduleRetry();
+}
+
+void NetworkManager::scheduleRetry() {
+    unsigned long wait = backoff.nextDelay();
+    nextMQTTAttempt = millis() + wait;
+    Serial.print("⏳ Próximo intento MQTT en ");
+    Serial.print(wait);
+    Serial.print(" ms (reintento #");
+    Serial.print(backoff.getAttempts());
+    Serial.println(")");
 }
 
+// Inicia la conexión sin bloquear; el progreso ocurre en loop()
 bool NetworkManager::connect() {
-    setupWiFi();
-    setupMQTT();
+    // Jitter propio de cada unidad para no reconectar en sincronía con la flota
+    backoff.seed(ESP.getChipId());
+    if (state == ConnectionState::WiFiIdle) {
+        startWiFi();
+    }
     return isConnected;
 }
 
@@ -168,27 +352,53 @@ bool NetworkManager::isMQTTConnected() {
 }
 
 void NetworkManager::loop() {
-    if (!mqttClient.connected()) {
+    // Si se cae el WiFi, volver a esperarlo (el SDK reconecta solo)
+    if ((state == ConnectionState::MqttWaiting || state == ConnectionState::MqttConnected) &&
+        WiFi.status() != WL_CONNECTED) {
+        Serial.println("📴 WiFi perdido");
         isConnected = false;
-        Serial.println("�� MQTT desconectado, reconectando...");
-        // Intentar reconectar con delay para evitar spam
-        static unsigned long lastReconnectAttempt = 0;
-        unsigned long now = millis();
-        
-        if (now - lastReconnectAttempt > 5000) { // Reintentar cada 5 segundos
-            lastReconnectAttempt = now;
-            setupMQTT();
-        }
+        wifiDirected = false;  // La reconexión del SDK reusa el mismo BSSID/canal
+        setState(ConnectionState::WiFiConnecting);
     }
     
-    // CRÍTICO: Llamar mqttClient.loop() primero para mantener conexión
-    mqttClient.loop();
+    switch (state) {
+        case ConnectionState::WiFiIdle:
+            startWiFi();
+            break;
+            
+        case ConnectionState::WiFiConnecting:
+            pollWiFi();
+            break;
+            
+        case ConnectionState::TimeSyncing:
+            pollTime();
+            break;
+            
+        case ConnectionState::MqttWaiting:
+            if ((long)(millis() - nextMQTTAttempt) >= 0) {
+                attemptMQTT();
+            }
+            break;
+            
+        case ConnectionState::MqttConnected:
+            if (!mqttClient.connected()) {
+                isConnected = false;
+                Serial.println("📴 MQTT desconectado, reconectando...");
+                scheduleRetry();
+                setState(ConnectionState::MqttWaiting);
+            } else {
+                // CRÍTICO: Llamar mqttClient.loop() para mantener conexión
+                mqttClient.loop();
+                drainQueue();
+            }
+            break;
+    }
     
     // Log de estado cada 60 segundos (menos frecuente)
     static unsigned long lastLog = 0;
     if (millis() - lastLog > 60000) {
-        Serial.print("📡 Estado MQTT: ");
-        Serial.println(mqttClient.connected() ? "Conectado" : "Desconectado");
+        Serial.print("📡 Estado red: ");
+        Serial.println(stateName(state));
         lastLog = millis();
     }
 }
@@ -213,68 +423,58 @@ bool NetworkManager::subscribe(const char* topic) {
     return false;
 }
 
-bool NetworkManager::publishWithQoS(const char* topic, const char* message, int qos) {
-    if (mqttClient.connected()) {
-        // Verificar longitud del mensaje
-        int messageLength = strlen(message);
-        if (messageLength > 512) {
-            Serial.print("⚠️ Mensaje muy largo (");
-            Serial.print(messageLength);
-            Serial.println(" bytes), truncando...");
+bool NetworkManager::enqueue(PublishClass cls, const char* topic, const char* message) {
+    unsigned long droppedBefore = outbound.getDropped();
+    if (outbound.push(cls, topic, message)) {
+        if (outbound.getDropped() != droppedBefore) {
+            Serial.println("⚠️ Cola de publicación llena, se descartó el mensaje más antiguo");
         }
-        
-        Serial.print("📤 Intentando publicar en ");
-        Serial.print(topic);
-        Serial.print(" (");
-        Serial.print(messageLength);
-        Serial.println(" bytes)");
-        
-        // Procesar mensajes pendientes antes de publicar
-        if (mqttClient.loop()) {
-            Serial.println("🔄 Procesando mensaje pendiente...");
-            delay(10); // Pequeña pausa para procesar
+        return true;
+    }
+    
+    // Solo falla si el mensaje no entra en un slot o la cola está llena de respuestas.
+    // Las respuestas nunca se descartan: se intenta el envío directo.
+    Serial.print("⚠️ No se pudo encolar publicación en ");
+    Serial.println(topic);
+    if (cls == PublishClass::Response && mqttClient.connected()) {
+        return mqttClient.publish(topic, message, false);
+    }
+    return false;
+}
+
+bool NetworkManager::publishNow(const QueuedMessage& msg) {
+    // Sin retained: el tercer parámetro de PubSubClient::publish es "retained", no QoS
+    return mqttClient.publish(msg.topic, (const uint8_t*)msg.payload, msg.length, false);
+}
+
+// Envía hasta DRAIN_BUDGET mensajes por tick; ante un fallo se reintenta en el próximo
+void NetworkManager::drainQueue() {
+    for (uint8_t sent = 0; sent < DRAIN_BUDGET; sent++) {
+        const QueuedMessage* msg = outbound.front();
+        if (!msg) {
+            return;
         }
-        
-        bool result = mqttClient.publish(topic, message, qos);
-        if (result) {
-            Serial.print("✅ Publicado (QoS ");
-            Serial.print(qos);
-            Serial.print(") en ");
-            Serial.print(topic);
-            Serial.print(": ");
-            Serial.println(message);
-        } else {
-            Serial.print("❌ Error publicando (QoS ");
-            Serial.print(qos);
-            Serial.print(") en ");
-            Serial.println(topic);
-            Serial.print("📊 Estado MQTT: ");
+        // Lo que no entra en el buffer MQTT negociado no va a entrar nunca
+        size_t packetLength = MQTT_PACKET_OVERHEAD + strlen(msg->topic) + msg->length;
+        if (packetLength > mqttClient.getBufferSize()) {
+            Serial.printf("❌ Paquete de %u bytes no entra en el buffer MQTT (%u) para %s\n",
+                          (unsigned)packetLength, mqttClient.getBufferSize(), msg->topic);
+            outbound.popFront();
+            continue;
+        }
+        if (!publishNow(*msg)) {
+            Serial.print("❌ Error publicando en ");
+            Serial.print(msg->topic);
+            Serial.print(", rc=");
             Serial.println(mqttClient.state());
-            Serial.print("📊 Buffer disponible: ");
-            Serial.println(mqttClient.getBufferSize());
-            Serial.print("📊 Mensaje pendiente: ");
-            Serial.println(mqttClient.loop() ? "Sí" : "No");
-            
-            // Intentar limpiar el buffer
-            Serial.println("🧹 Limpiando buffer MQTT...");
-            for (int i = 0; i < 5; i++) {
-                mqttClient.loop();
-                delay(10);
-            }
+            return;
         }
-        return result;
+        outbound.popFront();
     }
-    Serial.println("❌ MQTT no conectado para publicar");
-    Serial.print("📊 Estado MQTT: ");
-    Serial.println(mqttClient.state());
-    return false;
 }
 
 void NetworkManager::publishError(const char* errorType, const char* message) {
     // Publicar error en topic de AWS IoT Core
-    char topic[100];
-    sprintf(topic, "$aws/things/%s/errors", awsConfig.thingName);
-    
     StaticJsonDocument<256> doc;
     doc["timestamp"] = millis();
     doc["error_type"] = errorType;
@@ -284,15 +484,13 @@ void NetworkManager::publishError(const char* errorType, const char* message) {
     String errorJSON;
     serializeJson(doc, errorJSON);
     
-    publishWithQoS(topic, errorJSON.c_str(), 1);
+    enqueue(PublishClass::Event, topicTable.get(Topic::Errors), errorJSON.c_str());
 }
 
 bool NetworkManager::testConnection() {
     if (mqttClient.connected()) {
         // Publicar mensaje de test en AWS IoT Core
-        char topic[100];
-        sprintf(topic, "$aws/things/%s/test", awsConfig.thingName);
-        return publish(topic, "test_message");
+        return publish(topicTable.get(Topic::Test), "test_message");
     }
     return false;
 }
@@ -300,19 +498,21 @@ bool NetworkManager::testConnection() {
 void NetworkManager::sendHeartbeat() {
     if (mqttClient.connected()) {
         // Publicar heartbeat en AWS IoT Core Shadow
-        char topic[100];
-        sprintf(topic, "$aws/things/%s/shadow/update", awsConfig.thingName);
-        
-        StaticJsonDocument<256> doc;
+        StaticJsonDocument<384> doc;
         doc["state"]["reported"]["timestamp"] = millis();
         doc["state"]["reported"]["unit_id"] = deviceConfig.unitId;
         doc["state"]["reported"]["status"] = "alive";
         doc["state"]["reported"]["mqtt_connected"] = true;
+        // Tamaños de buffer elegidos tras el probe MFLN
+        doc["state"]["reported"]["mfln"] = mflnSupported;
+        doc["state"]["reported"]["tls_rx"] = tlsRxSize;
+        doc["state"]["reported"]["tls_tx"] = tlsTxSize;
+        doc["state"]["reported"]["mqtt_buffer"] = mqttBufferSize;
         
         String heartbeatJSON;
         serializeJson(doc, heartbeatJSON);
         
-        publishWithQoS(topic, heartbeatJSON.c_str(), 0); // QoS 0 para heartbeat
+        enqueue(PublishClass::Heartbeat, topicTable.get(Topic::ShadowUpdate), heartbeatJSON.c_str());
     }
 }
 //inicialización de callback
@@ -6,32 +6,81 @@
 #include <PubSubClient.h>
 #include <BearSSLHelpers.h>
 #include "config.h"
+#include "reconnect_backoff.h"
+#include "esp_transport.h"
+#include "wifi_cache.h"
+#include "publish_queue.h"
 
-
+// Estados de la conexión: loop() avanza como máximo un paso por iteración
+enum class ConnectionState {
+    WiFiIdle,        // Falta llamar a WiFi.begin
+    WiFiConnecting,  // Esperando WL_CONNECTED
+    TimeSyncing,     // Esperando NTP (TLS necesita la hora)
+    MqttWaiting,     // Esperando el próximo intento MQTT
+    MqttConnected    // Operativo (MQTT_CONNECTED ya es macro de PubSubClient)
+};
 
 class NetworkManager {
 private:
-    WiFiClientSecure espClient;  // Cambiar a WiFiClientSecure para AWS IoT Core
+    PlatformTransport transport;  // TLS (BearSSL) para AWS IoT Core
     PubSubClient mqttClient;
     bool isConnected;
+    ConnectionState state;
+    unsigned long stateSince;       // millis() al entrar al estado actual
+    unsigned long nextMQTTAttempt;  // millis() del próximo intento MQTT
+    int attemptCount;
+    ReconnectBackoff backoff;       // Espera entre intentos MQTT
+    IPAddress brokerIP;             // Última resolución del endpoint
+    bool dnsPending;                // Consulta DNS asíncrona en curso
+    bool dnsAnswered;               // Llegó la respuesta (brokerIP sin asignar = falló)
+    unsigned long dnsStartedAt;
+    bool mflnProbed;                // Probe MFLN hecho: vale mientras viva el proceso (endpoint fijo)
+    bool tlsBuffersSized;           // Buffers configurados según el probe
+    bool mflnSupported;
+    uint16_t tlsRxSize;
+    uint16_t tlsTxSize;
+    uint16_t mqttBufferSize;
+    PublishQueue outbound;          // Publicaciones pendientes, se vacían en loop()
+    WiFiCache wifiCache;            // Último AP bueno en RTC para reconexión directa
+    bool wifiDirected;              // El intento en curso usa BSSID/canal de la caché
     
-    void setupWiFi();
-    void setupMQTT();
-    void setCurrentTime(); // Sincronización NTP
+    void setState(ConnectionState newState);
+    void startWiFi();
+    void pollWiFi();
+    void rememberAccessPoint();
+    void setCurrentTime(); // Sincronización NTP (inicio)
+    void pollTime();       // Sincronización NTP (espera no bloqueante)
+    enum class DnsResult : uint8_t { Ready, Pending, Failed };
+    friend struct BrokerDnsCallback;
+    void attemptMQTT();
+    DnsResult resolveBroker();
+    void sizeTlsBuffers();
+    void scheduleRetry();
+    void drainQueue();
+    bool publishNow(const QueuedMessage& msg);
     
 public:
     NetworkManager();
     bool connect();
     bool isMQTTConnected();
+    ConnectionState getState() const { return state; }
+    static const char* stateName(ConnectionState s);
     void loop();
     bool publish(const char* topic, const char* message);
     bool subscribe(const char* topic);
     void setCallback(void (*callback)(char*, uint8_t*, unsigned int));
 
-    bool publishWithQoS(const char* topic, const char* message, int qos = 1);
+    // Encola sin bloquear; el envío ocurre en el próximo tick de red
+    bool enqueue(PublishClass cls, const char* topic, const char* message);
+    uint8_t getQueueSize() const { return outbound.size(); }
+    unsigned long getQueueDropped() const { return outbound.getDropped(); }
     void publishError(const char* errorType, const char* message);
     bool testConnection();
     void sendHeartbeat();
+    bool isMflnSupported() const { return mflnSupported; }
+    uint16_t getTlsRxSize() const { return tlsRxSize; }
+    uint16_t getTlsTxSize() const { return tlsTxSize; }
+    uint16_t getMqttBufferSize() const { return mqttBufferSize; }
 };
 
 #endif
\ No newline at end of file
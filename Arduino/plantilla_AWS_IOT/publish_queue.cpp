@@ -0,0 +1,108 @@
+#include "publish_queue.h"
+
+PublishQueue::PublishQueue() : nextSeq(0), count(0), dropped(0) {
+    for (uint8_t i = 0; i < PublishQueueLimits::CAPACITY; i++) {
+        slots[i].used = false;
+    }
+}
+
+bool PublishQueue::coalesces(PublishClass cls) {
+    return cls == PublishClass::Status || cls == PublishClass::Heartbeat;
+}
+
+int PublishQueue::findFree() const {
+    for (uint8_t i = 0; i < PublishQueueLimits::CAPACITY; i++) {
+        if (!slots[i].used) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int PublishQueue::findOldest(bool droppableOnly) const {
+    int oldest = -1;
+    for (uint8_t i = 0; i < PublishQueueLimits::CAPACITY; i++) {
+        if (!slots[i].used) {
+            continue;
+        }
+        if (droppableOnly && slots[i].cls == PublishClass::Response) {
+            continue;
+        }
+        // Resta con signo: tolera el desborde de seq
+        if (oldest < 0 || (int32_t)(slots[i].seq - slots[oldest].seq) < 0) {
+            oldest = i;
+        }
+    }
+    return oldest;
+}
+
+int PublishQueue::findCoalescible(PublishClass cls, const char* topic) const {
+    for (uint8_t i = 0; i < PublishQueueLimits::CAPACITY; i++) {
+        if (slots[i].used && slots[i].cls == cls && strcmp(slots[i].topic, topic) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+bool PublishQueue::push(PublishClass cls, const char* topic, const char* payload) {
+    size_t topicLength = strlen(topic);
+    size_t payloadLength = strlen(payload);
+    if (topicLength >= PublishQueueLimits::TOPIC_MAX || payloadLength >= PublishQueueLimits::PAYLOAD_MAX) {
+        return false;
+    }
+    
+    int index = -1;
+    bool reused = false;
+    
+    // Estado/estadísticas: el más nuevo reemplaza al pendiente, conservando su turno
+    if (coalesces(cls)) {
+        index = findCoalescible(cls, topic);
+        reused = index >= 0;
+    }
+    if (index < 0) {
+        index = findFree();
+    }
+    if (index < 0) {
+        // Cola llena: se descarta el más antiguo que no sea una respuesta
+        index = findOldest(true);
+        if (index < 0) {
+            return false;  // Solo quedan respuestas
+        }
+        slots[index].used = false;
+        count--;
+        dropped++;
+    }
+    
+    QueuedMessage& slot = slots[index];
+    slot.cls = cls;
+    slot.length = payloadLength;
+    memcpy(slot.topic, topic, topicLength + 1);
+    memcpy(slot.payload, payload, payloadLength + 1);
+    if (!reused) {
+        slot.used = true;
+        slot.seq = nextSeq++;
+        count++;
+    }
+    return true;
+}
+
+const QueuedMessage* PublishQueue::front() const {
+    int index = findOldest(false);
+    return index >= 0 ? &slots[index] : nullptr;
+}
+
+void PublishQueue::popFront() {
+    int index = findOldest(false);
+    if (index >= 0) {
+        slots[index].used = false;
+        count--;
+    }
+}
+
+void PublishQueue::clear() {
+    for (uint8_t i = 0; i < PublishQueueLimits::CAPACITY; i++) {
+        slots[i].used = false;
+    }
+    count = 0;
+}
@@ -0,0 +1,56 @@
+#ifndef PUBLISH_QUEUE_H
+#define PUBLISH_QUEUE_H
+
+#include <Arduino.h>
+
+// Clases de mensaje saliente, cada una con su política de descarte
+enum class PublishClass : uint8_t {
+    Response,   // Respuestas a comandos: nunca se descartan
+    Event,      // Errores: si no hay lugar se descarta el más antiguo
+    Config,     // Configuración inicial de bombas: igual que Event
+    Status,     // Estado periódico: el más nuevo reemplaza al encolado
+    Heartbeat   // Latido del shadow: el más nuevo reemplaza al encolado
+};
+
+// Límites de la cola (almacenamiento estático, sin heap: TLS necesita el heap)
+namespace PublishQueueLimits {
+    const uint8_t CAPACITY = 8;
+    const uint16_t TOPIC_MAX = 64;
+    const uint16_t PAYLOAD_MAX = 640;
+}
+
+struct QueuedMessage {
+    bool used;
+    PublishClass cls;
+    uint32_t seq;        // Orden de llegada (FIFO)
+    uint16_t length;
+    char topic[PublishQueueLimits::TOPIC_MAX];
+    char payload[PublishQueueLimits::PAYLOAD_MAX];
+};
+
+// Cola de publicaciones de capacidad fija (la misma que plantilla_modular).
+// push() es O(CAPACITY), nunca bloquea ni toca la red; el vaciado ocurre en
+// el tick de red (NetworkManager::loop).
+class PublishQueue {
+private:
+    QueuedMessage slots[PublishQueueLimits::CAPACITY];
+    uint32_t nextSeq;
+    uint8_t count;
+    unsigned long dropped;
+
+    static bool coalesces(PublishClass cls);
+    int findFree() const;
+    int findOldest(bool droppableOnly) const;
+    int findCoalescible(PublishClass cls, const char* topic) const;
+
+public:
+    PublishQueue();
+    bool push(PublishClass cls, const char* topic, const char* payload);
+    const QueuedMessage* front() const;  // Más antiguo, nullptr si vacía
+    void popFront();
+    void clear();
+    uint8_t size() const { return count; }
+    unsigned long getDropped() const { return dropped; }
+};
+
+#endif
@@ -1,6 +1,7 @@
 #include "pump_controller.h"
 #include "network_manager.h"
 #include "command_definition.h"
+#include "topic_table.h"
 #include <Arduino.h>
 #include <ArduinoJson.h>
 
@@ -212,7 +213,6 @@ void PumpController::performInitialMQTTConfig() {
         sendPumpConfigCommand(i, 
                             deviceConfig.pumpDefaults.activationTime, 
                             deviceConfig.pumpDefaults.cooldownTime);
-        delay(100); // Pequeña pausa entre comandos
     }
     
     initialConfigSent = true;
@@ -235,16 +235,12 @@ void PumpController::sendPumpConfigCommand(int pumpId, int activationTime, int c
     String commandJSON;
     serializeJson(doc, commandJSON);
     
-    // Crear topic de configuración
-    char topic[50];
-    sprintf(topic, "motete/osmo/%s/config", deviceConfig.unitId);
-    
     Serial.printf("📤 Enviando configuración para bomba %d: activación=%dms, cooldown=%dms\n", 
                   pumpId, activationTime, cooldownTime);
     
-    // Enviar comando (usar QoS 0 para evitar problemas de buffer)
-    if (networkManager->publishWithQoS(topic, commandJSON.c_str(), 0)) {
-        Serial.printf("✅ Comando de configuración enviado para bomba %d\n", pumpId);
+    // Encolar: se envía en el tick de red sin frenar la inicialización
+    if (networkManager->enqueue(PublishClass::Config, topicTable.get(Topic::Config), commandJSON.c_str())) {
+        Serial.printf("✅ Comando de configuración encolado para bomba %d\n", pumpId);
     } else {
         Serial.printf("❌ Error enviando configuración para bomba %d\n", pumpId);
     }
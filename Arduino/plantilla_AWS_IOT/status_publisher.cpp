@@ -1,6 +1,7 @@
 #include "status_publisher.h"
 #include "pump_controller.h"
 #include "command_definition.h"
+#include "topic_table.h"
 
 StatusPublisher::StatusPublisher(PumpController* pumpCtrl, NetworkManager* netMgr) 
     : pumpController(pumpCtrl), networkManager(netMgr) {}
@@ -41,13 +42,9 @@ String StatusPublisher::createStatusJSON() {
 void StatusPublisher::publishStatus() {
     String statusJSON = createStatusJSON();
     
-    // Publicar en topic simple (sin Device Shadow)
-    char statusTopic[100];
-    sprintf(statusTopic, "motete/osmo/%s/status", deviceConfig.unitId);
-    
-    // Publicar con QoS 0 para reducir carga (menos memoria)
-    if (networkManager->publishWithQoS(statusTopic, statusJSON.c_str(), 0)) {
-        Serial.println("✅ Estado publicado en AWS IoT Core");
+    // Topic simple (sin Device Shadow); el estado más nuevo reemplaza al que siga pendiente en la cola
+    if (networkManager->enqueue(PublishClass::Status, topicTable.get(Topic::Status), statusJSON.c_str())) {
+        Serial.println("✅ Estado encolado para AWS IoT Core");
     } else {
         Serial.println("❌ Error al publicar estado en AWS IoT Core");
     }
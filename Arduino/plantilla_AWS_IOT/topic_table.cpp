@@ -0,0 +1,36 @@
+#include "topic_table.h"
+
+TopicTable topicTable;
+
+TopicTable::TopicTable() : built(false) {
+    for (uint8_t i = 0; i < (uint8_t)Topic::Count; i++) {
+        entries[i].name[0] = '\0';
+        entries[i].length = 0;
+    }
+}
+
+bool TopicTable::set(Topic topic, const char* prefix, const char* id, const char* suffix) {
+    Entry& entry = entries[(uint8_t)topic];
+    int written = snprintf(entry.name, sizeof(entry.name), "%s%s%s", prefix, id, suffix);
+    if (written < 0 || written >= (int)sizeof(entry.name)) {
+        entry.name[0] = '\0';
+        entry.length = 0;
+        Serial.printf("❌ Topic demasiado largo para %s\n", id);
+        return false;
+    }
+    entry.length = written;
+    return true;
+}
+
+bool TopicTable::build(const char* unitId, const char* thingName) {
+    bool ok = true;
+    ok &= set(Topic::Status, "motete/osmo/", unitId, "/status");
+    ok &= set(Topic::Response, "motete/osmo/", unitId, "/response");
+    ok &= set(Topic::Config, "motete/osmo/", unitId, "/config");
+    ok &= set(Topic::Commands, "motete/director/commands/", unitId, "");
+    ok &= set(Topic::Errors, "$aws/things/", thingName, "/errors");
+    ok &= set(Topic::Test, "$aws/things/", thingName, "/test");
+    ok &= set(Topic::ShadowUpdate, "$aws/things/", thingName, "/shadow/update");
+    built = true;
+    return ok;
+}
@@ -0,0 +1,46 @@
+#ifndef TOPIC_TABLE_H
+#define TOPIC_TABLE_H
+
+#include <Arduino.h>
+#include "publish_queue.h"
+
+// Topics propios de la unidad
+enum class Topic : uint8_t {
+    Status,        // motete/osmo/<unit>/status
+    Response,      // motete/osmo/<unit>/response
+    Config,        // motete/osmo/<unit>/config
+    Commands,      // motete/director/commands/<unit> (suscripción)
+    Errors,        // $aws/things/<thing>/errors
+    Test,          // $aws/things/<thing>/test
+    ShadowUpdate,  // $aws/things/<thing>/shadow/update (heartbeat)
+    Count
+};
+
+// Tabla de topics construida una sola vez desde deviceConfig.unitId y
+// awsConfig.thingName (la misma idea que plantilla_modular). Los publicadores
+// reciben punteros a almacenamiento estático: sin sprintf por mensaje y sin
+// buffers en la pila que un unitId largo pueda desbordar.
+class TopicTable {
+private:
+    struct Entry {
+        char name[PublishQueueLimits::TOPIC_MAX];  // Todo topic debe entrar en la cola
+        uint8_t length;
+    };
+
+    Entry entries[(uint8_t)Topic::Count];
+    bool built;
+
+    bool set(Topic topic, const char* prefix, const char* id, const char* suffix);
+
+public:
+    TopicTable();
+    // false si algún topic no entra: esos quedan vacíos y no se publican
+    bool build(const char* unitId, const char* thingName);
+    const char* get(Topic topic) const { return entries[(uint8_t)topic].name; }
+    uint8_t length(Topic topic) const { return entries[(uint8_t)topic].length; }
+    bool isBuilt() const { return built; }
+};
+
+extern TopicTable topicTable;
+
+#endif
@@ -0,0 +1,22 @@
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <Arduino.h>
+#include <Client.h>
+
+// Capa de transporte bajo PubSubClient. Cada backend entrega un Client de
+// Arduino listo para usar, así NetworkManager no depende del socket concreto:
+//   EspTcpTransport  - WiFiClient (firmware, broker local)
+//   EspTlsTransport  - BearSSL::WiFiClientSecure (firmware, broker con TLS)
+// (plantilla_modular agrega PosixTcpTransport para builds de host)
+class ITransport {
+public:
+    virtual ~ITransport() {}
+    virtual Client& client() = 0;
+    // Tiempo máximo de un connect/escritura bloqueante
+    virtual void setConnectTimeout(unsigned long timeoutMs) = 0;
+    virtual bool isSecure() const { return false; }
+    virtual const char* name() const = 0;
+};
+
+#endif
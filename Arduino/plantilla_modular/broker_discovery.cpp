@@ -0,0 +1,180 @@
+#include "broker_discovery.h"
+#include "config.h"
+#include "log.h"
+#include <ESP8266WiFi.h>
+#include <ESP8266mDNS.h>
+#include <LittleFS.h>
+
+namespace {
+    const char* CACHE_PATH = "/broker.bin";
+    const uint32_t CACHE_MAGIC = 0x42524B31UL;  // "BRK1"
+    const uint16_t MDNS_QUERY_TIMEOUT = 800;     // ms juntando respuestas antes de elegir
+}
+
+BrokerDiscovery::BrokerDiscovery()
+    : port(0), source(BrokerSource::Config), failures(0), mdnsStarted(false), query(nullptr),
+      queryStartedAt(0), cachedIp(0), cachedPort(0) {
+}
+
+const char* BrokerDiscovery::sourceName(BrokerSource s) {
+    switch (s) {
+        case BrokerSource::Config: return "config";
+        case BrokerSource::Cache: return "cache";
+        case BrokerSource::Mdns: return "mdns";
+    }
+    return "unknown";
+}
+
+// FNV-1a de server y puerto configurados
+uint32_t BrokerDiscovery::configHash() {
+    uint32_t hash = 2166136261UL;
+    for (const char* c = mqttConfig.server; *c; c++) {
+        hash ^= (uint8_t)*c;
+        hash *= 16777619UL;
+    }
+    return hash ^ (uint32_t)mqttConfig.port;
+}
+
+void BrokerDiscovery::begin() {
+    if (loadCache()) {
+        ip = IPAddress(cachedIp);
+        port = cachedPort;
+        source = BrokerSource::Cache;
+        LOG_INFO("📇 Broker desde caché: %s:%u", ip.toString().c_str(), port);
+        return;
+    }
+    useConfig();
+}
+
+void BrokerDiscovery::useConfig() {
+    // Si server no es una IP se deja sin asignar y se conecta por nombre
+    ip = IPAddress();
+    ip.fromString(mqttConfig.server);
+    port = mqttConfig.port;
+    source = BrokerSource::Config;
+}
+
+bool BrokerDiscovery::loadCache() {
+    // LittleFS ya montado por OfflineSpool::begin; si no, sin caché
+    File file = LittleFS.open(CACHE_PATH, "r");
+    if (!file) {
+        return false;
+    }
+    Record record;
+    bool valid = file.read((uint8_t*)&record, sizeof(record)) == sizeof(record) &&
+                 record.magic == CACHE_MAGIC && record.configHash == configHash() &&
+                 record.ip != 0 && record.port != 0;
+    file.close();
+    if (valid) {
+        cachedIp = record.ip;
+        cachedPort = record.port;
+    }
+    return valid;
+}
+
+void BrokerDiscovery::saveCache() {
+    if ((uint32_t)ip == cachedIp && port == cachedPort) {
+        return;
+    }
+    Record record = { CACHE_MAGIC, configHash(), (uint32_t)ip, port, 0 };
+    File file = LittleFS.open(CACHE_PATH, "w");
+    if (!file) {
+        return;
+    }
+    file.write((const uint8_t*)&record, sizeof(record));
+    file.close();
+    cachedIp = record.ip;
+    cachedPort = record.port;
+}
+
+bool BrokerDiscovery::startMdnsQuery() {
+    if (!mdnsStarted) {
+        // Nombre de host válido: sin '_' (osmo_norte -> osmo-norte)
+        char hostname[32];
+        strncpy(hostname, deviceConfig.unitId, sizeof(hostname) - 1);
+        hostname[sizeof(hostname) - 1] = '\0';
+        for (char* c = hostname; *c; c++) {
+            if (*c == '_') *c = '-';
+        }
+        mdnsStarted = MDNS.begin(hostname);
+        if (!mdnsStarted) {
+            LOG_ERROR("❌ mDNS no disponible");
+            return false;
+        }
+    }
+    
+    // Sin queryService: espera las respuestas con delay() y frena loop()
+    query = MDNS.installServiceQuery("mqtt", "tcp",
+        [](const MDNSResponder::MDNSServiceInfo&, MDNSResponder::AnswerType, bool) {});
+    if (!query) {
+        LOG_ERROR("❌ No se pudo lanzar la consulta mDNS");
+        return false;
+    }
+    queryStartedAt = millis();
+    LOG_INFO("🔎 Buscando broker por mDNS (_mqtt._tcp)...");
+    return true;
+}
+
+// Se toma la primera respuesta con IPv4; el resto queda en el log
+bool BrokerDiscovery::finishMdnsQuery() {
+    MDNSResponder::hMDNSServiceQuery handle = (MDNSResponder::hMDNSServiceQuery)query;
+    uint32_t found = MDNS.answerCount(handle);
+    LOG_INFO("🔎 mDNS _mqtt._tcp: %lu respuestas en %lu ms", (unsigned long)found, millis() - queryStartedAt);
+    
+    bool chosen = false;
+    for (uint32_t i = 0; i < found; i++) {
+        if (MDNS.answerIP4AddressCount(handle, i) == 0) {
+            continue;
+        }
+        IPAddress answer = MDNS.answerIP4Address(handle, i, 0);
+        uint16_t answerPort = MDNS.answerPort(handle, i);
+        LOG_INFO("   %s:%u", answer.toString().c_str(), answerPort);
+        if (!chosen && answer.isSet() && answerPort != 0) {
+            ip = answer;
+            port = answerPort;
+            source = BrokerSource::Mdns;
+            chosen = true;
+        }
+    }
+    MDNS.removeServiceQuery(handle);
+    query = nullptr;
+    return chosen;
+}
+
+void BrokerDiscovery::onFailure() {
+    if (!mqttConfig.discovery || query || ++failures < mqttConfig.rediscoverAfter) {
+        return;
+    }
+    failures = 0;
+    startMdnsQuery();
+}
+
+bool BrokerDiscovery::loop() {
+    if (!query) {
+        return false;
+    }
+    MDNS.update();
+    if (millis() - queryStartedAt < MDNS_QUERY_TIMEOUT) {
+        return false;
+    }
+    
+    IPAddress previous = ip;
+    uint16_t previousPort = port;
+    if (!finishMdnsQuery() && source != BrokerSource::Config) {
+        // Nadie se anuncia: volver a la dirección de config
+        useConfig();
+    }
+    if ((uint32_t)ip == (uint32_t)previous && port == previousPort) {
+        return false;
+    }
+    LOG_INFO("📇 Broker ahora %s:%u (%s)", ip.toString().c_str(), port, sourceName(source));
+    return true;
+}
+
+// Solo se guarda una dirección que ya aceptó un CONNECT
+void BrokerDiscovery::onSuccess() {
+    failures = 0;
+    if (ip.isSet()) {
+        saveCache();
+    }
+}
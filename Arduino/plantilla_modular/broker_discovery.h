@@ -0,0 +1,62 @@
+#ifndef BROKER_DISCOVERY_H
+#define BROKER_DISCOVERY_H
+
+#include <Arduino.h>
+#include <IPAddress.h>
+
+// De dónde salió la dirección del broker en uso
+enum class BrokerSource : uint8_t {
+    Config,  // mqttConfig.server
+    Cache,   // Último broker que funcionó (flash)
+    Mdns     // Anuncio DNS-SD _mqtt._tcp en la red local
+};
+
+// Dirección del broker: la última que funcionó (guardada en LittleFS), si no
+// la de config. Recién tras varios fallos seguidos contra el primario (connect
+// MQTT o sondeo desde un respaldo) se pregunta por mDNS, así un cambio de
+// lease DHCP del director no deja a la unidad reintentando para siempre contra
+// una IP muerta. La consulta no bloquea: las respuestas se juntan en loop().
+class BrokerDiscovery {
+private:
+    struct Record {
+        uint32_t magic;
+        uint32_t configHash;  // Otro server/puerto en config invalida la caché
+        uint32_t ip;
+        uint16_t port;
+        uint16_t reserved;
+    };
+    
+    IPAddress ip;          // Sin asignar: usar mqttConfig.server tal cual (nombre)
+    uint16_t port;
+    BrokerSource source;
+    uint8_t failures;      // Fallos seguidos del primario con la dirección actual
+    bool mdnsStarted;
+    const void* query;     // Consulta _mqtt._tcp en curso (hMDNSServiceQuery), nullptr si no hay
+    unsigned long queryStartedAt;
+    uint32_t cachedIp;     // Lo que hay en flash, para no reescribir igual
+    uint16_t cachedPort;
+    
+    static uint32_t configHash();
+    bool loadCache();
+    void saveCache();
+    bool startMdnsQuery();
+    bool finishMdnsQuery();
+    void useConfig();
+    
+public:
+    BrokerDiscovery();
+    void begin();
+    // Tras un connect o sondeo fallido contra el primario; puede lanzar la consulta mDNS
+    void onFailure();
+    void onSuccess();
+    void onReachable() { failures = 0; }  // Sondeo TCP bueno: la dirección sigue viva
+    // Avanza la consulta mDNS; true cuando terminó y cambió la dirección a usar
+    bool loop();
+    bool hasAddress() const { return ip.isSet(); }
+    IPAddress getIP() const { return ip; }
+    uint16_t getPort() const { return port; }
+    BrokerSource getSource() const { return source; }
+    static const char* sourceName(BrokerSource s);
+};
+
+#endif
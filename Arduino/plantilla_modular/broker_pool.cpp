@@ -0,0 +1,117 @@
+#include "broker_pool.h"
+#include "config.h"
+#include "log.h"
+
+static_assert(sizeof(mqttConfig.standby) / sizeof(mqttConfig.standby[0]) + 1 == BrokerPool::MAX_BROKERS,
+              "BrokerPool::MAX_BROKERS debe cubrir mqttConfig.standby");
+
+namespace {
+    const float EWMA_GAIN = 0.3f;              // Peso de la última medición
+    const uint8_t FAILOVER_AFTER = 2;          // Connect fallidos seguidos
+    const float FAILOVER_ERROR_RATE = 0.5f;    // O tasa de error sostenida
+    const unsigned long MIN_ATTEMPTS_FOR_RATE = 4;
+    const float ERROR_PENALTY = 4.0f;          // Puntaje = latencia * (1 + 4 * error)
+    const float UNKNOWN_LATENCY_MS = 500.0f;   // Broker aún no probado
+    const unsigned long PRIMARY_PROBE_INTERVAL = 30000;  // ms entre sondeos
+    const uint8_t PRIMARY_PROBES_TO_RETURN = 2;          // Histéresis de la vuelta
+}
+
+BrokerPool::BrokerPool() : count(1), current(0), nextPrimaryProbe(0), primaryProbeStreak(0) {
+    for (uint8_t i = 0; i < MAX_BROKERS; i++) {
+        resetHealth(i);
+    }
+}
+
+void BrokerPool::begin() {
+    count = 1;
+    for (uint8_t i = 0; i + 1 < MAX_BROKERS; i++) {
+        if (mqttConfig.standby[i].server != nullptr) {
+            count++;
+        }
+    }
+    if (count > 1) {
+        LOG_INFO("🗂️ Brokers: primario + %u de respaldo", count - 1);
+    }
+}
+
+void BrokerPool::resetHealth(uint8_t index) {
+    health[index].latencyMs = UNKNOWN_LATENCY_MS;
+    health[index].errorRate = 0;
+    health[index].consecutiveFailures = 0;
+    health[index].attempts = 0;
+    health[index].failures = 0;
+}
+
+void BrokerPool::record(uint8_t index, bool ok, float latencyMs) {
+    Health& h = health[index];
+    h.attempts++;
+    h.errorRate += EWMA_GAIN * ((ok ? 0.0f : 1.0f) - h.errorRate);
+    if (ok) {
+        h.consecutiveFailures = 0;
+        // El primer connect bueno reemplaza la latencia supuesta
+        bool first = h.attempts - h.failures == 1;
+        h.latencyMs = first ? latencyMs : h.latencyMs + EWMA_GAIN * (latencyMs - h.latencyMs);
+    } else {
+        h.failures++;
+        if (h.consecutiveFailures < 255) {
+            h.consecutiveFailures++;
+        }
+    }
+}
+
+float BrokerPool::score(uint8_t index) const {
+    return health[index].latencyMs * (1.0f + ERROR_PENALTY * health[index].errorRate);
+}
+
+void BrokerPool::recordConnect(bool ok, unsigned long latencyMs) {
+    record(current, ok, latencyMs);
+}
+
+void BrokerPool::recordDrop() {
+    Health& h = health[current];
+    h.errorRate += EWMA_GAIN * (1.0f - h.errorRate);
+}
+
+bool BrokerPool::shouldFailover() const {
+    if (count < 2) {
+        return false;
+    }
+    const Health& h = health[current];
+    return h.consecutiveFailures >= FAILOVER_AFTER ||
+           (h.attempts >= MIN_ATTEMPTS_FOR_RATE && h.errorRate > FAILOVER_ERROR_RATE);
+}
+
+// Al broker de menor puntaje entre los otros (si también cae un respaldo,
+// el primario vuelve a ser candidato)
+void BrokerPool::failover() {
+    uint8_t best = current;
+    for (uint8_t i = 0; i < count; i++) {
+        if (i != current && (best == current || score(i) < score(best))) {
+            best = i;
+        }
+    }
+    LOG_WARN("⚠️ Broker %u no responde (error %.2f, %u fallos seguidos): pasando al %u",
+             current, health[current].errorRate, health[current].consecutiveFailures, best);
+    health[current].consecutiveFailures = 0;
+    current = best;
+    primaryProbeStreak = 0;
+    nextPrimaryProbe = millis() + PRIMARY_PROBE_INTERVAL;
+}
+
+bool BrokerPool::primaryProbeDue() const {
+    return current != 0 && (long)(millis() - nextPrimaryProbe) >= 0;
+}
+
+bool BrokerPool::recordPrimaryProbe(bool ok, unsigned long latencyMs) {
+    nextPrimaryProbe = millis() + PRIMARY_PROBE_INTERVAL;
+    record(0, ok, latencyMs);
+    primaryProbeStreak = ok ? primaryProbeStreak + 1 : 0;
+    return primaryProbeStreak >= PRIMARY_PROBES_TO_RETURN;
+}
+
+void BrokerPool::returnToPrimary() {
+    LOG_INFO("🔙 Primario estable (%.0f ms): volviendo desde el broker %u", health[0].latencyMs, current);
+    current = 0;
+    primaryProbeStreak = 0;
+    health[0].consecutiveFailures = 0;
+}
@@ -0,0 +1,56 @@
+#ifndef BROKER_POOL_H
+#define BROKER_POOL_H
+
+#include <Arduino.h>
+
+// Salud de cada broker configurado: el 0 es el primario (su dirección la
+// resuelve BrokerDiscovery), los demás son respaldos de mqttConfig.standby.
+// Se promedia la latencia de connect y la tasa de error; pasado el umbral se
+// cambia enseguida al respaldo con mejor puntaje, y mientras tanto se sondea
+// el primario para volver a él cuando responde de forma estable.
+class BrokerPool {
+public:
+    static const uint8_t MAX_BROKERS = 3;  // Primario + mqttConfig.standby
+    
+private:
+    struct Health {
+        float latencyMs;            // Promedio móvil del connect (TCP + CONNACK)
+        float errorRate;            // Promedio móvil de fallos (0..1)
+        uint8_t consecutiveFailures;
+        unsigned long attempts;
+        unsigned long failures;
+    };
+    
+    Health health[MAX_BROKERS];     // Primario + mqttConfig.standby
+    uint8_t count;
+    uint8_t current;
+    unsigned long nextPrimaryProbe; // millis() del próximo sondeo del primario
+    uint8_t primaryProbeStreak;     // Sondeos buenos seguidos
+    
+    void record(uint8_t index, bool ok, float latencyMs);
+    float score(uint8_t index) const;
+    
+public:
+    BrokerPool();
+    void begin();
+    uint8_t getCount() const { return count; }
+    uint8_t getCurrent() const { return current; }
+    bool isOnPrimary() const { return current == 0; }
+    
+    void recordConnect(bool ok, unsigned long latencyMs);
+    void recordDrop();              // Conexión establecida que se cayó
+    // true si el broker actual pasó el umbral y hay otro al que ir
+    bool shouldFailover() const;
+    void failover();
+    
+    // Vuelta al primario: sondeos periódicos mientras se está en un respaldo
+    bool primaryProbeDue() const;
+    bool recordPrimaryProbe(bool ok, unsigned long latencyMs);  // true = volver
+    void returnToPrimary();
+    
+    void resetHealth(uint8_t index);
+    float getLatencyMs(uint8_t index) const { return health[index].latencyMs; }
+    float getErrorRate(uint8_t index) const { return health[index].errorRate; }
+};
+
+#endif
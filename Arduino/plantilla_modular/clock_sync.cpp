@@ -0,0 +1,206 @@
+#include "clock_sync.h"
+#include "config.h"
+#include "log.h"
+#include <ESP8266WiFi.h>
+
+ClockSync clockSync;
+
+namespace {
+    const unsigned long SAMPLE_SPACING = 30;     // ms entre pedidos de una ráfaga
+    const unsigned long RESPONSE_WAIT = 250;     // ms tras el último pedido
+    const unsigned long FIRST_BURST_RETRY = 2000;  // ms entre ráfagas hasta la primera buena
+    const uint64_t MIN_DRIFT_SPAN = 10000000ULL; // µs mínimos entre ráfagas para medir deriva
+    const float MAX_DRIFT_PPM = 500.0f;          // Cristal fuera de esto = medición mala
+    const float DRIFT_GAIN = 0.5f;               // Filtro exponencial de la deriva
+    
+    void writeU32(uint8_t* p, uint32_t v) {
+        for (uint8_t i = 0; i < 4; i++) p[i] = v >> (8 * i);
+    }
+    
+    void writeU64(uint8_t* p, uint64_t v) {
+        for (uint8_t i = 0; i < 8; i++) p[i] = v >> (8 * i);
+    }
+    
+    uint32_t readU32(const uint8_t* p) {
+        return p[0] | (p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+    }
+    
+    uint64_t readU64(const uint8_t* p) {
+        uint64_t v = 0;
+        for (int8_t i = 7; i >= 0; i--) v = (v << 8) | p[i];
+        return v;
+    }
+}
+
+ClockSync::ClockSync()
+    : listening(false), bursting(false), sent(0), burstSeq(0), nextSend(0), nextBurst(0),
+      bestOffset(0), bestLocal(0), bestDelay(UINT32_MAX), answered(0),
+      synced(false), refOffset(0), refLocal(0), driftPpm(0), errorUs(0), lastStepUs(0), lastSync(0), lastReturned(0) {
+    memset(requestTimes, 0, sizeof(requestTimes));
+}
+
+bool ClockSync::start() {
+    if (clockSyncConfig.server && !server.fromString(clockSyncConfig.server)) {
+        LOG_ERROR("❌ IP de sincronía inválida: %s", clockSyncConfig.server);
+        return false;
+    }
+    if (!server.isSet()) {
+        return false;  // Todavía sin dirección del broker primario
+    }
+    listening = udp.begin(clockSyncConfig.port);
+    if (listening) {
+        LOG_INFO("⏱️ Sincronía de reloj con %s:%d", server.toString().c_str(), clockSyncConfig.port);
+    }
+    return listening;
+}
+
+void ClockSync::setServer(const IPAddress& director) {
+    if (clockSyncConfig.server || !director.isSet() || (uint32_t)director == (uint32_t)server) {
+        return;
+    }
+    server = director;
+    LOG_INFO("⏱️ Servidor de reloj ahora %s (host del broker)", server.toString().c_str());
+    // Sin sincronía todavía: no esperar a la próxima ráfaga programada
+    if (!synced && !bursting) {
+        nextBurst = millis();
+    }
+}
+
+void ClockSync::sendRequest() {
+    uint8_t packet[ClockPacket::REQUEST_SIZE];
+    uint32_t seq = burstSeq + sent;
+    packet[0] = ClockPacket::MAGIC_0;
+    packet[1] = ClockPacket::MAGIC_1;
+    packet[2] = ClockPacket::VERSION;
+    packet[3] = ClockPacket::TYPE_REQUEST;
+    writeU32(packet + 4, seq);
+    
+    // t1 lo más cerca posible del envío
+    uint64_t t1 = micros64();
+    writeU64(packet + 8, t1);
+    udp.beginPacket(server, clockSyncConfig.port);
+    udp.write(packet, sizeof(packet));
+    udp.endPacket();
+    
+    requestTimes[sent] = t1;
+    sent++;
+    nextSend = millis() + SAMPLE_SPACING;
+}
+
+void ClockSync::readResponses() {
+    int size;
+    while ((size = udp.parsePacket()) > 0) {
+        uint64_t t4 = micros64();
+        uint8_t packet[ClockPacket::RESPONSE_SIZE];
+        if (size != (int)ClockPacket::RESPONSE_SIZE || udp.read(packet, sizeof(packet)) != (int)sizeof(packet) ||
+            packet[0] != ClockPacket::MAGIC_0 || packet[1] != ClockPacket::MAGIC_1 ||
+            packet[2] != ClockPacket::VERSION || packet[3] != ClockPacket::TYPE_RESPONSE) {
+            continue;
+        }
+        
+        // Solo respuestas de esta ráfaga con el t1 que mandamos (descarta viejas y ajenas)
+        uint32_t index = readU32(packet + 4) - burstSeq;
+        if (!bursting || index >= sent || readU64(packet + 8) != requestTimes[index]) {
+            continue;
+        }
+        uint64_t t1 = requestTimes[index];
+        uint64_t t2 = readU64(packet + 16);
+        uint64_t t3 = readU64(packet + 24);
+        
+        // NTP: offset = ((t2 - t1) + (t3 - t4)) / 2, ida y vuelta = (t4 - t1) - (t3 - t2)
+        int64_t roundTrip = (int64_t)(t4 - t1) - (int64_t)(t3 - t2);
+        if (roundTrip < 0) {
+            continue;
+        }
+        answered++;
+        if ((uint32_t)roundTrip < bestDelay) {
+            bestDelay = roundTrip;
+            bestOffset = ((int64_t)(t2 - t1) + (int64_t)(t3 - t4)) / 2;
+            bestLocal = t1 + (t4 - t1) / 2;
+        }
+    }
+}
+
+void ClockSync::finishBurst() {
+    bursting = false;
+    if (answered == 0) {
+        LOG_WARN("⚠️ Sin respuesta del servidor de reloj");
+        nextBurst = millis() + (synced ? clockSyncConfig.resyncInterval : FIRST_BURST_RETRY);
+        return;
+    }
+    
+    // Deriva: cuánto se movió el offset respecto del tiempo local transcurrido
+    if (synced && bestLocal - refLocal >= MIN_DRIFT_SPAN) {
+        float measured = (float)(bestOffset - refOffset) * 1e6f / (float)(bestLocal - refLocal);
+        if (measured > -MAX_DRIFT_PPM && measured < MAX_DRIFT_PPM) {
+            driftPpm += DRIFT_GAIN * (measured - driftPpm);
+        }
+    }
+    
+    // Corrección respecto de lo que predecía el modelo (0 en la primera ráfaga)
+    int64_t step = synced ? bestOffset - (refOffset + (int64_t)(driftPpm * (float)(bestLocal - refLocal) / 1e6f)) : 0;
+    lastStepUs = (int32_t)constrain(step, (int64_t)INT32_MIN, (int64_t)INT32_MAX);
+    refOffset = bestOffset;
+    refLocal = bestLocal;
+    errorUs = bestDelay / 2;
+    synced = true;
+    lastSync = millis();
+    nextBurst = lastSync + clockSyncConfig.resyncInterval;
+    
+    LOG_INFO("⏱️ Reloj sincronizado: ajuste %ld us, deriva %.1f ppm, error <= %lu us (%u/%u respuestas)",
+             (long)lastStepUs, driftPpm, (unsigned long)errorUs, answered, sent);
+}
+
+void ClockSync::loop() {
+    if (!clockSyncConfig.enabled) {
+        return;
+    }
+    if (WiFi.status() != WL_CONNECTED) {
+        if (listening) {
+            udp.stop();
+            listening = false;
+        }
+        bursting = false;
+        return;
+    }
+    if (!listening && !start()) {
+        return;
+    }
+    
+    readResponses();
+    
+    if (!bursting) {
+        if ((long)(millis() - nextBurst) >= 0) {
+            bursting = true;
+            sent = 0;
+            answered = 0;
+            bestDelay = UINT32_MAX;
+            burstSeq += SAMPLES;
+        }
+        return;
+    }
+    
+    if (sent < SAMPLES) {
+        if ((long)(millis() - nextSend) >= 0) {
+            sendRequest();
+        }
+    } else if ((long)(millis() - nextSend) >= (long)RESPONSE_WAIT) {
+        finishBurst();
+    }
+}
+
+uint64_t ClockSync::syncedMicros() {
+    if (!synced) {
+        return 0;
+    }
+    uint64_t local = micros64();
+    int64_t elapsed = (int64_t)(local - refLocal);
+    int64_t offset = refOffset + (int64_t)(driftPpm * (float)elapsed / 1e6f);
+    uint64_t now = local + offset;
+    // Un ajuste hacia atrás no hace retroceder la hora ya entregada
+    if (now < lastReturned) {
+        return lastReturned;
+    }
+    lastReturned = now;
+    return now;
+}
@@ -0,0 +1,84 @@
+#ifndef CLOCK_SYNC_H
+#define CLOCK_SYNC_H
+
+#include <Arduino.h>
+#include <WiFiUdp.h>
+
+// Intercambio tipo NTP con el director por UDP (services/clockServer.js):
+//   pedido    16 bytes: "OC", versión, tipo 1, secuencia u32, t1 u64
+//   respuesta 32 bytes: "OC", versión, tipo 2, secuencia u32, t1 u64 (eco), t2 u64, t3 u64
+// t1 es micros64() del dispositivo; t2/t3 son µs desde epoch en el director
+// (recepción y envío). Enteros little-endian.
+namespace ClockPacket {
+    constexpr uint8_t MAGIC_0 = 'O';
+    constexpr uint8_t MAGIC_1 = 'C';
+    constexpr uint8_t VERSION = 1;
+    constexpr uint8_t TYPE_REQUEST = 1;
+    constexpr uint8_t TYPE_RESPONSE = 2;
+    constexpr size_t REQUEST_SIZE = 16;
+    constexpr size_t RESPONSE_SIZE = 32;
+}
+
+// Reloj del director en el dispositivo. Cada ráfaga manda varios pedidos y se
+// queda con el de menor ida y vuelta (el error es a lo sumo la mitad de ese
+// tiempo); entre ráfagas se estima la deriva del cristal, así synced_time()
+// sigue alineado entre resincronizaciones. No bloquea: loop() avanza un paso.
+class ClockSync {
+private:
+    static const uint8_t SAMPLES = 8;
+    
+    WiFiUDP udp;
+    bool listening;
+    IPAddress server;
+    
+    // Ráfaga en curso
+    bool bursting;
+    uint8_t sent;
+    uint32_t burstSeq;                 // Secuencia del primer pedido de la ráfaga
+    uint64_t requestTimes[SAMPLES];    // t1 de cada pedido
+    unsigned long nextSend;
+    unsigned long nextBurst;
+    int64_t bestOffset;                // Del pedido con menor ida y vuelta
+    uint64_t bestLocal;                // Punto medio local de ese pedido
+    uint32_t bestDelay;
+    uint8_t answered;
+    
+    // Modelo: director = local + offset + deriva * (local - refLocal)
+    bool synced;
+    int64_t refOffset;
+    uint64_t refLocal;
+    float driftPpm;
+    uint32_t errorUs;
+    int32_t lastStepUs;                // Corrección aplicada en la última ráfaga
+    unsigned long lastSync;            // millis() de la última ráfaga buena
+    uint64_t lastReturned;             // synced_time() nunca retrocede
+    
+    bool start();
+    void sendRequest();
+    void readResponses();
+    void finishBurst();
+    
+public:
+    ClockSync();
+    void loop();
+    // Host del director según el broker primario; solo se usa sin server en config
+    void setServer(const IPAddress& director);
+    bool isSynced() const { return synced; }
+    uint64_t syncedMicros();           // µs desde epoch del director, 0 si nunca sincronizó
+    uint64_t syncedMillis() { return syncedMicros() / 1000; }
+    int64_t getOffsetUs() const { return refOffset; }
+    float getDriftPpm() const { return driftPpm; }
+    uint32_t getErrorUs() const { return errorUs; }
+    int32_t getLastStepUs() const { return lastStepUs; }
+    unsigned long getLastSyncAge() const { return synced ? millis() - lastSync : 0; }
+};
+
+extern ClockSync clockSync;
+
+// Milisegundos desde epoch en el reloj del director (0 si no hay sincronía).
+// Es la base común para agendar eventos y comparar latencias entre Osmos.
+inline uint64_t synced_time() {
+    return clockSync.syncedMillis();
+}
+
+#endif
@@ -0,0 +1,155 @@
+#include "command_bundle.h"
+
+namespace {
+    const char* skipSpace(const char* p) {
+        while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') {
+            p++;
+        }
+        return p;
+    }
+
+    // p apunta a la comilla de apertura; devuelve lo que sigue a la de cierre
+    const char* skipString(const char* p) {
+        for (p++; *p; p++) {
+            if (*p == '\\' && p[1]) {
+                p++;
+            } else if (*p == '"') {
+                return p + 1;
+            }
+        }
+        return nullptr;
+    }
+
+    // Saltea un valor JSON cualquiera; nullptr si está cortado
+    const char* skipValue(const char* p) {
+        if (*p == '"') {
+            return skipString(p);
+        }
+        if (*p == '{' || *p == '[') {
+            int depth = 0;
+            while (*p) {
+                if (*p == '"') {
+                    p = skipString(p);
+                    if (!p) {
+                        return nullptr;
+                    }
+                    continue;
+                }
+                if (*p == '{' || *p == '[') {
+                    depth++;
+                } else if (*p == '}' || *p == ']') {
+                    if (--depth == 0) {
+                        return p + 1;
+                    }
+                }
+                p++;
+            }
+            return nullptr;
+        }
+        // Número, true/false/null
+        while (*p && *p != ',' && *p != '}' && *p != ']') {
+            p++;
+        }
+        return p;
+    }
+
+    // Compara la clave en p (comilla incluida) con name, sin escapes
+    bool keyEquals(const char* p, const char* name) {
+        size_t length = strlen(name);
+        return strncmp(p + 1, name, length) == 0 && p[1 + length] == '"';
+    }
+
+    // Recorre las claves de "units" desde p ('{'); deja en [from, to) el valor de
+    // unitId o, si no está, el de "*". Devuelve lo que sigue al objeto.
+    const char* findPart(const char* p, const char* unitId, const char*& from, const char*& to) {
+        const char* wildcard = nullptr;
+        const char* wildcardEnd = nullptr;
+        from = to = nullptr;
+        p = skipSpace(p + 1);
+        while (*p == '"') {
+            bool mine = keyEquals(p, unitId);
+            bool any = keyEquals(p, "*");
+            p = skipString(p);
+            if (!p) {
+                return nullptr;
+            }
+            p = skipSpace(p);
+            if (*p != ':') {
+                return nullptr;
+            }
+            const char* value = skipSpace(p + 1);
+            const char* end = skipValue(value);
+            if (!end) {
+                return nullptr;
+            }
+            if (mine) {
+                from = value;
+                to = end;
+            } else if (any) {
+                wildcard = value;
+                wildcardEnd = end;
+            }
+            p = skipSpace(end);
+            if (*p == ',') {
+                p = skipSpace(p + 1);
+            }
+        }
+        if (!from) {
+            from = wildcard;
+            to = wildcardEnd;
+        }
+        return *p == '}' ? p + 1 : nullptr;
+    }
+}
+
+bool CommandBundle::extract(const char* json, const char* unitId, String& part, uint32_t& seq) {
+    part = "";
+    seq = 0;
+    const char* p = skipSpace(json);
+    if (*p != '{') {
+        return false;
+    }
+
+    // Claves del objeto raíz: "units" y el "seq" del bundle, en cualquier orden
+    bool isBundle = false;
+    p = skipSpace(p + 1);
+    while (*p == '"') {
+        bool isUnits = keyEquals(p, "units");
+        bool isSeq = keyEquals(p, "seq");
+        p = skipString(p);
+        if (!p) {
+            return isBundle;
+        }
+        p = skipSpace(p);
+        if (*p != ':') {
+            return isBundle;
+        }
+        p = skipSpace(p + 1);
+
+        if (isUnits && *p == '{') {
+            const char* from;
+            const char* to;
+            isBundle = true;
+            p = findPart(p, unitId, from, to);
+            if (!p) {
+                return true;
+            }
+            if (from) {
+                part.concat(from, to - from);
+            }
+        } else {
+            if (isSeq) {
+                seq = strtoul(p, nullptr, 10);
+            }
+            p = skipValue(p);
+            if (!p) {
+                return isBundle;
+            }
+        }
+        p = skipSpace(p);
+        if (*p == ',') {
+            p = skipSpace(p + 1);
+        }
+    }
+    return isBundle;
+}
@@ -0,0 +1,18 @@
+#ifndef COMMAND_BUNDLE_H
+#define COMMAND_BUNDLE_H
+
+#include <Arduino.h>
+
+// Bundle: un solo publish en un topic de grupo con el sub-comando de cada
+// unidad, {"units":{"osmo_norte":{...},"osmo_sur":{...},"*":{...}}}. "*" es
+// para las unidades sin entrada propia. Cada unidad recorre el texto una vez
+// sin parsearlo entero y copia solo su parte, que después se parsea como un
+// comando normal: el documento JSON no crece con el tamaño del bundle.
+namespace CommandBundle {
+    // true si json es un bundle; part queda con el sub-comando de unitId
+    // (o el de "*"), vacío si no hay nada para esta unidad. seq es el del
+    // bundle (0 si no tiene): cuenta para todas las unidades del grupo.
+    bool extract(const char* json, const char* unitId, String& part, uint32_t& seq);
+}
+
+#endif
@@ -1,6 +1,10 @@
 #include "command_definition.h"
+#include "log.h"
 #include <ArduinoJson.h>
 #include "config.h"
+#include "clock_sync.h"
+#include "command_sequence.h"
+#include "power_profile.h"
 
 // Definición de acciones disponibles
 namespace Commands {
@@ -11,8 +15,12 @@ namespace Commands {
     const char* REBOOT = "reboot";
     const char* RESET_CONFIG = "reset_config";
     const char* HEARTBEAT = "heartbeat";
+    const char* STOP_ALL = "stop_all";
+    const char* SET_POWER_PROFILE = "set_power_profile";
+    const char* PROBE = "probe";
 }
 
+
 // Códigos de respuesta
 namespace ResponseCodes {
     const int SUCCESS = 200;
@@ -22,6 +30,7 @@ namespace ResponseCodes {
     const int PUMP_NOT_FOUND = 404;
     const int INTERNAL_ERROR = 500;
     const int NETWORK_ERROR = 503;
+    const int BUSY = 409;
 }
 
 // Constantes de validación
@@ -32,6 +41,10 @@ namespace Validation {
     const int MAX_DURATION = 60000;    // 60 segundos máximo
     const int MIN_CONFIG_TIME = 1000;  // 1 segundo mínimo
     const int MAX_CONFIG_TIME = 300000; // 5 minutos máximo
+    const int MIN_PROBE_DURATION = 2000;
+    const int MAX_PROBE_DURATION = 60000;
+    const int MIN_PROBE_INTERVAL = 50;   // Más seguido satura la cola de ecos (LinkProbe::PENDING)
+    const int MAX_PROBE_INTERVAL = 5000;
 }
 
 // Mensajes de error predefinidos
@@ -44,6 +57,7 @@ namespace ErrorMessages {
     const char* INVALID_PARAMS = "Parámetros inválidos";
     const char* NETWORK_ERROR = "Error de red";
     const char* INTERNAL_ERROR = "Error interno del sistema";
+    const char* PROBE_RUNNING = "Sondeo en curso";
 }
 
 // Mensajes de éxito predefinidos
@@ -54,6 +68,9 @@ namespace SuccessMessages {
     const char* STATUS_RETRIEVED = "Estado obtenido correctamente";
     const char* REBOOT_INITIATED = "Reinicio iniciado";
     const char* CONFIG_RESET = "Configuración restablecida";
+    const char* ALL_PUMPS_STOPPED = "Todas las bombas detenidas";
+    const char* POWER_PROFILE_SET = "Perfil de energía aplicado";
+    const char* PROBE_STARTED = "Sondeo de enlace iniciado";
 }
 
 // Función para crear respuesta de comando
@@ -132,6 +149,58 @@ PumpConfigParams extractPumpConfigParams(const String& params) {
     return configParams;
 }
 
+// Función para extraer parámetros de get_status
+StatusRequestParams extractStatusRequestParams(const String& params) {
+    StatusRequestParams statusParams;
+    statusParams.includeStats = false;
+    
+    StaticJsonDocument<128> doc;
+    DeserializationError error = deserializeJson(doc, params);
+    
+    if (!error) {
+        if (doc.containsKey("include_stats")) {
+            statusParams.includeStats = doc["include_stats"];
+        }
+    }
+    
+    return statusParams;
+}
+
+// Función para extraer parámetros de set_power_profile
+PowerProfileParams extractPowerProfileParams(const String& params) {
+    PowerProfileParams profileParams;
+    
+    StaticJsonDocument<64> doc;
+    DeserializationError error = deserializeJson(doc, params);
+    
+    if (!error) {
+        profileParams.profile = doc["profile"] | "";
+    }
+    
+    return profileParams;
+}
+
+// Función para extraer parámetros de probe
+ProbeParams extractProbeParams(const String& params) {
+    ProbeParams probeParams;
+    probeParams.durationMs = 10000;
+    probeParams.intervalMs = 100;
+    
+    StaticJsonDocument<96> doc;
+    DeserializationError error = deserializeJson(doc, params);
+    
+    if (!error) {
+        if (doc.containsKey("duration_ms")) {
+            probeParams.durationMs = doc["duration_ms"];
+        }
+        if (doc.containsKey("interval_ms")) {
+            probeParams.intervalMs = doc["interval_ms"];
+        }
+    }
+    
+    return probeParams;
+}
+
 // Función para validar parámetros de comando
 bool validateCommandParams(const MQTTCommand& cmd) {
     if (cmd.action == Commands::ACTIVATE_PUMP) {
@@ -164,6 +233,21 @@ bool validateCommandParams(const MQTTCommand& cmd) {
     else if (cmd.action == Commands::GET_STATUS) {
         return true; // No requiere parámetros
     }
+    else if (cmd.action == Commands::STOP_ALL) {
+        return true; // No requiere parámetros
+    }
+    else if (cmd.action == Commands::SET_POWER_PROFILE) {
+        PowerProfileParams params = extractPowerProfileParams(cmd.params);
+        PowerProfile profile;
+        return PowerManager::parse(params.profile.c_str(), profile);
+    }
+    else if (cmd.action == Commands::PROBE) {
+        ProbeParams params = extractProbeParams(cmd.params);
+        return params.durationMs >= (unsigned long)Validation::MIN_PROBE_DURATION &&
+               params.durationMs <= (unsigned long)Validation::MAX_PROBE_DURATION &&
+               params.intervalMs >= (unsigned long)Validation::MIN_PROBE_INTERVAL &&
+               params.intervalMs <= (unsigned long)Validation::MAX_PROBE_INTERVAL;
+    }
     else if (cmd.action == Commands::REBOOT || cmd.action == Commands::RESET_CONFIG) {
         return true; // No requiere parámetros
     }
@@ -179,6 +263,9 @@ String createResponseJSON(const CommandResponse& response) {
     doc["command_id"] = response.commandId;
     doc["success"] = response.success;
     doc["timestamp"] = response.timestamp;
+    if (clockSync.isSynced()) {
+        doc["synced_ms"] = synced_time();
+    }
     doc["unit_id"] = deviceConfig.unitId;
     
     String jsonString;
@@ -186,29 +273,122 @@ String createResponseJSON(const CommandResponse& response) {
     return jsonString;
 }
 
+// Claves de bomba ("0".."15") y strings copiados (unitId, status)
+namespace {
+    const size_t PUMP_KEY_SIZE = 4;
+    const size_t STRING_SLACK = 64;
+}
+
+size_t statusJSONCapacity(int pumpCount, bool withStats) {
+    size_t capacity = JSON_OBJECT_SIZE(6) + JSON_OBJECT_SIZE(pumpCount) +
+                      pumpCount * (JSON_OBJECT_SIZE(2) + PUMP_KEY_SIZE) + STRING_SLACK;
+    if (withStats) {
+        capacity += JSON_OBJECT_SIZE(pumpCount) + pumpCount * (JSON_OBJECT_SIZE(5) + PUMP_KEY_SIZE);
+    }
+    return capacity;
+}
+
+size_t statsJSONCapacity(int pumpCount) {
+    return JSON_OBJECT_SIZE(5) + JSON_OBJECT_SIZE(pumpCount) +
+           pumpCount * (JSON_OBJECT_SIZE(5) + PUMP_KEY_SIZE) +
+           JSON_OBJECT_SIZE(5) + JSON_OBJECT_SIZE(6) + JSON_OBJECT_SIZE(4) + STRING_SLACK;  // clock + commands + power
+}
+
 // Función para crear JSON de estado
 String createStatusJSON(const DeviceStatusData& statusData) {
-    StaticJsonDocument<512> doc;
+    DynamicJsonDocument doc(statusJSONCapacity(statusData.pumpCount, statusData.stats != nullptr));
+    buildStatusJSON(statusData, doc);
+    
+    String jsonString;
+    serializeJson(doc, jsonString);
+    return jsonString;
+}
+
+void buildStatusJSON(const DeviceStatusData& statusData, JsonDocument& doc, uint32_t fields) {
     doc["unit_id"] = statusData.unitId;
-    doc["status"] = statusData.status;
+    if (fields & StatusFields::DEVICE) {
+        doc["status"] = statusData.status;
+    }
    // doc["timestamp"] = statusData.timestamp;
    // doc["pump_count"] = statusData.pumpCount;
     
     // Crear objeto de bombas con datos reales
     JsonObject pumps = doc.createNestedObject("pumps");
     for (int i = 0; i < statusData.pumpCount; i++) {
+        if (!(fields & StatusFields::pump(i))) {
+            continue;
+        }
         JsonObject pump = pumps.createNestedObject(String(i));
-        pump["active"] = statusData.pumps[i].active;
-        pump["available"] = statusData.pumps[i].available;
+        if (fields & StatusFields::pumpActive(i)) {
+            pump["active"] = statusData.pumps[i].active;
+        }
+        if (fields & StatusFields::pumpAvailable(i)) {
+            pump["available"] = statusData.pumps[i].available;
+        }
        // pump["cooldown_remaining"] = statusData.pumps[i].cooldown_remaining;
        // pump["level"] = statusData.pumps[i].level;
     }
     
+    // Estadísticas de uso solo si fueron solicitadas
+    if (statusData.stats) {
+        JsonObject stats = doc.createNestedObject("stats");
+        for (int i = 0; i < statusData.pumpCount; i++) {
+            JsonObject pump = stats.createNestedObject(String(i));
+            pump["activations"] = statusData.stats[i].activations;
+            pump["on_time"] = statusData.stats[i].totalOnTime;
+            pump["cooldown_rejects"] = statusData.stats[i].cooldownRejects;
+            pump["forced"] = statusData.stats[i].forcedActivations;
+            pump["longest_run"] = statusData.stats[i].longestRun;
+        }
+    }
+}
+
+// Función para crear JSON de estadísticas
+String createStatsJSON(const String& unitId, const PumpStatsData* stats, int pumpCount) {
+    DynamicJsonDocument doc(statsJSONCapacity(pumpCount));
+    buildStatsJSON(unitId, stats, pumpCount, doc);
+    
     String jsonString;
     serializeJson(doc, jsonString);
     return jsonString;
 }
 
+void buildStatsJSON(const String& unitId, const PumpStatsData* stats, int pumpCount, JsonDocument& doc) {
+    doc["unit_id"] = unitId;
+    doc["uptime"] = millis();
+    
+    JsonObject pumps = doc.createNestedObject("pumps");
+    for (int i = 0; i < pumpCount; i++) {
+        JsonObject pump = pumps.createNestedObject(String(i));
+        pump["activations"] = stats[i].activations;
+        pump["on_time"] = stats[i].totalOnTime;
+        pump["cooldown_rejects"] = stats[i].cooldownRejects;
+        pump["forced"] = stats[i].forcedActivations;
+        pump["longest_run"] = stats[i].longestRun;
+    }
+    
+    JsonObject clock = doc.createNestedObject("clock");
+    clock["synced"] = clockSync.isSynced();
+    clock["error_us"] = clockSync.getErrorUs();
+    clock["drift_ppm"] = clockSync.getDriftPpm();
+    clock["last_step_us"] = clockSync.getLastStepUs();
+    clock["age_ms"] = clockSync.getLastSyncAge();
+    
+    JsonObject commands = doc.createNestedObject("commands");
+    commands["gaps"] = commandSequence.getGaps();
+    commands["missing"] = commandSequence.getMissing();
+    commands["late"] = commandSequence.getLate();
+    commands["duplicates"] = commandSequence.getDuplicates();
+    commands["stale"] = commandSequence.getStale();
+    commands["resyncs"] = commandSequence.getResyncs();
+    
+    JsonObject power = doc.createNestedObject("power");
+    power["profile"] = PowerManager::name(powerManager.get());
+    power["source"] = PowerManager::sourceName(powerManager.getSource());
+    power["switches"] = powerManager.getSwitches();
+    power["cpu_mhz"] = ESP.getCpuFreqMHz();
+}
+
 // Función para crear JSON de error
 String createErrorJSON(const String& errorType, const String& message) {
     StaticJsonDocument<256> doc;
@@ -222,6 +402,24 @@ String createErrorJSON(const String& errorType, const String& message) {
     return jsonString;
 }
 
+String createEventJSON(const String& event, int pumpId) {
+    StaticJsonDocument<192> doc;
+    doc["event"] = event;
+    if (pumpId >= 0) {
+        doc["pump_id"] = pumpId;
+    }
+    doc["timestamp"] = millis();
+    // Hora común del director: ordena eventos de distintas unidades
+    if (clockSync.isSynced()) {
+        doc["synced_ms"] = synced_time();
+    }
+    doc["unit_id"] = deviceConfig.unitId;
+    
+    String jsonString;
+    serializeJson(doc, jsonString);
+    return jsonString;
+}
+
 // Función para parsear comando desde JSON
 MQTTCommand parseCommandFromJSON(const String& json) {
     MQTTCommand cmd;
@@ -229,6 +427,7 @@ MQTTCommand parseCommandFromJSON(const String& json) {
     cmd.action = "";
     cmd.params = "";
     cmd.timestamp = 0;
+    cmd.seq = 0;
     
     StaticJsonDocument<512> doc;
     DeserializationError error = deserializeJson(doc, json);
@@ -249,6 +448,7 @@ MQTTCommand parseCommandFromJSON(const String& json) {
         if (doc.containsKey("timestamp")) {
             cmd.timestamp = doc["timestamp"];
         }
+        cmd.seq = doc["seq"] | 0UL;
     }
     
     return cmd;
@@ -258,19 +458,14 @@ MQTTCommand parseCommandFromJSON(const String& json) {
 bool processCommand(const MQTTCommand& cmd) {
     // Validar parámetros primero
     if (!validateCommandParams(cmd)) {
-        Serial.print("❌ Parámetros inválidos para comando: ");
-        Serial.println(cmd.action);
+        LOG_ERROR("❌ Parámetros inválidos para comando: %s", cmd.action.c_str());
         return false;
     }
     
     // Procesar comando según la acción
     if (cmd.action == Commands::ACTIVATE_PUMP) {
         PumpActivationParams params = extractPumpActivationParams(cmd.params);
-        Serial.print("🔧 Activando bomba ");
-        Serial.print(params.pumpId);
-        Serial.print(" por ");
-        Serial.print(params.duration);
-        Serial.println(" ms");
+        LOG_INFO("🔧 Activando bomba %d por %d ms", params.pumpId, params.duration);
         
         // Aquí se integrará con PumpController
         // pumpController.activatePump(params.pumpId, params.duration, params.force);
@@ -279,8 +474,7 @@ bool processCommand(const MQTTCommand& cmd) {
     }
     else if (cmd.action == Commands::DEACTIVATE_PUMP) {
         PumpActivationParams params = extractPumpActivationParams(cmd.params);
-        Serial.print("🔧 Desactivando bomba ");
-        Serial.println(params.pumpId);
+        LOG_INFO("🔧 Desactivando bomba %d", params.pumpId);
         
         // Aquí se integrará con PumpController
         // pumpController.deactivatePump(params.pumpId);
@@ -288,23 +482,17 @@ bool processCommand(const MQTTCommand& cmd) {
         return true;
     }
     else if (cmd.action == Commands::GET_STATUS) {
-        Serial.println("🔧 Obteniendo estado del dispositivo");
+        LOG_INFO("🔧 Obteniendo estado del dispositivo");
         
         // Aquí se integrará con StatusPublisher
         // String status = statusPublisher.createStatusJSON();
-        // networkManager.publishWithQoS(statusTopic, status.c_str(), 1);
+        // networkManager.enqueue(PublishClass::Status, statusTopic, status.c_str());
         
         return true;
     }
     else if (cmd.action == Commands::SET_PUMP_CONFIG) {
         PumpConfigParams params = extractPumpConfigParams(cmd.params);
-        Serial.print("🔧 Configurando bomba ");
-        Serial.print(params.pumpId);
-        Serial.print(" - Activación: ");
-        Serial.print(params.activationTime);
-        Serial.print(" ms, Cooldown: ");
-        Serial.print(params.cooldownTime);
-        Serial.println(" ms");
+        LOG_INFO("🔧 Configurando bomba %d - Activación: %d ms, Cooldown: %d ms", params.pumpId, params.activationTime, params.cooldownTime);
         
         // Integrar con PumpController para actualizar configuración
         // Nota: Se necesita acceso a la instancia de PumpController
@@ -313,13 +501,13 @@ bool processCommand(const MQTTCommand& cmd) {
         return true;
     }
     else if (cmd.action == Commands::REBOOT) {
-        Serial.println("🔧 Reiniciando dispositivo...");
+        LOG_INFO("🔧 Reiniciando dispositivo...");
         delay(1000);
         ESP.restart();
         return true;
     }
     else if (cmd.action == Commands::RESET_CONFIG) {
-        Serial.println("🔧 Restableciendo configuración...");
+        LOG_INFO("🔧 Restableciendo configuración...");
         
         // Implementar reset de configuración
         // Nota: Se necesita acceso a la instancia de PumpController
@@ -328,8 +516,7 @@ bool processCommand(const MQTTCommand& cmd) {
         return true;
     }
     else {
-        Serial.print("❌ Comando no reconocido: ");
-        Serial.println(cmd.action);
+        LOG_ERROR("❌ Comando no reconocido: %s", cmd.action.c_str());
         return false;
     }
 }
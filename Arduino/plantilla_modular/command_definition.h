@@ -2,6 +2,7 @@
 #define COMMAND_DEFINITIONS_H
 
 #include <Arduino.h>
+#include <ArduinoJson.h>
 
 // Estructura para comandos MQTT
 struct MQTTCommand {
@@ -9,6 +10,7 @@ struct MQTTCommand {
     String action;
     String params;
     unsigned long timestamp;
+    uint32_t seq;  // Secuencia del director por topic (0 = sin número)
 };
 
 // Definición de acciones disponibles
@@ -20,6 +22,21 @@ namespace Commands {
     extern const char* REBOOT;
     extern const char* RESET_CONFIG;
     extern const char* HEARTBEAT;
+    extern const char* STOP_ALL;
+    extern const char* SET_POWER_PROFILE;
+    extern const char* PROBE;
+}
+
+// Parada de emergencia: reconocida por prefijo en el callback MQTT,
+// antes de parsear JSON o validar nada. constexpr para conocer el
+// largo en compilación.
+namespace StopAll {
+    constexpr char TOPIC_PREFIX[] = "motete/director/stop";  // + "/<unit>" opcional
+    constexpr char UNIT_TOPIC_PREFIX[] = "motete/director/stop/";  // TOPIC_PREFIX + "/", antes del unitId
+    constexpr char PAYLOAD[] = "stop_all";  // comando corto en el topic de comandos
+    // Desde que entra el callback MQTT (o se lee el datagrama UDP) hasta
+    // salidas apagadas; la ruta JSON suma el parseo del comando
+    constexpr unsigned long LATENCY_TARGET_US = 20000;
 }
 
 // Estructura para parámetros de activación de bomba
@@ -36,6 +53,17 @@ struct PumpConfigParams {
     int cooldownTime;
 };
 
+// Estructura para parámetros de set_power_profile
+struct PowerProfileParams {
+    String profile;  // "show" o "idle"
+};
+
+// Estructura para parámetros de probe
+struct ProbeParams {
+    unsigned long durationMs;  // duración total del sondeo
+    unsigned long intervalMs;  // entre muestras de RSSI y pings de eco
+};
+
 // Estructura para datos de estado de bomba
 struct PumpStatusData {
     bool active;
@@ -44,15 +72,41 @@ struct PumpStatusData {
     int level;
 };
 
+// Estructura para estadísticas de uso acumuladas por bomba
+struct PumpStatsData {
+    unsigned long activations;        // activaciones aceptadas
+    unsigned long totalOnTime;        // ms acumulados encendida
+    unsigned long cooldownRejects;    // activaciones rechazadas por cooldown
+    unsigned long forcedActivations;  // activaciones con force durante cooldown
+    unsigned long longestRun;         // ms de la activación continua más larga
+};
+
+// Estructura para parámetros de get_status
+struct StatusRequestParams {
+    bool includeStats;  // incluir estadísticas de uso en el estado
+};
+
 // Estructura para estado completo del dispositivo
 struct DeviceStatusData {
     String unitId;
     String status;
     PumpStatusData* pumps;
+    const PumpStatsData* stats;  // nullptr si no se incluyen estadísticas
     int pumpCount;
     unsigned long timestamp;
 };
 
+// Campos del estado como bits: un delta lleva solo los marcados. Bit 0 es el
+// estado del dispositivo; cada bomba usa dos bits (active, available).
+namespace StatusFields {
+    constexpr uint8_t MAX_PUMPS = 15;  // 1 + 2 * 15 bits en un uint32_t
+    constexpr uint32_t DEVICE = 1UL << 0;
+    constexpr uint32_t ALL = 0xFFFFFFFFUL;
+    constexpr uint32_t pumpActive(int pumpId) { return 1UL << (1 + 2 * pumpId); }
+    constexpr uint32_t pumpAvailable(int pumpId) { return 1UL << (2 + 2 * pumpId); }
+    constexpr uint32_t pump(int pumpId) { return pumpActive(pumpId) | pumpAvailable(pumpId); }
+}
+
 // Códigos de respuesta
 namespace ResponseCodes {
     extern const int SUCCESS;
@@ -62,6 +116,7 @@ namespace ResponseCodes {
     extern const int PUMP_NOT_FOUND;
     extern const int INTERNAL_ERROR;
     extern const int NETWORK_ERROR;
+    extern const int BUSY;
 }
 
 // Estructura para respuestas de comandos
@@ -88,15 +143,38 @@ PumpActivationParams extractPumpActivationParams(const String& params);
 // Función para extraer parámetros de configuración de bomba
 PumpConfigParams extractPumpConfigParams(const String& params);
 
+// Función para extraer parámetros de get_status
+StatusRequestParams extractStatusRequestParams(const String& params);
+
+// Función para extraer parámetros de set_power_profile
+PowerProfileParams extractPowerProfileParams(const String& params);
+
+// Función para extraer parámetros de probe
+ProbeParams extractProbeParams(const String& params);
+
 // Función para crear JSON de respuesta
 String createResponseJSON(const CommandResponse& response);
 
 // Función para crear JSON de estado
 String createStatusJSON(const DeviceStatusData& statusData);
 
+// Función para crear JSON de estadísticas
+String createStatsJSON(const String& unitId, const PumpStatsData* stats, int pumpCount);
+
+// Documentos de estado/estadísticas sin serializar: se miden y se escriben
+// directo al socket (NetworkManager::publishJson). La capacidad crece con
+// la cantidad de bombas en lugar de un tamaño fijo.
+size_t statusJSONCapacity(int pumpCount, bool withStats);
+size_t statsJSONCapacity(int pumpCount);
+void buildStatusJSON(const DeviceStatusData& statusData, JsonDocument& doc, uint32_t fields = StatusFields::ALL);
+void buildStatsJSON(const String& unitId, const PumpStatsData* stats, int pumpCount, JsonDocument& doc);
+
 // Función para crear JSON de error
 String createErrorJSON(const String& errorType, const String& message);
 
+// Función para crear JSON de evento (pumpId < 0 si no aplica a una bomba)
+String createEventJSON(const String& event, int pumpId);
+
 // Función para parsear comando desde JSON
 MQTTCommand parseCommandFromJSON(const String& json);
 
@@ -117,6 +195,10 @@ namespace Validation {
     extern const int MAX_DURATION;
     extern const int MIN_CONFIG_TIME;
     extern const int MAX_CONFIG_TIME;
+    extern const int MIN_PROBE_DURATION;
+    extern const int MAX_PROBE_DURATION;
+    extern const int MIN_PROBE_INTERVAL;
+    extern const int MAX_PROBE_INTERVAL;
 }
 
 // Mensajes de error predefinidos
@@ -129,6 +211,7 @@ namespace ErrorMessages {
     extern const char* INVALID_PARAMS;
     extern const char* NETWORK_ERROR;
     extern const char* INTERNAL_ERROR;
+    extern const char* PROBE_RUNNING;
 }
 
 // Mensajes de éxito predefinidos
@@ -139,6 +222,9 @@ namespace SuccessMessages {
     extern const char* STATUS_RETRIEVED;
     extern const char* REBOOT_INITIATED;
     extern const char* CONFIG_RESET;
+    extern const char* ALL_PUMPS_STOPPED;
+    extern const char* POWER_PROFILE_SET;
+    extern const char* PROBE_STARTED;
 }
 
 #endif // COMMAND_DEFINITIONS_H
@@ -0,0 +1,70 @@
+#include "command_sequence.h"
+
+CommandSequence commandSequence;
+
+CommandSequence::CommandSequence() : gaps(0), missing(0), late(0), duplicates(0), stale(0), resyncs(0) {
+    reset();
+}
+
+void CommandSequence::reset() {
+    for (uint8_t i = 0; i < MAX_SOURCES; i++) {
+        streams[i].started = false;
+        streams[i].last = 0;
+        streams[i].seen = 0;
+    }
+}
+
+SeqResult CommandSequence::check(uint8_t source, uint32_t seq, uint32_t& gapFrom, uint32_t& gapTo) {
+    if (seq == 0 || source >= MAX_SOURCES) {
+        return SeqResult::Untracked;
+    }
+
+    Stream& stream = streams[source];
+    // Primer comando tras arrancar: lo anterior lo reentrega la sesión persistente
+    if (!stream.started) {
+        stream.started = true;
+        stream.last = seq;
+        stream.seen = 1;
+        return SeqResult::InOrder;
+    }
+
+    // Resta con signo: tolera el desborde de seq
+    int32_t ahead = (int32_t)(seq - stream.last);
+
+    if (ahead > 0) {
+        if (ahead > WINDOW) {
+            // Demasiado lejos para pedir lo que falta: el director reinició o hubo un corte largo
+            resyncs++;
+            stream.last = seq;
+            stream.seen = 1;
+            return SeqResult::Resync;
+        }
+        stream.seen = (ahead >= 32 ? 0 : stream.seen << ahead) | 1;
+        stream.last = seq;
+        if (ahead == 1) {
+            return SeqResult::InOrder;
+        }
+        gapFrom = seq - ahead + 1;
+        gapTo = seq - 1;
+        gaps++;
+        missing += ahead - 1;
+        return SeqResult::Gap;
+    }
+
+    uint32_t behind = (uint32_t)(-ahead);
+    if (behind >= WINDOW) {
+        // Muy atrás: un reenvío viejo. El director arranca su seq desde el reloj,
+        // así que un reinicio siempre salta hacia adelante; volver la base atrás
+        // haría procesar un comando vencido.
+        stale++;
+        return SeqResult::Stale;
+    }
+    uint32_t bit = 1UL << behind;
+    if (stream.seen & bit) {
+        duplicates++;
+        return SeqResult::Duplicate;
+    }
+    stream.seen |= bit;
+    late++;
+    return SeqResult::Late;
+}
@@ -0,0 +1,57 @@
+#ifndef COMMAND_SEQUENCE_H
+#define COMMAND_SEQUENCE_H
+
+#include <Arduino.h>
+
+// Resultado de comparar el "seq" de un comando con lo ya visto de su fuente
+enum class SeqResult : uint8_t {
+    Untracked,  // Sin seq o fuente desconocida: se procesa como antes
+    InOrder,    // El siguiente esperado
+    Gap,        // Se saltaron números: se procesa y se pide lo que falta
+    Late,       // Faltante que llegó tarde (reordenado o reenviado): se procesa
+    Duplicate,  // Ya visto dentro de la ventana: se descarta
+    Stale,      // Más viejo que la ventana: se descarta
+    Resync      // Salto hacia adelante fuera de la ventana (director reiniciado): nueva base
+};
+
+// Números de secuencia por fuente (el topic por el que llegó el comando: el
+// propio y cada grupo). Cada fuente guarda el último número y un mapa de bits
+// con los WINDOW anteriores, como la ventana anti-replay de IPsec: detectar
+// huecos, reordenamientos y repetidos es O(1) por comando.
+class CommandSequence {
+public:
+    static const uint8_t MAX_SOURCES = 5;  // Topic propio + TopicTable::MAX_GROUPS
+    static const uint8_t WINDOW = 32;
+
+private:
+    struct Stream {
+        bool started;
+        uint32_t last;   // Mayor seq aceptado
+        uint32_t seen;   // Bit i: se recibió last - i (bit 0 = last)
+    };
+
+    Stream streams[MAX_SOURCES];
+    unsigned long gaps;
+    unsigned long missing;      // Comandos pedidos por NACK
+    unsigned long late;
+    unsigned long duplicates;
+    unsigned long stale;
+    unsigned long resyncs;
+
+public:
+    CommandSequence();
+    // gapFrom/gapTo quedan con el rango faltante cuando el resultado es Gap
+    SeqResult check(uint8_t source, uint32_t seq, uint32_t& gapFrom, uint32_t& gapTo);
+    void reset();
+
+    unsigned long getGaps() const { return gaps; }
+    unsigned long getMissing() const { return missing; }
+    unsigned long getLate() const { return late; }
+    unsigned long getDuplicates() const { return duplicates; }
+    unsigned long getStale() const { return stale; }
+    unsigned long getResyncs() const { return resyncs; }
+};
+
+extern CommandSequence commandSequence;
+
+#endif
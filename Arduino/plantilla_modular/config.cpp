@@ -13,16 +13,54 @@ MQTTConfig mqttConfig = {
     .clientId = "osmo_norte",
     .qos = 1, // QoS 1 para garantizar entrega
     .keepAlive = 60,   
-    .cleanSession = true
+    .cleanSession = false,  // Sesión persistente: el broker guarda los comandos mientras reconectamos
+    .discovery = true,      // server es solo el primer intento: si el director cambia de IP se lo busca
+    .rediscoverAfter = 3,
+    .standby = {
+        {nullptr, 0},  // p. ej. {"192.168.1.50", 1883}: laptop de respaldo con su Mosquitto
+        {nullptr, 0}
+    }
 };
 
 DeviceConfig deviceConfig = {
     .unitId = "osmo_norte",
     .pumpCount = 4,  // ✅ Cambiado a 4 para tener bombas 0, 1, 2, 3
-    .statusInterval = 10000,
+    .statusInterval = 60000,  // La presencia va por Last Will: el estado periódico solo resincroniza
+    .statusKeyframeEvery = 5, // Los cambios salen al instante como delta; el completo cada 5 min
+    .statsInterval = 60000,
     .pumpPins = {12,13,14,15},  // Pines más seguros para ESP8266
     .pumpDefaults = {
         .activationTime = 2000,  // 10 segundos por defecto
         .cooldownTime = 3000     // 30 segundos por defecto
-    }
-};
\ No newline at end of file
+    },
+    .groups = {"all", "zona_norte", nullptr, nullptr}  // Un publish en el grupo llega a toda la sala/zona
+};
+
+LogConfig logConfig = {
+    .syslogEnabled = false,
+    .syslogServer = nullptr,  // Sigue al broker primario (caché, config o mDNS)
+    .syslogPort = 5514  // Receptor syslog del director (local-test)
+};
+
+UdpCommandConfig udpCommandConfig = {
+    .enabled = false,
+    .port = 5520,
+    .multicastGroup = "239.255.77.1",  // Un datagrama para todas las unidades
+    .key = "motete-udp-cambiar"         // Igual que --key en simulation/udp_command.js
+};
+
+ClockSyncConfig clockSyncConfig = {
+    .enabled = true,
+    .server = nullptr,  // Sigue al broker primario: si el Pi cambia de IP, mDNS lo encuentra
+    .port = 5521,
+    .resyncInterval = 60000  // La deriva estimada cubre el intervalo entre ráfagas
+};
+
+PowerConfig powerConfig = {
+    .bootProfile = "show",     // Respuesta inmediata hasta que el horario diga otra cosa
+    .scheduleEnabled = false,
+    .showFrom = 10 * 60,       // 10:00
+    .showTo = 23 * 60,         // 23:00
+    .utcOffsetMinutes = -180,
+    .idleListenInterval = 3
+};
@@ -7,16 +7,25 @@ struct WiFiConfig {
     const char* password;
 };
 
+// Broker de respaldo (p. ej. una laptop); server/port de MQTTConfig es el primario
+struct BrokerEndpoint {
+    const char* server;  // nullptr = slot sin usar
+    int port;
+};
+
 // Configuración MQTT
 struct MQTTConfig {
     const char* server;
     int port;
     const char* user;
     const char* password;
-    const char* clientId;
+    const char* clientId;  // Debe ser estable por unidad: identifica la sesión persistente
     int qos; // (0=sin garantía, 1=al menos una vez, 2=exactamente una vez)           
     int keepAlive;   //Tiempo en segundos entre mensajes de "estoy vivo"   
     bool cleanSession; //Si es true, el broker olvida la sesión anterior al reconectar
+    bool discovery;    // Buscar el broker por mDNS (_mqtt._tcp) si server deja de responder
+    int rediscoverAfter; // Connect fallidos seguidos antes de preguntar por mDNS
+    BrokerEndpoint standby[2];  // Se pasa a ellos si el primario falla, y se vuelve
 };
 
 // Configuración por defecto de bombas
@@ -30,13 +39,53 @@ struct DeviceConfig {
     const char* unitId;
     int pumpCount;
     int statusInterval;
+    int statusKeyframeEvery;  // Estado completo cada N intervalos; entre medio solo deltas
+    int statsInterval;   // Intervalo de publicación de estadísticas de uso
     int pumpPins[4];
     PumpDefaultConfig pumpDefaults;
+    const char* groups[4];  // Grupos a los que escucha (motete/director/group/<g>); nullptr = slot sin usar
+};
+
+// Configuración de logs (el nivel se fija en compilación con OSMO_LOG_LEVEL)
+struct LogConfig {
+    bool syslogEnabled;        // Enviar cada línea por UDP al director
+    const char* syslogServer;  // IP del director; nullptr = host del broker primario
+    int syslogPort;
+};
+
+// Canal de comandos UDP para tocar en vivo (piano/jam), además de MQTT
+struct UdpCommandConfig {
+    bool enabled;
+    int port;
+    const char* multicastGroup;  // "" = solo unicast
+    const char* key;             // Clave HMAC compartida con el emisor
+};
+
+// Sincronía de reloj con el director (base común para agendar y medir)
+struct ClockSyncConfig {
+    bool enabled;
+    const char* server;   // IP del director (services/clockServer.js); nullptr = host del broker primario
+    int port;
+    int resyncInterval;   // ms entre ráfagas de medición
+};
+
+// Perfil de energía (power_profile.h): "show" para funciones, "idle" para la noche
+struct PowerConfig {
+    const char* bootProfile;  // Perfil al arrancar: "show" o "idle"
+    bool scheduleEnabled;     // Alternar según la franja de función (requiere ClockSync)
+    int showFrom;             // Minuto del día, hora local, en que empieza la franja show
+    int showTo;               // Minuto del día en que termina (puede cruzar la medianoche)
+    int utcOffsetMinutes;     // Hora local - UTC
+    int idleListenInterval;   // Beacons DTIM dormidos en idle (1-10)
 };
 
 // Configuración global
 extern WiFiConfig wifiConfig;
 extern MQTTConfig mqttConfig;
 extern DeviceConfig deviceConfig;
+extern LogConfig logConfig;
+extern UdpCommandConfig udpCommandConfig;
+extern ClockSyncConfig clockSyncConfig;
+extern PowerConfig powerConfig;
 
 #endif
\ No newline at end of file
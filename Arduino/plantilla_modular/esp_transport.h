@@ -0,0 +1,46 @@
+#ifndef ESP_TRANSPORT_H
+#define ESP_TRANSPORT_H
+
+#ifndef OSMO_HOST_BUILD
+
+#include <ESP8266WiFi.h>
+#include <WiFiClientSecure.h>
+#include "transport.h"
+
+// TCP plano sobre el stack WiFi del ESP8266
+class EspTcpTransport : public ITransport {
+private:
+    WiFiClient wifiClient;
+    
+public:
+    Client& client() override { return wifiClient; }
+    void setConnectTimeout(unsigned long timeoutMs) override;
+    const char* name() const override { return "esp-tcp"; }
+};
+
+// TLS con BearSSL; trust anchors y buffers se configuran vía tls()
+class EspTlsTransport : public ITransport {
+private:
+    BearSSL::WiFiClientSecure secureClient;
+    BearSSL::Session session;  // Última sesión negociada, para reanudar
+    
+public:
+    Client& client() override { return secureClient; }
+    BearSSL::WiFiClientSecure& tls() { return secureClient; }
+    // Reanudación de sesión: al reconectar se evita el handshake completo
+    void enableSessionCache() { secureClient.setSession(&session); }
+    // Certificado de cliente RSA o ECDSA según el tipo de la clave
+    void setClientCertificate(const BearSSL::X509List* cert, const BearSSL::PrivateKey* key);
+    // Solo suites ECDHE (primero ECDSA): handshake más corto y liviano que RSA
+    void useEcdheSuites();
+    void setConnectTimeout(unsigned long timeoutMs) override;
+    bool isSecure() const override { return true; }
+    const char* name() const override { return "esp-tls"; }
+};
+
+// Backend por defecto del firmware
+typedef EspTcpTransport PlatformTransport;
+
+#endif
+
+#endif
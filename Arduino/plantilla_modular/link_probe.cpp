@@ -0,0 +1,217 @@
+#include "link_probe.h"
+#include "log.h"
+#include "topic_table.h"
+#include <ESP8266WiFi.h>
+#include <ArduinoJson.h>
+#include <limits.h>
+
+namespace {
+    // Bordes superiores (exclusivos) de cada bucket
+    const uint16_t RTT_EDGES_MS[LinkProbe::RTT_BUCKETS - 1] = {5, 10, 20, 50, 100, 200, 500};
+    const int8_t RSSI_EDGES_DBM[LinkProbe::RSSI_BUCKETS - 1] = {-80, -75, -70, -65, -60};
+}
+
+LinkProbe::LinkProbe(NetworkManager& network)
+    : network(network), running(false), draining(false), startedAt(0), duration(0),
+      interval(0), nextPing(0), drainUntil(0), nextSeq(1) {
+}
+
+bool LinkProbe::start(const String& id, unsigned long durationMs, unsigned long intervalMs) {
+    if (running) {
+        return false;
+    }
+    commandId = id;
+    duration = durationMs;
+    // Al menos una muestra por tramo de la serie de RSSI
+    interval = min(intervalMs, durationMs / SERIES);
+
+    for (uint8_t i = 0; i < PENDING; i++) {
+        pendingSeq[i] = 0;
+    }
+    sent = 0;
+    received = 0;
+    rttMinUs = ULONG_MAX;
+    rttMaxUs = 0;
+    rttSumUs = 0;
+    memset(rttHist, 0, sizeof(rttHist));
+    memset(rssiHist, 0, sizeof(rssiHist));
+    rssiSamples = 0;
+    rssiMin = 0;
+    rssiMax = -128;
+    rssiSum = 0;
+    memset(seriesSum, 0, sizeof(seriesSum));
+    memset(seriesCount, 0, sizeof(seriesCount));
+
+    reconnectsAtStart = network.getReconnects();
+    attemptsAtStart = network.getPublishAttempts();
+    failuresAtStart = network.getPublishFailures();
+
+    running = true;
+    draining = false;
+    startedAt = millis();
+    nextPing = startedAt;
+    LOG_INFO("📶 Sondeo de enlace: %lu ms, ping cada %lu ms", duration, interval);
+    return true;
+}
+
+void LinkProbe::loop() {
+    if (!running) {
+        return;
+    }
+    if (draining) {
+        if ((long)(millis() - drainUntil) >= 0) {
+            report();
+        }
+        return;
+    }
+    if (millis() - startedAt >= duration) {
+        draining = true;
+        drainUntil = millis() + ECHO_GRACE;
+        return;
+    }
+    if ((long)(millis() - nextPing) >= 0) {
+        nextPing += interval;
+        sample();
+        ping();
+    }
+}
+
+void LinkProbe::sample() {
+    // Sin asociación el SDK devuelve 31: no es una medición
+    if (WiFi.status() != WL_CONNECTED) {
+        return;
+    }
+    int8_t rssi = WiFi.RSSI();
+
+    uint8_t bucket = 0;
+    while (bucket < RSSI_BUCKETS - 1 && rssi >= RSSI_EDGES_DBM[bucket]) {
+        bucket++;
+    }
+    rssiHist[bucket]++;
+    rssiSamples++;
+    rssiSum += rssi;
+    rssiMin = min(rssiMin, rssi);
+    rssiMax = max(rssiMax, rssi);
+
+    uint8_t slot = (uint8_t)min((unsigned long)(SERIES - 1), (millis() - startedAt) * SERIES / duration);
+    seriesSum[slot] += rssi;
+    seriesCount[slot]++;
+}
+
+void LinkProbe::ping() {
+    uint32_t seq = nextSeq++;
+    if (nextSeq == 0) {
+        nextSeq = 1;
+    }
+    // Si el slot sigue ocupado ese ping ya tardó PENDING intervalos: queda perdido
+    uint8_t slot = seq % PENDING;
+    pendingSeq[slot] = seq;
+    pendingAt[slot] = micros();
+    sent++;
+
+    char payload[12];
+    snprintf(payload, sizeof(payload), "%lu", (unsigned long)seq);
+    if (!network.publish(topicTable.get(Topic::Echo), payload)) {
+        pendingSeq[slot] = 0;
+    }
+}
+
+bool LinkProbe::onEcho(const char* topic, const uint8_t* payload, unsigned int length) {
+    if (strcmp(topic, topicTable.get(Topic::Echo)) != 0) {
+        return false;
+    }
+    unsigned long now = micros();
+    if (!running || length == 0 || length > 10) {
+        return true;  // Eco de un sondeo anterior: se descarta igual
+    }
+
+    uint32_t seq = 0;
+    for (unsigned int i = 0; i < length; i++) {
+        if (payload[i] < '0' || payload[i] > '9') {
+            return true;
+        }
+        seq = seq * 10 + (payload[i] - '0');
+    }
+    uint8_t slot = seq % PENDING;
+    if (seq == 0 || pendingSeq[slot] != seq) {
+        return true;
+    }
+    pendingSeq[slot] = 0;
+
+    unsigned long rtt = now - pendingAt[slot];
+    received++;
+    rttSumUs += rtt;
+    rttMinUs = min(rttMinUs, rtt);
+    rttMaxUs = max(rttMaxUs, rtt);
+
+    unsigned long rttMs = rtt / 1000;
+    uint8_t bucket = 0;
+    while (bucket < RTT_BUCKETS - 1 && rttMs >= RTT_EDGES_MS[bucket]) {
+        bucket++;
+    }
+    rttHist[bucket]++;
+    return true;
+}
+
+void LinkProbe::report() {
+    running = false;
+    draining = false;
+
+    const size_t capacity = 2 * JSON_OBJECT_SIZE(8) + JSON_OBJECT_SIZE(7) + JSON_OBJECT_SIZE(2) +
+                            JSON_ARRAY_SIZE(RSSI_BUCKETS) * 2 +
+                            JSON_ARRAY_SIZE(SERIES) + JSON_ARRAY_SIZE(RTT_BUCKETS) * 2 + 64;
+    DynamicJsonDocument doc(capacity);
+    doc["unit_id"] = deviceConfig.unitId;
+    doc["command_id"] = commandId.c_str();
+    doc["duration_ms"] = duration;
+    doc["interval_ms"] = interval;
+    doc["reconnects"] = network.getReconnects() - reconnectsAtStart;
+
+    JsonObject rssi = doc.createNestedObject("rssi");
+    rssi["samples"] = rssiSamples;
+    if (rssiSamples > 0) {
+        rssi["min"] = rssiMin;
+        rssi["avg"] = rssiSum / (long)rssiSamples;
+        rssi["max"] = rssiMax;
+    }
+    JsonArray rssiEdges = rssi.createNestedArray("edges");
+    JsonArray rssiCounts = rssi.createNestedArray("hist");
+    for (uint8_t i = 0; i < RSSI_BUCKETS; i++) {
+        if (i < RSSI_BUCKETS - 1) {
+            rssiEdges.add(RSSI_EDGES_DBM[i]);
+        }
+        rssiCounts.add(rssiHist[i]);
+    }
+    // Promedio por tramo: una caída a mitad del sondeo no se pierde en el total
+    JsonArray series = rssi.createNestedArray("series");
+    for (uint8_t i = 0; i < SERIES; i++) {
+        series.add(seriesCount[i] ? seriesSum[i] / (long)seriesCount[i] : 0);
+    }
+
+    JsonObject rtt = doc.createNestedObject("rtt");
+    rtt["sent"] = sent;
+    rtt["received"] = received;
+    rtt["lost"] = sent - received;
+    if (received > 0) {
+        rtt["min_ms"] = rttMinUs / 1000.0f;
+        rtt["avg_ms"] = (unsigned long)(rttSumUs / received) / 1000.0f;
+        rtt["max_ms"] = rttMaxUs / 1000.0f;
+    }
+    JsonArray rttEdges = rtt.createNestedArray("edges");
+    JsonArray rttCounts = rtt.createNestedArray("hist");
+    for (uint8_t i = 0; i < RTT_BUCKETS; i++) {
+        if (i < RTT_BUCKETS - 1) {
+            rttEdges.add(RTT_EDGES_MS[i]);
+        }
+        rttCounts.add(rttHist[i]);
+    }
+
+    // Incluye los pings: un publish rechazado es un ping que nunca salió
+    JsonObject publish = doc.createNestedObject("publish");
+    publish["attempts"] = network.getPublishAttempts() - attemptsAtStart;
+    publish["failures"] = network.getPublishFailures() - failuresAtStart;
+
+    LOG_INFO("📶 Sondeo terminado: %u/%u ecos, RSSI medio %ld dBm", received, sent,
+             rssiSamples ? rssiSum / (long)rssiSamples : 0L);
+    network.publishJson(PublishClass::Event, topicTable.get(Topic::Probe), doc);
+}
@@ -0,0 +1,69 @@
+#ifndef LINK_PROBE_H
+#define LINK_PROBE_H
+
+#include <Arduino.h>
+#include "network_manager.h"
+
+// Sondeo de calidad del enlace desde la posición real del Osmo: durante
+// duration ms toma el RSSI y publica un ping en su propio topic de eco cada
+// interval ms. La ida y vuelta por el broker es la latencia que ve un comando
+// (incluye la vuelta de loop()). Al terminar publica en motete/osmo/<unit>/probe
+// histogramas compactos: arrays de cuentas con los bordes de cada bucket.
+class LinkProbe {
+public:
+    static const uint8_t RTT_BUCKETS = 8;    // Bordes en RTT_EDGES_MS, el último abierto
+    static const uint8_t RSSI_BUCKETS = 6;   // Bordes en RSSI_EDGES_DBM, el último abierto
+    static const uint8_t SERIES = 8;         // Promedios de RSSI a lo largo del sondeo
+    static const uint8_t PENDING = 16;       // Pings esperando eco; más viejos cuentan como perdidos
+    static const unsigned long ECHO_GRACE = 1000;  // ms para ecos rezagados al terminar
+
+private:
+    NetworkManager& network;
+    bool running;
+    bool draining;                  // Ya no se envía: solo se esperan ecos
+    String commandId;
+    unsigned long startedAt;
+    unsigned long duration;
+    unsigned long interval;
+    unsigned long nextPing;
+    unsigned long drainUntil;
+
+    uint32_t nextSeq;
+    uint32_t pendingSeq[PENDING];   // 0 = slot libre
+    unsigned long pendingAt[PENDING];  // micros() del envío
+
+    uint16_t sent;
+    uint16_t received;
+    uint16_t rttHist[RTT_BUCKETS];
+    unsigned long rttMinUs;
+    unsigned long rttMaxUs;
+    uint64_t rttSumUs;
+
+    uint16_t rssiHist[RSSI_BUCKETS];
+    uint16_t rssiSamples;
+    int8_t rssiMin;
+    int8_t rssiMax;
+    long rssiSum;
+    long seriesSum[SERIES];
+    uint8_t seriesCount[SERIES];
+
+    // Contadores de NetworkManager al empezar: se reporta la diferencia
+    unsigned long reconnectsAtStart;
+    unsigned long attemptsAtStart;
+    unsigned long failuresAtStart;
+
+    void sample();
+    void ping();
+    void report();
+
+public:
+    explicit LinkProbe(NetworkManager& network);
+    // false si ya hay un sondeo en curso
+    bool start(const String& commandId, unsigned long durationMs, unsigned long intervalMs);
+    bool isRunning() const { return running; }
+    // Ruta rápida desde el callback MQTT: true si el mensaje era un eco
+    bool onEcho(const char* topic, const uint8_t* payload, unsigned int length);
+    void loop();
+};
+
+#endif
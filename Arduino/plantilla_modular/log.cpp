@@ -0,0 +1,152 @@
+#include "log.h"
+#include <ESP8266WiFi.h>
+#include <WiFiUdp.h>
+#include <stdarg.h>
+
+namespace {
+    // Cada línea se guarda como: byte de nivel + texto + '\n'
+    char ring[Log::RING_SIZE];
+    uint16_t ringHead = 0;   // Próximo byte a volcar
+    uint16_t ringUsed = 0;
+    unsigned long droppedLines = 0;
+    unsigned long reportedDropped = 0;
+    
+    const uint8_t DRAIN_LINES = 4;       // Líneas por llamada a drain()
+    const uint8_t SYSLOG_FACILITY = 16;  // local0
+    
+    bool syslogEnabled = false;
+    bool syslogFollowsBroker = false;  // beginSyslog sin host: lo da setSyslogHost
+    IPAddress syslogAddress;
+    uint16_t syslogPort = 514;
+    const char* syslogTag = "osmo";
+    WiFiUDP syslogUdp;
+    
+    char levelTag(uint8_t level) {
+        switch (level) {
+            case OSMO_LOG_ERROR: return 'E';
+            case OSMO_LOG_WARN: return 'W';
+            case OSMO_LOG_INFO: return 'I';
+            default: return 'D';
+        }
+    }
+    
+    uint8_t syslogSeverity(uint8_t level) {
+        switch (level) {
+            case OSMO_LOG_ERROR: return 3;
+            case OSMO_LOG_WARN: return 4;
+            case OSMO_LOG_INFO: return 6;
+            default: return 7;
+        }
+    }
+    
+    bool push(uint8_t level, const char* text, uint16_t length) {
+        if (ringUsed + length + 2 > Log::RING_SIZE) {
+            droppedLines++;
+            return false;
+        }
+        uint16_t tail = (ringHead + ringUsed) % Log::RING_SIZE;
+        ring[tail] = (char)level;
+        tail = (tail + 1) % Log::RING_SIZE;
+        for (uint16_t i = 0; i < length; i++) {
+            ring[tail] = text[i];
+            tail = (tail + 1) % Log::RING_SIZE;
+        }
+        ring[tail] = '\n';
+        ringUsed += length + 2;
+        return true;
+    }
+    
+    // Copia la línea más antigua a out (sin el byte de nivel); devuelve su largo con '\n'
+    uint16_t peekLine(uint8_t& level, char* out) {
+        level = (uint8_t)ring[ringHead];
+        uint16_t length = 0;
+        uint16_t index = (ringHead + 1) % Log::RING_SIZE;
+        while (length < Log::LINE_MAX + 1) {
+            char c = ring[index];
+            out[length++] = c;
+            if (c == '\n') {
+                break;
+            }
+            index = (index + 1) % Log::RING_SIZE;
+        }
+        return length;
+    }
+    
+    void sendSyslog(uint8_t level, const char* line, uint16_t length) {
+        if (!syslogEnabled || WiFi.status() != WL_CONNECTED) {
+            return;
+        }
+        char header[48];
+        int headerLength = snprintf(header, sizeof(header), "<%u>%s: ",
+                                    SYSLOG_FACILITY * 8 + syslogSeverity(level), syslogTag);
+        syslogUdp.beginPacket(syslogAddress, syslogPort);
+        syslogUdp.write((const uint8_t*)header, headerLength);
+        syslogUdp.write((const uint8_t*)line, length - 1);  // Sin '\n'
+        syslogUdp.endPacket();
+    }
+}
+
+namespace Log {
+
+void write(LogLevel level, const char* format, ...) {
+    char line[LINE_MAX];
+    int prefix = snprintf(line, sizeof(line), "[%lu %c] ", millis(), levelTag((uint8_t)level));
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(line + prefix, sizeof(line) - prefix, format, args);
+    va_end(args);
+    if (length < 0) {
+        return;
+    }
+    length += prefix;
+    if (length >= (int)sizeof(line)) {
+        length = sizeof(line) - 1;  // Truncada
+    }
+    push((uint8_t)level, line, length);
+}
+
+void drain() {
+    // Avisar de lo descartado apenas haya lugar
+    if (droppedLines != reportedDropped) {
+        char notice[48];
+        int length = snprintf(notice, sizeof(notice), "[log] %lu lineas descartadas", droppedLines - reportedDropped);
+        if (push(OSMO_LOG_WARN, notice, length)) {
+            reportedDropped = droppedLines;
+        }
+    }
+    
+    char line[LINE_MAX + 1];
+    for (uint8_t n = 0; n < DRAIN_LINES && ringUsed > 0; n++) {
+        uint8_t level;
+        uint16_t length = peekLine(level, line);
+        // Solo si entra completa en el FIFO del UART: nunca esperar
+        if (Serial.availableForWrite() < (int)length) {
+            break;
+        }
+        Serial.write((const uint8_t*)line, length);
+        sendSyslog(level, line, length);
+        ringHead = (ringHead + length + 1) % RING_SIZE;
+        ringUsed -= length + 1;
+    }
+}
+
+void beginSyslog(const char* host, uint16_t port, const char* tag) {
+    syslogFollowsBroker = host == nullptr;
+    syslogEnabled = host && syslogAddress.fromString(host);
+    syslogPort = port;
+    syslogTag = tag;
+}
+
+void setSyslogHost(const IPAddress& host) {
+    if (!syslogFollowsBroker || !host.isSet()) {
+        return;
+    }
+    syslogAddress = host;
+    syslogEnabled = true;
+}
+
+unsigned long getDropped() {
+    return droppedLines;
+}
+
+}
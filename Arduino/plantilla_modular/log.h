@@ -0,0 +1,68 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <Arduino.h>
+#include <IPAddress.h>
+
+// Niveles de log. OSMO_LOG_LEVEL (por defecto INFO) elimina en compilación
+// todo lo que esté por encima: queda como código muerto (if (false)), así los
+// argumentos siguen chequeados pero no se evalúan ni llegan al binario.
+#define OSMO_LOG_NONE  0
+#define OSMO_LOG_ERROR 1
+#define OSMO_LOG_WARN  2
+#define OSMO_LOG_INFO  3
+#define OSMO_LOG_DEBUG 4
+
+#ifndef OSMO_LOG_LEVEL
+#define OSMO_LOG_LEVEL OSMO_LOG_INFO
+#endif
+
+enum class LogLevel : uint8_t {
+    Error = OSMO_LOG_ERROR,
+    Warn = OSMO_LOG_WARN,
+    Info = OSMO_LOG_INFO,
+    Debug = OSMO_LOG_DEBUG
+};
+
+#if OSMO_LOG_LEVEL >= OSMO_LOG_ERROR
+#define LOG_ERROR(...) Log::write(LogLevel::Error, __VA_ARGS__)
+#else
+#define LOG_ERROR(...) do { if (false) Log::write(LogLevel::Error, __VA_ARGS__); } while (0)
+#endif
+
+#if OSMO_LOG_LEVEL >= OSMO_LOG_WARN
+#define LOG_WARN(...) Log::write(LogLevel::Warn, __VA_ARGS__)
+#else
+#define LOG_WARN(...) do { if (false) Log::write(LogLevel::Warn, __VA_ARGS__); } while (0)
+#endif
+
+#if OSMO_LOG_LEVEL >= OSMO_LOG_INFO
+#define LOG_INFO(...) Log::write(LogLevel::Info, __VA_ARGS__)
+#else
+#define LOG_INFO(...) do { if (false) Log::write(LogLevel::Info, __VA_ARGS__); } while (0)
+#endif
+
+#if OSMO_LOG_LEVEL >= OSMO_LOG_DEBUG
+#define LOG_DEBUG(...) Log::write(LogLevel::Debug, __VA_ARGS__)
+#else
+#define LOG_DEBUG(...) do { if (false) Log::write(LogLevel::Debug, __VA_ARGS__); } while (0)
+#endif
+
+// Sink diferido: write() solo formatea en un anillo en RAM y nunca espera al
+// UART ni a la red. drain(), llamado en la parte ociosa del loop, vuelca al
+// Serial lo que entra en el FIFO sin bloquear y, si está activo, envía cada
+// línea por syslog UDP al director.
+namespace Log {
+    const uint16_t RING_SIZE = 2048;  // Bytes de líneas pendientes
+    const uint8_t LINE_MAX = 128;     // Una línea más larga se trunca
+    
+    void write(LogLevel level, const char* format, ...) __attribute__((format(printf, 2, 3)));
+    void drain();
+    // Syslog (RFC 3164, facility local0) hacia host:port; tag = unitId
+    // host nullptr: el destino lo fija setSyslogHost (host del broker primario)
+    void beginSyslog(const char* host, uint16_t port, const char* tag);
+    void setSyslogHost(const IPAddress& host);
+    unsigned long getDropped();
+}
+
+#endif
@@ -1,6 +1,11 @@
 #include "main_controller.h"
+#include "log.h"
 #include "pump_controller.h"
 #include "status_publisher.h"
+#include "clock_sync.h"
+#include "command_bundle.h"
+#include "command_sequence.h"
+#include "power_profile.h"
 #include <Arduino.h>
 #include <ArduinoJson.h>
 // Inicializar la variable estática
@@ -8,21 +13,30 @@ MainController* MainController::instancia = nullptr;
 
 // En main_controller.cpp
 MainController::MainController() 
-    : lastStatusPublish(0) {
-        Serial.println("🔧 Constructor MainController iniciado");  // ← LOG EN CONSTRUCTOR
+    : networkManager(transport), probe(networkManager), lastStatsPublish(0),
+      commandReceivedMicros(0), stopLatencyUs(0), stopAllPending(false),
+      rebootPending(false), rebootAt(0), recentCommandNext(0) {
+        LOG_INFO("🔧 Constructor MainController iniciado");  // ← LOG EN CONSTRUCTOR
         
         // Crear instancias dinámicamente
         pumpController = new PumpController(deviceConfig.pumpCount, &networkManager);
         statusPublisher = new StatusPublisher(pumpController, &networkManager);
         
         instancia = this;
-        Serial.println("✅ Constructor MainController completado");
+        LOG_INFO("✅ Constructor MainController completado");
 }
 
 void MainController::initialize() {
     Serial.begin(115200);
     delay(8000);
     Serial.println("🚀 Iniciando sistema...");
+    // Antes de conectar: sleep y frecuencia de CPU quedan fijos desde la asociación
+    powerManager.begin();
+    // Los topics se arman una sola vez; los publicadores solo usan punteros
+    if (topicTable.build(deviceConfig.unitId, deviceConfig.groups,
+                         sizeof(deviceConfig.groups) / sizeof(deviceConfig.groups[0]))) {
+        Serial.println("✅ Topics construidos");
+    }
     Serial.println("📌 Paso 1: Configurando LED...");
     // Configurar LED indicador
     pinMode(2, OUTPUT);
@@ -35,6 +49,11 @@ void MainController::initialize() {
     Serial.println("📌 Paso 3: Configurando callback MQTT...");
     networkManager.setCallback(messageCallback);
     Serial.println("✅ Callback MQTT configurado");
+    Serial.println("📌 Paso 4: Iniciando conexión (no bloqueante)...");
+    networkManager.connect();
+    if (logConfig.syslogEnabled) {
+        Log::beginSyslog(logConfig.syslogServer, logConfig.syslogPort, deviceConfig.unitId);
+    }
     Serial.println("✅ Sistema iniciado completamente"); 
     
     
@@ -48,15 +67,77 @@ MainController::~MainController() {
 
 // Método estático que redirige la llamada
 void MainController::messageCallback(char* topic, uint8_t* payload, unsigned int length) {
+    if (instancia) {
+        instancia->commandReceivedMicros = micros();
+    }
+    // Ruta rápida: la parada de emergencia se atiende antes de cualquier otro procesamiento
+    if (instancia && isStopAllMessage(topic, payload, length)) {
+        instancia->handleStopAll(Commands::STOP_ALL);
+        return;
+    }
+    
+    // Ecos del sondeo: el tiempo de llegada es la medición, sin LED ni parseo
+    if (instancia && instancia->probe.onEcho(topic, payload, length)) {
+        return;
+    }
+    
+    // MQTT 5: el broker no entrega lo vencido, pero el comando pudo vencer
+    // esperando en el socket; el director ya no espera respuesta
+    if (instancia && instancia->networkManager.requestExpired()) {
+        LOG_WARN("⌛ Comando vencido en %s, se descarta", topic);
+        return;
+    }
+    
     // Verificar que existe una instancia
     if (instancia) {
         // Redirigir a la instancia real
         instancia->procesarMensaje(topic, payload, length);
     } else {
-        Serial.println("ERROR: No hay instancia de MainController");
+        LOG_ERROR("ERROR: No hay instancia de MainController");
     }
 }
 
+// Chequeo barato por prefijo: topic dedicado o comando corto en el topic de comandos
+bool MainController::isStopAllMessage(const char* topic, const uint8_t* payload, unsigned int length) {
+    const size_t prefixLength = sizeof(StopAll::TOPIC_PREFIX) - 1;
+    if (strncmp(topic, StopAll::TOPIC_PREFIX, prefixLength) == 0) {
+        // Solo el nivel completo: "motete/director/stopwatch" no es una parada
+        if (topic[prefixLength] == '\0' || topic[prefixLength] == '/') {
+            return true;
+        }
+    }
+    // El comando corto vale solo en el topic propio, no en grupos, eco ni bundles
+    if (strcmp(topic, topicTable.get(Topic::Commands)) != 0) {
+        return false;
+    }
+    return length >= sizeof(StopAll::PAYLOAD) - 1 &&
+           memcmp(payload, StopAll::PAYLOAD, sizeof(StopAll::PAYLOAD) - 1) == 0;
+}
+
+void MainController::handleStopAll(const char* commandId) {
+    pumpController->emergencyStopAll();
+    stopLatencyUs = micros() - commandReceivedMicros;
+    // Respuesta y estado se publican desde loop(), fuera del callback
+    stopCommandId = commandId;
+    stopAllPending = true;
+}
+
+void MainController::reportStopAll() {
+    stopAllPending = false;
+    LOG_INFO("🛑 Parada de emergencia ejecutada, latencia %lu us", stopLatencyUs);
+    
+    if (stopLatencyUs > StopAll::LATENCY_TARGET_US) {
+        String message = "Latencia de parada " + String(stopLatencyUs) + " us supera el objetivo";
+        networkManager.publishError("stop_all_latency", message.c_str());
+    }
+    
+    networkManager.publishEvent(Commands::STOP_ALL);
+    
+    CommandResponse successResponse = createResponse(ResponseCodes::SUCCESS, SuccessMessages::ALL_PUMPS_STOPPED, stopCommandId);
+    sendCommandResponse(successResponse);
+    publishStatus();
+}
+
 // Método de instancia que procesa el mensaje
 void MainController::procesarMensaje(char* topic, uint8_t* payload, unsigned int length) {
     // Indicador LED
@@ -64,8 +145,7 @@ void MainController::procesarMensaje(char* topic, uint8_t* payload, unsigned int
     delay(100);
     digitalWrite(2, HIGH);
     
-    Serial.print("Mensaje recibido en: ");
-    Serial.println(topic);
+    LOG_INFO("Mensaje recibido en: %s", topic);
     
     String message;
     for (uint16_t i = 0; i < length; i++) {
@@ -76,14 +156,59 @@ void MainController::procesarMensaje(char* topic, uint8_t* payload, unsigned int
     handleCommand(topic, message.c_str());
 }
 
+// Recuerda los últimos command_id; true si ya se procesó (reentrega QoS 1)
+bool MainController::isDuplicateCommand(const String& commandId) {
+    if (commandId.length() == 0) {
+        return false;
+    }
+    for (uint8_t i = 0; i < RECENT_COMMANDS; i++) {
+        if (recentCommandIds[i] == commandId) {
+            return true;
+        }
+    }
+    recentCommandIds[recentCommandNext] = commandId;
+    recentCommandNext = (recentCommandNext + 1) % RECENT_COMMANDS;
+    return false;
+}
+
+// Secuencia por topic de origen; false si es un repetido que hay que descartar.
+// Un hueco no frena el comando: se procesa y se piden los faltantes por NACK.
+bool MainController::acceptSequence(const char* topic, uint32_t seq) {
+    uint32_t gapFrom, gapTo;
+    switch (commandSequence.check(topicTable.commandSource(topic), seq, gapFrom, gapTo)) {
+        case SeqResult::Duplicate:
+            LOG_INFO("🔁 seq %lu repetido en %s, descartado", (unsigned long)seq, topic);
+            return false;
+        case SeqResult::Stale:
+            LOG_WARN("🗑️ seq %lu fuera de la ventana en %s, descartado", (unsigned long)seq, topic);
+            return false;
+        case SeqResult::Gap:
+            LOG_WARN("⚠️ Faltan seq %lu-%lu en %s", (unsigned long)gapFrom, (unsigned long)gapTo, topic);
+            networkManager.publishNack(topic, gapFrom, gapTo);
+            return true;
+        case SeqResult::Late:
+            LOG_INFO("↩️ seq %lu llegó tarde en %s", (unsigned long)seq, topic);
+            return true;
+        case SeqResult::Resync:
+            LOG_WARN("🔄 Secuencia reiniciada en %s (seq %lu)", topic, (unsigned long)seq);
+            return true;
+        default:
+            return true;
+    }
+}
+
 void MainController::processCommand(const MQTTCommand& cmd) {
-    Serial.print("🔧 Procesando comando: ");
-    Serial.println(cmd.action);
+    LOG_INFO("🔧 Procesando comando: %s", cmd.action.c_str());
+    
+    // La respuesta original ya está encolada o enviada
+    if (isDuplicateCommand(cmd.commandId)) {
+        LOG_INFO("🔁 Comando repetido ignorado: %s", cmd.commandId.c_str());
+        return;
+    }
     
     // Validar parámetros primero
     if (!validateCommandParams(cmd)) {
-        Serial.print("❌ Parámetros inválidos para comando: ");
-        Serial.println(cmd.action);
+        LOG_ERROR("❌ Parámetros inválidos para comando: %s", cmd.action.c_str());
         CommandResponse errorResponse = createResponse(ResponseCodes::INVALID_PARAMS, ErrorMessages::INVALID_PARAMS, cmd.commandId);
         sendCommandResponse(errorResponse);
         return;
@@ -92,63 +217,53 @@ void MainController::processCommand(const MQTTCommand& cmd) {
     // Procesar comando según la acción
     if (cmd.action == Commands::ACTIVATE_PUMP) {
         PumpActivationParams params = extractPumpActivationParams(cmd.params);
-        Serial.print("🔧 Activando bomba ");
-        Serial.print(params.pumpId);
-        Serial.print(" por ");
-        Serial.print(params.duration);
-        Serial.println(" ms");
+        LOG_INFO("🔧 Activando bomba %d por %d ms", params.pumpId, params.duration);
         
         // Verificar si la bomba está disponible
-        if (!pumpController->isPumpAvailable(params.pumpId) && !params.force) {
-            Serial.print("❌ Bomba ");
-            Serial.print(params.pumpId);
-            Serial.println(" en cooldown");
+        bool available = pumpController->isPumpAvailable(params.pumpId);
+        if (!available && !params.force) {
+            LOG_ERROR("❌ Bomba %d en cooldown", params.pumpId);
+            pumpController->recordCooldownReject(params.pumpId);
             CommandResponse errorResponse = createResponse(ResponseCodes::PUMP_BUSY, ErrorMessages::PUMP_BUSY, cmd.commandId);
             sendCommandResponse(errorResponse);
             return;
         }
         
+        if (!available) {
+            pumpController->recordForcedActivation(params.pumpId);
+        }
+        
         // Activar bomba
         pumpController->setPumpState(params.pumpId, true);
-        Serial.print("✅ Bomba ");
-        Serial.print(params.pumpId);
-        Serial.println(" activada");
+        LOG_INFO("✅ Bomba %d activada", params.pumpId);
         
         CommandResponse successResponse = createResponse(ResponseCodes::SUCCESS, SuccessMessages::PUMP_ACTIVATED, cmd.commandId);
         sendCommandResponse(successResponse);
     }
     else if (cmd.action == Commands::DEACTIVATE_PUMP) {
         PumpActivationParams params = extractPumpActivationParams(cmd.params);
-        Serial.print("🔧 Desactivando bomba ");
-        Serial.println(params.pumpId);
+        LOG_INFO("🔧 Desactivando bomba %d", params.pumpId);
         
         // Desactivar bomba
         pumpController->setPumpState(params.pumpId, false);
-        Serial.print("✅ Bomba ");
-        Serial.print(params.pumpId);
-        Serial.println(" desactivada");
+        LOG_INFO("✅ Bomba %d desactivada", params.pumpId);
         
         CommandResponse successResponse = createResponse(ResponseCodes::SUCCESS, SuccessMessages::PUMP_DEACTIVATED, cmd.commandId);
         sendCommandResponse(successResponse);
     }
     else if (cmd.action == Commands::GET_STATUS) {
-        Serial.println("🔧 Obteniendo estado del dispositivo");
+        LOG_INFO("🔧 Obteniendo estado del dispositivo");
+        StatusRequestParams params = extractStatusRequestParams(cmd.params);
         
         // Publicar estado actual
-        publishStatus();
+        publishStatus(params.includeStats);
         
         CommandResponse successResponse = createResponse(ResponseCodes::SUCCESS, SuccessMessages::STATUS_RETRIEVED, cmd.commandId);
         sendCommandResponse(successResponse);
     }
     else if (cmd.action == Commands::SET_PUMP_CONFIG) {
         PumpConfigParams params = extractPumpConfigParams(cmd.params);
-        Serial.print("🔧 Configurando bomba ");
-        Serial.print(params.pumpId);
-        Serial.print(" - Activación: ");
-        Serial.print(params.activationTime);
-        Serial.print(" ms, Cooldown: ");
-        Serial.print(params.cooldownTime);
-        Serial.println(" ms");
+        LOG_INFO("🔧 Configurando bomba %d - Activación: %d ms, Cooldown: %d ms", params.pumpId, params.activationTime, params.cooldownTime);
         
         // Integrar configuración de parámetros de bomba
         pumpController->setPumpConfig(params.pumpId, params.activationTime, params.cooldownTime);
@@ -156,17 +271,52 @@ void MainController::processCommand(const MQTTCommand& cmd) {
         CommandResponse successResponse = createResponse(ResponseCodes::SUCCESS, SuccessMessages::CONFIG_UPDATED, cmd.commandId);
         sendCommandResponse(successResponse);
     }
+    else if (cmd.action == Commands::STOP_ALL) {
+        // Comando completo en JSON (MQTT o UDP): mismo efecto y mismo reporte que la ruta rápida
+        handleStopAll(cmd.commandId.c_str());
+    }
+    else if (cmd.action == Commands::SET_POWER_PROFILE) {
+        PowerProfileParams params = extractPowerProfileParams(cmd.params);
+        PowerProfile profile = PowerProfile::Show;
+        PowerManager::parse(params.profile.c_str(), profile);
+        // Vale hasta el próximo cambio de franja del horario
+        powerManager.set(profile);
+        
+        CommandResponse successResponse = createResponse(ResponseCodes::SUCCESS, SuccessMessages::POWER_PROFILE_SET, cmd.commandId);
+        sendCommandResponse(successResponse);
+    }
+    else if (cmd.action == Commands::PROBE) {
+        ProbeParams params = extractProbeParams(cmd.params);
+        
+        if (!networkManager.isMQTTConnected()) {
+            CommandResponse errorResponse = createResponse(ResponseCodes::NETWORK_ERROR, ErrorMessages::NETWORK_ERROR, cmd.commandId);
+            sendCommandResponse(errorResponse);
+            return;
+        }
+        if (!probe.start(cmd.commandId, params.durationMs, params.intervalMs)) {
+            CommandResponse errorResponse = createResponse(ResponseCodes::BUSY, ErrorMessages::PROBE_RUNNING, cmd.commandId);
+            sendCommandResponse(errorResponse);
+            return;
+        }
+        
+        // El resultado sale en motete/osmo/<unit>/probe al terminar
+        CommandResponse successResponse = createResponse(ResponseCodes::SUCCESS, SuccessMessages::PROBE_STARTED, cmd.commandId);
+        sendCommandResponse(successResponse);
+    }
     else if (cmd.action == Commands::REBOOT) {
-        Serial.println("🔧 Reiniciando dispositivo...");
+        LOG_INFO("🔧 Reiniciando dispositivo...");
         
         CommandResponse successResponse = createResponse(ResponseCodes::SUCCESS, SuccessMessages::REBOOT_INITIATED, cmd.commandId);
         sendCommandResponse(successResponse);
         
-        delay(1000);
-        ESP.restart();
+        // Estamos dentro del callback MQTT: PubSubClient manda el PUBACK recién al
+        // volver. Reiniciar acá deja el REBOOT sin confirmar y la sesión persistente
+        // lo reentrega en cada arranque (el anillo de command_id está en RAM).
+        rebootPending = true;
+        rebootAt = millis() + REBOOT_DELAY;
     }
     else if (cmd.action == Commands::RESET_CONFIG) {
-        Serial.println("🔧 Restableciendo configuración...");
+        LOG_INFO("🔧 Restableciendo configuración...");
         
         // Implementar reset de configuración
         resetDeviceConfig();
@@ -175,83 +325,109 @@ void MainController::processCommand(const MQTTCommand& cmd) {
         sendCommandResponse(successResponse);
     }
     else {
-        Serial.print("❌ Comando no reconocido: ");
-        Serial.println(cmd.action);
+        LOG_ERROR("❌ Comando no reconocido: %s", cmd.action.c_str());
         CommandResponse errorResponse = createResponse(ResponseCodes::INVALID_COMMAND, ErrorMessages::INVALID_COMMAND, cmd.commandId);
         sendCommandResponse(errorResponse);
     }
 }
 
 void MainController::handleCommand(const char* topic, const char* message) {
-    Serial.print("📩 Comando recibido en ");
-    Serial.print(topic);
-    Serial.print(": ");
-    Serial.println(message);
+    LOG_INFO("📩 Comando recibido en %s: %s", topic, message);
+    
+    // Bundle en un topic de grupo: solo se copia y parsea la parte de esta unidad.
+    // Su seq es del bundle: cuenta aunque no traiga nada para esta unidad.
+    String json;
+    uint32_t bundleSeq;
+    bool isBundle = CommandBundle::extract(message, deviceConfig.unitId, json, bundleSeq);
+    if (isBundle) {
+        if (!acceptSequence(topic, bundleSeq)) {
+            return;
+        }
+        if (json.length() == 0) {
+            LOG_DEBUG("📦 Bundle sin parte para %s", deviceConfig.unitId);
+            return;
+        }
+    } else {
+        json = message;
+    }
     
     // Parsear comando usando la función de command_definition
-    MQTTCommand cmd = parseCommandFromJSON(String(message));
+    MQTTCommand cmd = parseCommandFromJSON(json);
+    // Con MQTT 5 el director puede mandar el id solo como correlation data
+    if (cmd.commandId.length() == 0) {
+        cmd.commandId = networkManager.requestCorrelation();
+    }
     
     if (cmd.action == "") {
-        Serial.println("❌ Error parseando comando JSON");
+        LOG_ERROR("❌ Error parseando comando JSON");
         CommandResponse errorResponse = createResponse(ResponseCodes::INVALID_PARAMS, ErrorMessages::INVALID_PARAMS);
         sendCommandResponse(errorResponse);
         return;
     }
     
+    if (!isBundle && !acceptSequence(topic, cmd.seq)) {
+        return;
+    }
+    
     // Procesar comando
     processCommand(cmd);
 }
 
-void MainController::publishStatus() {
-    Serial.println("📊 Publicando estado...");
-    
-    // Verificar conexión MQTT antes de publicar
-    if (!networkManager.isMQTTConnected()) {
-        Serial.println("❌ MQTT desconectado, no se puede publicar estado");
-        return;
+// Datagramas ya verificados (firma, destino y secuencia) al mismo despachador
+void MainController::pollUdpCommands() {
+    MQTTCommand cmd;
+    for (uint8_t i = 0; i < UDP_COMMAND_BUDGET; i++) {
+        if (!udpCommands.poll(cmd)) {
+            return;
+        }
+        commandReceivedMicros = micros();
+        LOG_INFO("🎹 Comando UDP: %s %s", cmd.action.c_str(), cmd.params.c_str());
+        processCommand(cmd);
     }
+}
+
+void MainController::publishStatus(bool includeStats) {
+    LOG_INFO("📊 Publicando estado...");
     
+    // Sin broker también se encola: el estado más nuevo reemplaza al pendiente
     // Usar el método del StatusPublisher que ya maneja todo
-    statusPublisher->publishStatus();
+    statusPublisher->publishStatus(includeStats);
+}
+
+void MainController::publishStats() {
+    statusPublisher->publishStats();
 }
 
 void MainController::sendCommandResponse(const CommandResponse& response) {
     String responseJSON = createResponseJSON(response);
-    char topic[50];
-    sprintf(topic, "motete/osmo/%s/response", deviceConfig.unitId);
-    
-    Serial.print("📤 Intentando enviar respuesta: ");
-    Serial.println(response.message);
-    
-    // Probar con método simple primero
-    if (networkManager.publish(topic, responseJSON.c_str())) {
-        Serial.print("✅ Respuesta enviada (método simple): ");
-        Serial.println(response.message);
+    // Las respuestas nunca se descartan de la cola
+    if (networkManager.enqueueResponse(responseJSON.c_str())) {
+        LOG_INFO("📤 Respuesta encolada: %s", response.message.c_str());
     } else {
-        Serial.println("❌ Error con método simple, intentando QoS 0...");
-        if (networkManager.publishWithQoS(topic, responseJSON.c_str(), 0)) {
-            Serial.print("✅ Respuesta enviada (QoS 0): ");
-            Serial.println(response.message);
-        } else {
-            Serial.println("❌ Error al enviar respuesta con todos los métodos");
-        }
+        LOG_ERROR("❌ Error al enviar respuesta");
     }
 }
 
 void MainController::loop() {
-    static bool firstConnection = true;  
-    
-    if (firstConnection) {
-        Serial.println(" Intentando primera conexión...");
-        if (networkManager.connect()) {
-            Serial.println("✅ Primera conexión exitosa");
-        } else {
-            Serial.println("❌ Primera conexión fallida - reintentando en loop");
-        }
-        firstConnection = false;
+    // Avanza un paso de la conexión; nunca bloquea más que un intento de connect
+    networkManager.loop();
+    
+    if (stopAllPending) {
+        reportStopAll();
     }
     
-    networkManager.loop();
+    if (rebootPending && (long)(millis() - rebootAt) >= 0) {
+        performReboot();
+    }
+    
+    pollUdpCommands();
+    // Reloj y syslog siguen al director si el Pi cambia de IP (mDNS, 042)
+    IPAddress director = networkManager.getDirectorIP();
+    clockSync.setServer(director);
+    Log::setSyslogHost(director);
+    clockSync.loop();
+    powerManager.loop();
+    probe.loop();
     
     // Configuración inicial de bombas (una sola vez después de conectar)
     if (networkManager.isMQTTConnected() && !pumpController->isInitialConfigSent()) {
@@ -261,18 +437,33 @@ void MainController::loop() {
     // Actualizar estado de bombas (cooldown, desactivación automática)
     pumpController->updatePumps();
     
-    // Publicar estado periódicamente
-    if (millis() - lastStatusPublish > deviceConfig.statusInterval) {
-        publishStatus();
-        lastStatusPublish = millis();
+    // Cambios de bombas como delta apenas ocurren; el estado completo con cadencia lenta
+    statusPublisher->loop();
+    
+    // Publicar estadísticas de uso con cadencia lenta
+    if (millis() - lastStatsPublish > deviceConfig.statsInterval) {
+        publishStats();
+        lastStatsPublish = millis();
     }
 
-    delay(100);  
+    // Parte ociosa: volcar logs pendientes sin bloquear
+    Log::drain();
+    
+    // Pausa corta: acota la latencia de la parada de emergencia (StopAll::LATENCY_TARGET_US)
+    delay(10);  
     yield();  
 }
 
+// Con el PUBACK y la respuesta ya enviados por networkManager.loop()
+void MainController::performReboot() {
+    LOG_INFO("🔄 Reiniciando ahora");
+    networkManager.disconnect();
+    delay(100);
+    ESP.restart();
+}
+
 void MainController::resetDeviceConfig() {
-    Serial.println("🔄 Restableciendo configuración del dispositivo...");
+    LOG_INFO("🔄 Restableciendo configuración del dispositivo...");
     
         // Reset todas las configuraciones de bombas
     pumpController->resetAllPumpConfigs();
@@ -283,5 +474,5 @@ void MainController::resetDeviceConfig() {
     // Reset otras configuraciones si es necesario
     // Por ejemplo: WiFi, MQTT, etc.
     
-    Serial.println("✅ Configuración restablecida correctamente");
+    LOG_INFO("✅ Configuración restablecida correctamente");
 }
\ No newline at end of file
@@ -2,7 +2,14 @@
 #define MAIN_CONTROLLER_H
 
 #include "network_manager.h"
+#ifdef OSMO_HOST_BUILD
+#include "posix_transport.h"
+#else
+#include "esp_transport.h"
+#endif
 #include "command_definition.h"
+#include "udp_command.h"
+#include "link_probe.h"
 
 // Forward declarations para evitar dependencias circulares
 class PumpController;
@@ -10,20 +17,49 @@ class StatusPublisher;
 
 class MainController {
 private:
+    PlatformTransport transport;  // Declarado antes: networkManager lo usa al construirse
     NetworkManager networkManager;
+    UdpCommandChannel udpCommands;  // Ruta corta para tocar en vivo (opcional)
+    LinkProbe probe;                // Sondeo de enlace (comando probe)
     PumpController* pumpController;
     StatusPublisher* statusPublisher;
     
-    unsigned long lastStatusPublish;
+    unsigned long lastStatsPublish;
+    
+    // Parada de emergencia (ruta rápida en el callback)
+    unsigned long commandReceivedMicros;  // Entrada al callback MQTT o lectura del datagrama UDP
+    unsigned long stopLatencyUs;       // Latencia de la última parada desde la recepción
+    bool stopAllPending;               // Falta publicar respuesta/estado de la parada
+    String stopCommandId;              // command_id de la respuesta (el comando corto no trae)
+    
+    // Reinicio diferido: desde loop(), cuando el PUBACK del comando ya salió
+    bool rebootPending;
+    unsigned long rebootAt;
+    static const unsigned long REBOOT_DELAY = 1000;  // ms para vaciar la respuesta encolada
+    
+    // Suscripción QoS 1: el broker puede reentregar un comando ya procesado
+    static const uint8_t RECENT_COMMANDS = 8;
+    String recentCommandIds[RECENT_COMMANDS];
+    uint8_t recentCommandNext;
+    
+    static const uint8_t UDP_COMMAND_BUDGET = 4;  // Datagramas por vuelta de loop()
     
     // Variable estática para el callback wrapper
     static MainController* instancia;
     
     void handleCommand(const char* topic, const char* message);
     void processCommand(const MQTTCommand& cmd);
-    void publishStatus();
+    void publishStatus(bool includeStats = false);
+    void publishStats();
     void sendCommandResponse(const CommandResponse& response);
     void resetDeviceConfig();
+    bool isDuplicateCommand(const String& commandId);
+    bool acceptSequence(const char* topic, uint32_t seq);
+    void pollUdpCommands();
+    void handleStopAll(const char* commandId);
+    void reportStopAll();
+    void performReboot();
+    static bool isStopAllMessage(const char* topic, const uint8_t* payload, unsigned int length);
     
 public:
     MainController();
@@ -0,0 +1,608 @@
+#include "mqtt5_client.h"
+
+// Paquetes y propiedades de MQTT 5 (OASIS, secciones 2.2 y 2.2.2.2)
+namespace {
+    const uint8_t HEADER_MAX = 5;  // Tipo + largo restante (hasta 4 bytes)
+    const uint8_t PROTOCOL_LEVEL = 5;
+
+    const uint8_t PACKET_CONNECT = 0x10;
+    const uint8_t PACKET_PUBLISH = 0x30;
+    const uint8_t PACKET_PUBACK = 0x40;
+    const uint8_t PACKET_SUBSCRIBE = 0x82;
+    const uint8_t PACKET_PINGREQ = 0xC0;
+    const uint8_t PACKET_PINGRESP = 0xD0;
+    const uint8_t PACKET_DISCONNECT = 0xE0;
+
+    const uint8_t TYPE_CONNACK = 2;
+    const uint8_t TYPE_PUBLISH = 3;
+    const uint8_t TYPE_PINGREQ = 12;
+    const uint8_t TYPE_PINGRESP = 13;
+    const uint8_t TYPE_DISCONNECT = 14;
+
+    const uint8_t PROP_MESSAGE_EXPIRY = 0x02;
+    const uint8_t PROP_RESPONSE_TOPIC = 0x08;
+    const uint8_t PROP_CORRELATION_DATA = 0x09;
+    const uint8_t PROP_SESSION_EXPIRY = 0x11;
+    const uint8_t PROP_TOPIC_ALIAS_MAX = 0x22;
+    const uint8_t PROP_TOPIC_ALIAS = 0x23;
+    const uint8_t PROP_MAX_PACKET_SIZE = 0x27;
+
+    uint16_t readU16(const uint8_t* buf, uint32_t pos) {
+        return ((uint16_t)buf[pos] << 8) | buf[pos + 1];
+    }
+
+    uint32_t readU32(const uint8_t* buf, uint32_t pos) {
+        return ((uint32_t)buf[pos] << 24) | ((uint32_t)buf[pos + 1] << 16) |
+               ((uint32_t)buf[pos + 2] << 8) | buf[pos + 3];
+    }
+
+    uint32_t writeU16(uint8_t* buf, uint32_t pos, uint16_t value) {
+        buf[pos++] = value >> 8;
+        buf[pos++] = value & 0xFF;
+        return pos;
+    }
+
+    uint32_t writeU32(uint8_t* buf, uint32_t pos, uint32_t value) {
+        pos = writeU16(buf, pos, value >> 16);
+        return writeU16(buf, pos, value & 0xFFFF);
+    }
+
+    uint32_t writeBytes(uint8_t* buf, uint32_t pos, const uint8_t* data, uint16_t length) {
+        pos = writeU16(buf, pos, length);
+        memcpy(buf + pos, data, length);
+        return pos + length;
+    }
+
+    uint32_t writeString(uint8_t* buf, uint32_t pos, const char* str) {
+        return writeBytes(buf, pos, (const uint8_t*)str, strlen(str));
+    }
+
+    // Variable Byte Integer; false si está cortado o pasa de 4 bytes
+    bool readVarint(const uint8_t* buf, uint32_t* pos, uint32_t end, uint32_t* value) {
+        *value = 0;
+        for (uint8_t shift = 0; shift <= 21; shift += 7) {
+            if (*pos >= end) {
+                return false;
+            }
+            uint8_t digit = buf[(*pos)++];
+            *value |= (uint32_t)(digit & 0x7F) << shift;
+            if (!(digit & 0x80)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Saltea una propiedad que no usamos según su tipo (tabla 2-4 del estándar)
+    bool skipProperty(uint8_t id, const uint8_t* buf, uint32_t* pos, uint32_t end) {
+        uint32_t size;
+        switch (id) {
+            case 0x01: case 0x17: case 0x19: case 0x24: case 0x25: case 0x28: case 0x29: case 0x2A:
+                size = 1;
+                break;
+            case 0x13: case 0x21: case 0x22: case 0x23:
+                size = 2;
+                break;
+            case 0x02: case 0x11: case 0x18: case 0x27:
+                size = 4;
+                break;
+            case 0x0B: {
+                uint32_t ignored;
+                return readVarint(buf, pos, end, &ignored);
+            }
+            case 0x03: case 0x08: case 0x09: case 0x12: case 0x15: case 0x16: case 0x1A: case 0x1C: case 0x1F:
+                if (*pos + 2 > end) {
+                    return false;
+                }
+                size = 2 + readU16(buf, *pos);
+                break;
+            case 0x26: {
+                // Par clave/valor: dos strings seguidos
+                for (uint8_t i = 0; i < 2; i++) {
+                    if (*pos + 2 > end) {
+                        return false;
+                    }
+                    *pos += 2 + readU16(buf, *pos);
+                }
+                return *pos <= end;
+            }
+            default:
+                return false;
+        }
+        *pos += size;
+        return *pos <= end;
+    }
+}
+
+Mqtt5Client::Mqtt5Client(Client& client)
+    : client(client), host(nullptr), port(1883), buffer(nullptr), bufferSize(0),
+      keepAlive(15), socketTimeout(15), sessionExpiry(0), lastOutActivity(0), lastInActivity(0),
+      lastDrainedAt(0), pingOutstanding(false), nextPacketId(1), status(Mqtt5State::Disconnected), callback(nullptr),
+      aliasCount(0), serverAliasMax(0) {
+    request.active = false;
+    setBufferSize(256);
+}
+
+Mqtt5Client::~Mqtt5Client() {
+    free(buffer);
+}
+
+void Mqtt5Client::setServer(const char* newHost, uint16_t newPort) {
+    host = newHost;
+    port = newPort;
+}
+
+void Mqtt5Client::setServer(IPAddress newIp, uint16_t newPort) {
+    host = nullptr;
+    ip = newIp;
+    port = newPort;
+}
+
+bool Mqtt5Client::setBufferSize(uint16_t size) {
+    if (size <= HEADER_MAX) {
+        return false;
+    }
+    uint8_t* resized = (uint8_t*)realloc(buffer, size);
+    if (!resized) {
+        return false;
+    }
+    buffer = resized;
+    bufferSize = size;
+    return true;
+}
+
+void Mqtt5Client::addTopicAlias(const char* topic) {
+    for (uint8_t i = 0; i < aliasCount; i++) {
+        if (aliases[i] == topic) {
+            return;
+        }
+    }
+    if (aliasCount < MAX_ALIASES) {
+        aliases[aliasCount] = topic;
+        aliasSent[aliasCount] = false;
+        aliasCount++;
+    }
+}
+
+// Alias del topic (1..n) si está registrado y el broker acepta tantos; 0 si no
+uint16_t Mqtt5Client::aliasFor(const char* topic) {
+    for (uint8_t i = 0; i < aliasCount && i < serverAliasMax; i++) {
+        if (strcmp(aliases[i], topic) == 0) {
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+bool Mqtt5Client::readByte(uint8_t* out) {
+    unsigned long start = millis();
+    while (!client.available()) {
+        if (millis() - start >= socketTimeout * 1000UL) {
+            return false;
+        }
+        yield();
+    }
+    *out = client.read();
+    return true;
+}
+
+// Lee un paquete completo; el cuerpo queda en buffer[0..length). Nunca llega
+// uno más grande: en CONNECT se anuncia Maximum Packet Size = bufferSize.
+bool Mqtt5Client::readPacket(uint8_t* header, uint32_t* length) {
+    if (!readByte(header)) {
+        return false;
+    }
+    uint32_t value = 0;
+    uint8_t digit;
+    uint8_t shift = 0;
+    do {
+        if (shift > 21 || !readByte(&digit)) {
+            return false;
+        }
+        value |= (uint32_t)(digit & 0x7F) << shift;
+        shift += 7;
+    } while (digit & 0x80);
+
+    if (value > bufferSize) {
+        return false;
+    }
+    for (uint32_t i = 0; i < value; i++) {
+        if (!readByte(&buffer[i])) {
+            return false;
+        }
+    }
+    *length = value;
+    return true;
+}
+
+// El cuerpo ya está en buffer[HEADER_MAX..]: el encabezado fijo se arma
+// justo antes para mandar todo en una sola escritura. present < length
+// cuando el resto del cuerpo lo escribe después write() (beginPublish).
+bool Mqtt5Client::sendPacket(uint8_t header, uint32_t length, uint32_t present) {
+    uint8_t encoded[4];
+    uint8_t encodedLength = 0;
+    uint32_t remaining = length;
+    do {
+        uint8_t digit = remaining & 0x7F;
+        remaining >>= 7;
+        encoded[encodedLength++] = remaining > 0 ? (digit | 0x80) : digit;
+    } while (remaining > 0 && encodedLength < 4);
+
+    uint8_t start = HEADER_MAX - 1 - encodedLength;
+    buffer[start] = header;
+    memcpy(buffer + start + 1, encoded, encodedLength);
+
+    size_t total = 1 + encodedLength + present;
+    size_t written = client.write(buffer + start, total);
+    lastOutActivity = millis();
+    return written == total;
+}
+
+bool Mqtt5Client::connect(const char* id, const char* user, const char* pass,
+                          const char* willTopic, uint8_t willQos, bool willRetain,
+                          const char* willMessage, bool cleanSession) {
+    if (connected()) {
+        return true;
+    }
+
+    int result = host ? client.connect(host, port) : client.connect(ip, port);
+    if (result != 1) {
+        status = Mqtt5State::ConnectFailed;
+        return false;
+    }
+
+    // Largo del cuerpo antes de escribirlo: el buffer no se desborda con credenciales largas
+    size_t needed = 10 + 5 + 5 + 1 + 2 + strlen(id) +
+                    (willTopic ? 1 + 2 + strlen(willTopic) + 2 + strlen(willMessage) : 0) +
+                    (user ? 2 + strlen(user) : 0) + (user && pass ? 2 + strlen(pass) : 0);
+    if (HEADER_MAX + needed > bufferSize) {
+        client.stop();
+        status = Mqtt5State::ConnectFailed;
+        return false;
+    }
+
+    uint8_t flags = cleanSession ? 0x02 : 0x00;
+    if (willTopic) {
+        flags |= 0x04 | ((willQos & 0x03) << 3) | (willRetain ? 0x20 : 0x00);
+    }
+    if (user) {
+        flags |= 0x80;
+        if (pass) {
+            flags |= 0x40;
+        }
+    }
+
+    uint32_t pos = HEADER_MAX;
+    pos = writeString(buffer, pos, "MQTT");
+    buffer[pos++] = PROTOCOL_LEVEL;
+    buffer[pos++] = flags;
+    pos = writeU16(buffer, pos, keepAlive);
+
+    // Propiedades: sin Topic Alias Maximum el broker no nos manda alias
+    buffer[pos++] = cleanSession ? 5 : 10;
+    buffer[pos++] = PROP_MAX_PACKET_SIZE;
+    pos = writeU32(buffer, pos, bufferSize);
+    if (!cleanSession) {
+        buffer[pos++] = PROP_SESSION_EXPIRY;
+        pos = writeU32(buffer, pos, sessionExpiry);
+    }
+
+    pos = writeString(buffer, pos, id);
+    if (willTopic) {
+        buffer[pos++] = 0;  // Sin propiedades de la Last Will
+        pos = writeString(buffer, pos, willTopic);
+        pos = writeString(buffer, pos, willMessage);
+    }
+    if (user) {
+        pos = writeString(buffer, pos, user);
+        if (pass) {
+            pos = writeString(buffer, pos, pass);
+        }
+    }
+
+    if (!sendPacket(PACKET_CONNECT, pos - HEADER_MAX)) {
+        client.stop();
+        status = Mqtt5State::ConnectFailed;
+        return false;
+    }
+
+    uint8_t header;
+    uint32_t length;
+    if (!readPacket(&header, &length) || (header >> 4) != TYPE_CONNACK) {
+        client.stop();
+        status = Mqtt5State::ConnectionTimeout;
+        return false;
+    }
+    if (!parseConnack(length)) {
+        client.stop();
+        return false;
+    }
+
+    lastInActivity = lastDrainedAt = millis();
+    pingOutstanding = false;
+    nextPacketId = 1;
+    for (uint8_t i = 0; i < aliasCount; i++) {
+        aliasSent[i] = false;  // Los alias valen por conexión
+    }
+    status = Mqtt5State::Connected;
+    return true;
+}
+
+// Reason code en status; de las propiedades solo importa el máximo de alias
+bool Mqtt5Client::parseConnack(uint32_t length) {
+    if (length < 2) {
+        status = Mqtt5State::ConnectFailed;
+        return false;
+    }
+    if (buffer[1] != 0) {
+        status = buffer[1];
+        return false;
+    }
+
+    serverAliasMax = 0;
+    uint32_t pos = 2;
+    uint32_t propsLength;
+    if (length > 2 && readVarint(buffer, &pos, length, &propsLength)) {
+        uint32_t end = pos + propsLength;
+        while (pos < end && end <= length) {
+            uint8_t id = buffer[pos++];
+            if (id == PROP_TOPIC_ALIAS_MAX && pos + 2 <= end) {
+                serverAliasMax = readU16(buffer, pos);
+                pos += 2;
+            } else if (!skipProperty(id, buffer, &pos, end)) {
+                break;
+            }
+        }
+    }
+    return true;
+}
+
+void Mqtt5Client::disconnect() {
+    if (client.connected()) {
+        sendPacket(PACKET_DISCONNECT, 0);  // Reason 0: el broker descarta la Last Will
+    }
+    status = Mqtt5State::Disconnected;
+    client.flush();
+    client.stop();
+    lastInActivity = lastOutActivity = millis();
+}
+
+bool Mqtt5Client::connected() {
+    if (!client.connected()) {
+        if (status == Mqtt5State::Connected) {
+            status = Mqtt5State::ConnectionLost;
+            client.flush();
+            client.stop();
+        }
+        return false;
+    }
+    return status == Mqtt5State::Connected;
+}
+
+bool Mqtt5Client::loop() {
+    if (!connected()) {
+        return false;
+    }
+
+    unsigned long now = millis();
+    unsigned long keepAliveMs = keepAlive * 1000UL;
+    if (keepAliveMs > 0 && (now - lastInActivity > keepAliveMs || now - lastOutActivity > keepAliveMs)) {
+        if (pingOutstanding) {
+            status = Mqtt5State::ConnectionTimeout;
+            client.stop();
+            return false;
+        }
+        sendPacket(PACKET_PINGREQ, 0);
+        lastInActivity = now;
+        pingOutstanding = true;
+    }
+
+    if (!client.available()) {
+        lastDrainedAt = now;
+        return true;
+    }
+
+    // Un paquete por vuelta, como PubSubClient
+    uint8_t header;
+    uint32_t length;
+    if (!readPacket(&header, &length)) {
+        status = Mqtt5State::ConnectionLost;
+        client.stop();
+        return false;
+    }
+    lastInActivity = millis();
+
+    switch (header >> 4) {
+        case TYPE_PUBLISH:
+            handlePublish(header, length);
+            break;
+        case TYPE_PINGREQ:
+            sendPacket(PACKET_PINGRESP, 0);
+            break;
+        case TYPE_PINGRESP:
+            pingOutstanding = false;
+            break;
+        case TYPE_DISCONNECT:
+            // El broker cierra (sesión tomada por otro clientId, paquete inválido...)
+            status = length > 0 ? buffer[0] : Mqtt5State::ConnectionLost;
+            client.stop();
+            return false;
+        default:
+            break;  // SUBACK/PUBACK: no se esperan
+    }
+    return true;
+}
+
+void Mqtt5Client::handlePublish(uint8_t header, uint32_t length) {
+    uint8_t qos = (header >> 1) & 0x03;
+    if (length < 2) {
+        return;
+    }
+    uint16_t topicLength = readU16(buffer, 0);
+    uint32_t pos = 2 + topicLength;
+    uint16_t packetId = 0;
+    if (qos > 0) {
+        if (pos + 2 > length) {
+            return;
+        }
+        packetId = readU16(buffer, pos);
+        pos += 2;
+    }
+
+    uint32_t propsLength;
+    if (!readVarint(buffer, &pos, length, &propsLength) || pos + propsLength > length) {
+        return;
+    }
+    uint32_t payloadStart = pos + propsLength;
+
+    request.responseTopic[0] = '\0';
+    request.correlationLength = 0;
+    request.expiry = 0;
+    request.receivedAt = lastDrainedAt;
+    while (pos < payloadStart) {
+        uint8_t id = buffer[pos++];
+        if (id == PROP_MESSAGE_EXPIRY && pos + 4 <= payloadStart) {
+            request.expiry = readU32(buffer, pos);
+            pos += 4;
+        } else if ((id == PROP_RESPONSE_TOPIC || id == PROP_CORRELATION_DATA) && pos + 2 <= payloadStart) {
+            uint16_t n = readU16(buffer, pos);
+            if (pos + 2 + n > payloadStart) {
+                return;
+            }
+            // Lo que no entra se ignora: se contesta en el topic propio / con command_id
+            if (id == PROP_RESPONSE_TOPIC && n < sizeof(request.responseTopic)) {
+                memcpy(request.responseTopic, buffer + pos + 2, n);
+                request.responseTopic[n] = '\0';
+            } else if (id == PROP_CORRELATION_DATA && n <= sizeof(request.correlation)) {
+                memcpy(request.correlation, buffer + pos + 2, n);
+                request.correlationLength = n;
+            }
+            pos += 2 + n;
+        } else if (!skipProperty(id, buffer, &pos, payloadStart)) {
+            return;
+        }
+    }
+
+    // Sin Topic Alias Maximum propio el topic siempre viene completo
+    if (topicLength == 0) {
+        return;
+    }
+
+    // Topic terminado en '\0' corriéndolo sobre su largo, como PubSubClient
+    memmove(buffer, buffer + 2, topicLength);
+    buffer[topicLength] = '\0';
+
+    if (callback) {
+        request.active = true;
+        callback((char*)buffer, buffer + payloadStart, length - payloadStart);
+        request.active = false;
+    }
+
+    if (qos == 1) {
+        writeU16(buffer, HEADER_MAX, packetId);
+        sendPacket(PACKET_PUBACK, 2);
+    }
+}
+
+bool Mqtt5Client::requestExpired() const {
+    return request.active && request.expiry > 0 &&
+           millis() - request.receivedAt >= request.expiry * 1000UL;
+}
+
+bool Mqtt5Client::publish(const char* topic, const char* payload, bool retained) {
+    return publish(topic, (const uint8_t*)payload, strlen(payload), retained);
+}
+
+// Topic (o solo alias) y propiedades desde buffer[HEADER_MAX]; devuelve el
+// final, 0 si no entra. Con CORRELATION_MAX chico las propiedades siempre
+// entran en un byte de largo.
+uint32_t Mqtt5Client::putPublishHeader(const char* topic, uint16_t alias,
+                                       const uint8_t* correlation, uint8_t correlationLength) {
+    bool sendTopic = alias == 0 || !aliasSent[alias - 1];
+    size_t topicLength = sendTopic ? strlen(topic) : 0;
+    uint8_t propsLength = (alias ? 3 : 0) + (correlationLength ? 3 + correlationLength : 0);
+    if (HEADER_MAX + 2 + topicLength + 1 + propsLength > bufferSize) {
+        return 0;
+    }
+
+    uint32_t pos = writeU16(buffer, HEADER_MAX, topicLength);
+    memcpy(buffer + pos, topic, topicLength);
+    pos += topicLength;
+    buffer[pos++] = propsLength;
+    if (alias) {
+        buffer[pos++] = PROP_TOPIC_ALIAS;
+        pos = writeU16(buffer, pos, alias);
+    }
+    if (correlationLength) {
+        buffer[pos++] = PROP_CORRELATION_DATA;
+        pos = writeBytes(buffer, pos, correlation, correlationLength);
+    }
+    return pos;
+}
+
+bool Mqtt5Client::publish(const char* topic, const uint8_t* payload, unsigned int length, bool retained,
+                          const uint8_t* correlation, uint8_t correlationLength) {
+    if (!connected()) {
+        return false;
+    }
+
+    uint16_t alias = aliasFor(topic);
+    uint32_t pos = putPublishHeader(topic, alias, correlation, correlationLength);
+    if (pos == 0 || pos + length > bufferSize) {
+        return false;
+    }
+    memcpy(buffer + pos, payload, length);
+
+    if (!sendPacket(PACKET_PUBLISH | (retained ? 0x01 : 0x00), pos - HEADER_MAX + length)) {
+        return false;
+    }
+    if (alias) {
+        aliasSent[alias - 1] = true;
+    }
+    return true;
+}
+
+bool Mqtt5Client::beginPublish(const char* topic, unsigned int length, bool retained) {
+    if (!connected()) {
+        return false;
+    }
+
+    uint16_t alias = aliasFor(topic);
+    uint32_t pos = putPublishHeader(topic, alias, nullptr, 0);
+    if (pos == 0) {
+        return false;
+    }
+    uint32_t header = pos - HEADER_MAX;
+    if (!sendPacket(PACKET_PUBLISH | (retained ? 0x01 : 0x00), header + length, header)) {
+        return false;
+    }
+    if (alias) {
+        aliasSent[alias - 1] = true;
+    }
+    return true;
+}
+
+size_t Mqtt5Client::write(const uint8_t* data, size_t length) {
+    lastOutActivity = millis();
+    return client.write(data, length);
+}
+
+int Mqtt5Client::endPublish() {
+    return connected() ? 1 : 0;
+}
+
+bool Mqtt5Client::subscribe(const char* topic, uint8_t qos) {
+    size_t topicLength = strlen(topic);
+    if (!connected() || HEADER_MAX + 2 + 1 + 2 + topicLength + 1 > bufferSize) {
+        return false;
+    }
+
+    uint32_t pos = writeU16(buffer, HEADER_MAX, nextPacketId++);
+    if (nextPacketId == 0) {
+        nextPacketId = 1;
+    }
+    buffer[pos++] = 0;  // Sin propiedades
+    pos = writeString(buffer, pos, topic);
+    buffer[pos++] = qos > 1 ? 1 : qos;  // Sin PUBREC/PUBREL: QoS 2 no se pide
+    return sendPacket(PACKET_SUBSCRIBE, pos - HEADER_MAX);
+}
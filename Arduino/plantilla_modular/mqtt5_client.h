@@ -0,0 +1,116 @@
+#ifndef MQTT5_CLIENT_H
+#define MQTT5_CLIENT_H
+
+#include <Arduino.h>
+#include <Client.h>
+#include "publish_queue.h"
+
+// Códigos de state() (mismos valores que PubSubClient; los de CONNACK v5
+// llegan tal cual, 0x80 en adelante)
+namespace Mqtt5State {
+    const int ConnectionTimeout = -4;
+    const int ConnectionLost = -3;
+    const int ConnectFailed = -2;
+    const int Disconnected = -1;
+    const int Connected = 0;
+}
+
+// Propiedades v5 del PUBLISH entrante que se está entregando al callback.
+// Solo valen dentro del callback: después se limpian para que una respuesta
+// a un comando UDP o de la ruta rápida no herede la correlación ajena.
+struct Mqtt5Request {
+    bool active;
+    char responseTopic[PublishQueueLimits::TOPIC_MAX];  // "" = topic de respuesta propio
+    uint8_t correlation[PublishQueueLimits::CORRELATION_MAX];
+    uint8_t correlationLength;
+    uint32_t expiry;  // s que le quedaban al salir del broker (0 = sin expiración)
+    unsigned long receivedAt;  // millis() más temprano en que pudo llegar al socket
+};
+
+// Cliente MQTT 5 mínimo con la misma interfaz que PubSubClient usa
+// NetworkManager (se elige en compilación con OSMO_MQTT_V5). Agrega lo que
+// 3.1.1 no tiene: alias de topic en lo que publicamos, response topic y
+// correlation data para contestar comandos, y expiración de sesión. La
+// expiración de los comandos la aplica el broker: lo vencido mientras la
+// unidad no estaba nunca se entrega; lo que vence ya en el socket lo descarta
+// MainController antes de procesarlo (requestExpired). Publica con QoS 0 y se
+// suscribe con QoS <= 1, igual que PubSubClient.
+class Mqtt5Client {
+public:
+    typedef void (*Callback)(char*, uint8_t*, unsigned int);
+    static const uint8_t MAX_ALIASES = 8;
+
+private:
+    Client& client;
+    const char* host;
+    IPAddress ip;
+    uint16_t port;
+    uint8_t* buffer;
+    uint16_t bufferSize;
+    uint16_t keepAlive;        // s
+    uint16_t socketTimeout;    // s
+    uint32_t sessionExpiry;    // s que el broker guarda la sesión sin cleanSession
+    unsigned long lastOutActivity;
+    unsigned long lastInActivity;
+    unsigned long lastDrainedAt;  // Última vuelta de loop() con el socket vacío
+    bool pingOutstanding;
+    uint16_t nextPacketId;
+    int status;
+    Callback callback;
+    Mqtt5Request request;
+
+    // Topics propios con alias fijo (índice + 1); se mandan completos la
+    // primera vez de cada conexión y después solo el alias
+    const char* aliases[MAX_ALIASES];
+    bool aliasSent[MAX_ALIASES];
+    uint8_t aliasCount;
+    uint16_t serverAliasMax;   // Topic Alias Maximum del CONNACK
+
+    bool readByte(uint8_t* out);
+    bool readPacket(uint8_t* header, uint32_t* length);
+    bool sendPacket(uint8_t header, uint32_t length, uint32_t present);
+    bool sendPacket(uint8_t header, uint32_t length) { return sendPacket(header, length, length); }
+    uint16_t aliasFor(const char* topic);
+    uint32_t putPublishHeader(const char* topic, uint16_t alias, const uint8_t* correlation, uint8_t correlationLength);
+    void handlePublish(uint8_t header, uint32_t length);
+    bool parseConnack(uint32_t length);
+
+public:
+    explicit Mqtt5Client(Client& client);
+    ~Mqtt5Client();
+
+    void setServer(const char* host, uint16_t port);
+    void setServer(IPAddress ip, uint16_t port);
+    bool setBufferSize(uint16_t size);
+    void setKeepAlive(uint16_t seconds) { keepAlive = seconds; }
+    void setSocketTimeout(uint16_t seconds) { socketTimeout = seconds; }
+    void setSessionExpiry(uint32_t seconds) { sessionExpiry = seconds; }
+    void setCallback(Callback cb) { callback = cb; }
+    // Registra un topic propio (almacenamiento estático) para publicarlo con alias
+    void addTopicAlias(const char* topic);
+
+    bool connect(const char* id, const char* user, const char* pass,
+                 const char* willTopic, uint8_t willQos, bool willRetain,
+                 const char* willMessage, bool cleanSession);
+    void disconnect();
+    bool connected();
+    int state() const { return status; }
+    bool loop();
+
+    bool publish(const char* topic, const char* payload, bool retained = false);
+    bool publish(const char* topic, const uint8_t* payload, unsigned int length, bool retained,
+                 const uint8_t* correlation = nullptr, uint8_t correlationLength = 0);
+    bool subscribe(const char* topic, uint8_t qos);
+    // Publicación por partes para payloads que no entran en el buffer:
+    // encabezado con el largo total, write() directo al socket y endPublish()
+    bool beginPublish(const char* topic, unsigned int length, bool retained);
+    size_t write(const uint8_t* data, size_t length);
+    int endPublish();
+
+    const Mqtt5Request& currentRequest() const { return request; }
+    // El comando en curso venció esperando en el socket (loop() trabado o cola
+    // de paquetes): cuenta desde lastDrainedAt, la peor llegada posible
+    bool requestExpired() const;
+};
+
+#endif
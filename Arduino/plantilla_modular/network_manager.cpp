@@ -1,171 +1,685 @@
 #include "network_manager.h"
+#include "log.h"
 #include <ArduinoJson.h> 
+#include "command_definition.h"
 
-NetworkManager::NetworkManager() : mqttClient(espClient), isConnected(false) {
+// Tiempos de la máquina de estados de conexión
+namespace {
+    const unsigned long WIFI_CONNECT_TIMEOUT = 20000;  // ms antes de reiniciar WiFi.begin
+    const unsigned long WIFI_DIRECTED_TIMEOUT = 4000;  // ms del intento directo (asociación + DHCP) antes de escanear
+    const unsigned long MQTT_BACKOFF_BASE = 1000;      // ms del primer reintento MQTT
+    const unsigned long MQTT_BACKOFF_MAX = 60000;      // ms máximo entre reintentos
+    const unsigned long SOCKET_CONNECT_TIMEOUT = 2000; // ms máximo de un connect TCP
+    const uint16_t MQTT_SOCKET_TIMEOUT = 2;            // s máximo esperando CONNACK
+    const uint8_t DRAIN_BUDGET = 4;                    // Publicaciones por tick de red
+    const uint8_t RAM_HEADROOM = 3;                    // Slots reservados a estado/stats/latido sin broker
+    const unsigned long SPOOL_FLUSH_INTERVAL = 100;    // ms entre envíos desde el spool (10 msg/s)
+    // Presencia retenida: el broker publica la Last Will si perdemos la conexión
+    // sin DISCONNECT (corte, reset, keepAlive vencido)
+    const char* PRESENCE_ONLINE = "online";
+    const char* PRESENCE_OFFLINE = "offline";
+    
+    // serializeJson escribe de a un carácter: se juntan en bloques para no
+    // mandar un segmento TCP por byte
+    class ChunkedPublish : public Print {
+    private:
+        MqttClient& client;
+        uint8_t chunk[128];
+        size_t used;
+        bool ok;
+        
+    public:
+        explicit ChunkedPublish(MqttClient& client) : client(client), used(0), ok(true) {}
+        
+        size_t write(uint8_t c) override {
+            chunk[used++] = c;
+            if (used == sizeof(chunk)) {
+                flushChunk();
+            }
+            return 1;
+        }
+        
+        size_t write(const uint8_t* data, size_t size) override {
+            for (size_t i = 0; i < size; i++) {
+                write(data[i]);
+            }
+            return size;
+        }
+        
+        bool flushChunk() {
+            if (used > 0) {
+                ok &= client.write(chunk, used) == used;
+                used = 0;
+            }
+            return ok;
+        }
+    };
+#ifdef OSMO_MQTT_V5
+    // Igual que persistent_client_expiration del Mosquitto local
+    const uint32_t MQTT_SESSION_EXPIRY = 86400;
+    // Lo que publicamos seguido: después del primer envío solo viaja el alias
+    const Topic ALIASED_TOPICS[] = {
+        Topic::Status, Topic::Heartbeat, Topic::Response, Topic::Events,
+        Topic::Stats, Topic::Errors, Topic::Presence, Topic::Discovery
+    };
+#endif
+}
+
+NetworkManager::NetworkManager(ITransport& transport)
+    : transport(transport), mqttClient(transport.client()), isConnected(false),
+      state(ConnectionState::WiFiIdle), stateSince(0), nextMQTTAttempt(0),
+      backoff(MQTT_BACKOFF_BASE, MQTT_BACKOFF_MAX), nextSpoolFlush(0), spoolInFlight(false),
+      spoolDroppedAtSend(0), wifiDirected(false),
+      connects(0), publishAttempts(0), publishFailures(0) {
     mqttClient.setServer(mqttConfig.server, mqttConfig.port);
+    // El buffer por defecto (256) no alcanza para estado con estadísticas
+    mqttClient.setBufferSize(1024);
+    // Acotar el único paso bloqueante que queda (un intento de connect)
+    transport.setConnectTimeout(SOCKET_CONNECT_TIMEOUT);
+    mqttClient.setSocketTimeout(MQTT_SOCKET_TIMEOUT);
+#ifdef OSMO_MQTT_V5
+    mqttClient.setSessionExpiry(MQTT_SESSION_EXPIRY);
+#endif
+}
+
+const char* NetworkManager::stateName(ConnectionState s) {
+    switch (s) {
+        case ConnectionState::WiFiIdle: return "WiFiIdle";
+        case ConnectionState::WiFiConnecting: return "WiFiConnecting";
+        case ConnectionState::MqttWaiting: return "MqttWaiting";
+        case ConnectionState::MqttConnected: return "MqttConnected";
+    }
+    return "UNKNOWN";
+}
+
+void NetworkManager::setState(ConnectionState newState) {
+    if (state == newState) {
+        return;
+    }
+    LOG_INFO("🔀 Red: %s -> %s", stateName(state), stateName(newState));
+    // Lo enviado sin confirmar se reenvía, en orden, en la próxima conexión
+    if (state == ConnectionState::MqttConnected) {
+        uint8_t requeued = outbound.requeueInFlight();
+        if (requeued > 0) {
+            LOG_INFO("🔁 %u mensajes en vuelo se reenviarán al reconectar", requeued);
+        }
+        spoolInFlight = false;  // Sigue primero en flash
+    }
+    state = newState;
+    stateSince = millis();
 }
 
-void NetworkManager::setupWiFi() {
-    Serial.print("Conectando a WiFi...");
+void NetworkManager::startWiFi() {
+    WiFi.persistent(false);  // Sin escribir credenciales en flash en cada begin
+    WiFi.mode(WIFI_STA);
     
-    WiFi.begin(wifiConfig.ssid, wifiConfig.password);
+    // Con un AP guardado: canal y BSSID fijos (sin escaneo); la IP, por DHCP
+    wifiDirected = wifiCache.load(wifiConfig.ssid);
+    if (wifiDirected) {
+        LOG_INFO("Conectando a WiFi (directo, canal %d)...", wifiCache.getChannel());
+        WiFi.begin(wifiConfig.ssid, wifiConfig.password, wifiCache.getChannel(), wifiCache.getBssid());
+    } else {
+        LOG_INFO("Conectando a WiFi...");
+        WiFi.begin(wifiConfig.ssid, wifiConfig.password);
+    }
+    setState(ConnectionState::WiFiConnecting);
+}
+
+void NetworkManager::pollWiFi() {
+    if (WiFi.status() == WL_CONNECTED) {
+        LOG_INFO("✅ WiFi conectado en %lu ms%s", millis() - stateSince, wifiDirected ? " (directo)" : "");
+        LOG_INFO("IP: %s", WiFi.localIP().toString().c_str());
+        rememberAccessPoint();
+        nextMQTTAttempt = millis() + backoff.initialDelay();
+        setState(ConnectionState::MqttWaiting);
+        return;
+    }
     
-    // TIMEOUT de 20 segundos
-    unsigned long startTime = millis();
-    while (WiFi.status() != WL_CONNECTED && (millis() - startTime) < 20000) {
-        delay(500);
-        yield();
-        Serial.print(".");
+    // El AP cambió de canal o se apagó: escaneo normal
+    if (wifiDirected && millis() - stateSince > WIFI_DIRECTED_TIMEOUT) {
+        LOG_WARN("⚠️ Conexión directa falló, escaneando");
+        wifiCache.invalidate();
+        wifiDirected = false;
+        WiFi.disconnect();
+        setState(ConnectionState::WiFiIdle);
+        return;
     }
     
-    if (WiFi.status() == WL_CONNECTED) {
-        Serial.println("\n✅ WiFi conectado");
-        Serial.print("IP: ");
-        Serial.println(WiFi.localIP());
-    } else {
-        Serial.println("\n❌ Timeout WiFi - continuando sin conexión");
+    if (millis() - stateSince > WIFI_CONNECT_TIMEOUT) {
+        LOG_ERROR("❌ Timeout WiFi - reintentando");
+        WiFi.disconnect();
+        setState(ConnectionState::WiFiIdle);
     }
 }
 
-void NetworkManager::setupMQTT() {
-   // mqttClient.setKeepAlive(mqttConfig.keepAlive);
-    //mqttClient.setCleanSession(mqttConfig.cleanSession);
+// Guarda el AP para el próximo arranque
+void NetworkManager::rememberAccessPoint() {
+    wifiCache.save(wifiConfig.ssid, WiFi.BSSID(), WiFi.channel());
+}
 
-    unsigned long startTime = millis();
-    while (!mqttClient.connected() && (millis() - startTime) < 10000) {
-        Serial.print("Intentando MQTT...");
-        
-        if (mqttClient.connect(mqttConfig.clientId, mqttConfig.user, mqttConfig.password)) {
-            Serial.println("✅ MQTT conectado");
-            isConnected = true;
-            // Suscribirse a comandos del director
-            char commandTopic[50];
-            sprintf(commandTopic, "motete/director/commands/%s", deviceConfig.unitId);
-            subscribe(commandTopic);
-            
+// Un único intento de conexión MQTT; el reintento lo agenda loop()
+void NetworkManager::attemptMQTT() {
+    mqttClient.setKeepAlive(mqttConfig.keepAlive);
+
+    LOG_INFO("Intentando MQTT...");
+    
+    // Sesión persistente (cleanSession = false): con el mismo clientId el broker
+    // guarda la suscripción y encola los comandos QoS 1 mientras no estamos.
+    // La Last Will deja "offline" retenido en presence si caemos sin avisar.
+    const char* presenceTopic = topicTable.get(Topic::Presence);
+    unsigned long start = millis();
+    bool ok = mqttClient.connect(mqttConfig.clientId, mqttConfig.user, mqttConfig.password,
+                                 presenceTopic, 1, true, PRESENCE_OFFLINE, mqttConfig.cleanSession);
+    pool.recordConnect(ok, millis() - start);
+    
+    if (ok) {
+        LOG_INFO("%s (broker %u, %lu ms)", mqttConfig.cleanSession ? "✅ MQTT conectado" : "✅ MQTT conectado (sesión persistente)",
+                 pool.getCurrent(), millis() - start);
+        isConnected = true;
+        connects++;
+        backoff.reset();
+        setState(ConnectionState::MqttConnected);
+        if (pool.isOnPrimary()) {
+            broker.onSuccess();
+        }
+        // En un broker nuevo no hay sesión: suscripciones de nuevo y lo
+        // pendiente (cola en RAM y spool) sale por drainQueue/flushSpool
+        publishPresence();
+        subscribeTopics();
+        announce();
+    } else {
+        LOG_ERROR("❌ MQTT falló, rc=%d", mqttClient.state());
+        // Cuenta para mDNS aunque enseguida se pase a un respaldo
+        if (pool.isOnPrimary()) {
+            broker.onFailure();
+        }
+        if (pool.shouldFailover()) {
+            // Cambio rápido: el otro broker se intenta ya. El backoff no se
+            // reinicia (solo un CONNACK lo hace): con los dos caídos la espera
+            // sigue creciendo y la flota no reintenta en ráfaga cada ~1 s
+            pool.failover();
+            applyBroker();
+            nextMQTTAttempt = millis();
             return;
+        }
+        scheduleRetry();
+    }
+}
+
+void NetworkManager::applyBroker() {
+    if (!pool.isOnPrimary()) {
+        const BrokerEndpoint& standby = mqttConfig.standby[pool.getCurrent() - 1];
+        mqttClient.setServer(standby.server, standby.port);
+    } else if (broker.hasAddress()) {
+        mqttClient.setServer(broker.getIP(), broker.getPort());
+    } else {
+        mqttClient.setServer(mqttConfig.server, mqttConfig.port);
+    }
+}
+
+// Mientras se usa un respaldo: connect TCP no bloqueante al primario
+// (acotado como un intento MQTT), revisado en cada vuelta de loop(). Con
+// sondeos buenos seguidos se vuelve a él.
+void NetworkManager::probePrimary() {
+    if (pool.primaryProbeDue() && !primaryProbe.isBusy()) {
+        if (broker.hasAddress()) {
+            primaryProbe.start(broker.getIP(), broker.getPort(), SOCKET_CONNECT_TIMEOUT);
         } else {
-            Serial.print("❌ MQTT falló, rc=");
-            Serial.println(mqttClient.state());
-            delay(1000);
-            yield();
+            primaryProbe.start(mqttConfig.server, mqttConfig.port, SOCKET_CONNECT_TIMEOUT);
         }
     }
     
-    if (!mqttClient.connected()) {
-        Serial.println("❌ Timeout MQTT - continuando sin conexión");
+    TcpProbe::Result result = primaryProbe.poll();
+    if (result != TcpProbe::Result::Up && result != TcpProbe::Result::Down) {
+        return;
+    }
+    // Ya de vuelta en el primario por otra vía: el resultado llegó tarde
+    if (pool.getCurrent() == 0) {
+        return;
+    }
+    
+    // Desde un respaldo los sondeos son los únicos intentos contra el primario:
+    // sus fallos también cuentan para buscarlo por mDNS (la consulta no bloquea)
+    if (result == TcpProbe::Result::Up) {
+        broker.onReachable();
+    } else {
+        broker.onFailure();
+    }
+    if (!pool.recordPrimaryProbe(result == TcpProbe::Result::Up, primaryProbe.getLatencyMs())) {
+        return;
+    }
+    
+    pool.returnToPrimary();
+    disconnect();  // "offline" retenido en el respaldo antes de irse
+    applyBroker();
+    setState(ConnectionState::MqttWaiting);
+    nextMQTTAttempt = millis();
+}
+
+// Presentación en el topic común: el director conoce la unidad sin configurarla
+void NetworkManager::announce() {
+    StaticJsonDocument<384> doc;
+    doc["unit_id"] = deviceConfig.unitId;
+    doc["ip"] = WiFi.localIP().toString();
+    doc["mac"] = WiFi.macAddress();
+    doc["rssi"] = WiFi.RSSI();
+    doc["pump_count"] = deviceConfig.pumpCount;
+    doc["transport"] = transport.name();
+    if (!pool.isOnPrimary()) {
+        doc["broker"] = mqttConfig.standby[pool.getCurrent() - 1].server;
+    } else {
+        doc["broker"] = broker.hasAddress() ? broker.getIP().toString() : String(mqttConfig.server);
+    }
+    doc["broker_source"] = pool.isOnPrimary() ? BrokerDiscovery::sourceName(broker.getSource()) : "standby";
+    doc["broker_index"] = pool.getCurrent();
+    doc["timestamp"] = millis();
+    
+    String announceJSON;
+    serializeJson(doc, announceJSON);
+    enqueue(PublishClass::Event, topicTable.get(Topic::Discovery), announceJSON.c_str());
+}
+
+// Primer mensaje de cada sesión, antes que lo encolado: pisa la Last Will retenida
+void NetworkManager::publishPresence() {
+    if (!mqttClient.publish(topicTable.get(Topic::Presence), PRESENCE_ONLINE, true)) {
+        LOG_ERROR("❌ No se pudo publicar presencia");
     }
 }
 
+void NetworkManager::subscribeTopics() {
+    // Suscribirse a comandos del director
+    subscribe(topicTable.get(Topic::Commands));
+    // Comandos y bundles para varias unidades en un solo publish
+    for (uint8_t i = 0; i < topicTable.getGroupCount(); i++) {
+        subscribe(topicTable.getGroup(i));
+    }
+    
+    // Parada de emergencia: topic general y topic propio de la unidad
+    subscribe(StopAll::TOPIC_PREFIX);
+    subscribe(topicTable.get(Topic::StopUnit));
+    // Eco propio para medir la ida y vuelta por el broker (LinkProbe)
+    subscribe(topicTable.get(Topic::Echo));
+}
+
+void NetworkManager::scheduleRetry() {
+    unsigned long wait = backoff.nextDelay();
+    nextMQTTAttempt = millis() + wait;
+    LOG_INFO("⏳ Próximo intento MQTT en %lu ms (reintento #%d)", wait, backoff.getAttempts());
+}
+
+// Inicia la conexión sin bloquear; el progreso ocurre en loop()
 bool NetworkManager::connect() {
-    setupWiFi();
-    setupMQTT();
+    // Jitter propio de cada unidad para no reconectar en sincronía con la flota
+    backoff.seed(ESP.getChipId());
+    LOG_INFO("🔌 Transporte: %s", transport.name());
+    // Lo que quedó en flash de una sesión anterior se envía al reconectar
+    spool.begin();
+    // Después del spool: la caché del broker también está en LittleFS
+    broker.begin();
+    pool.begin();
+    applyBroker();
+#ifdef OSMO_MQTT_V5
+    // La TopicTable ya está construida: sus punteros no cambian
+    for (Topic topic : ALIASED_TOPICS) {
+        mqttClient.addTopicAlias(topicTable.get(topic));
+    }
+#endif
+    if (state == ConnectionState::WiFiIdle) {
+        startWiFi();
+    }
     return isConnected;
 }
 
+// Antes de un reinicio: envía lo pendiente y avisa la salida. Con DISCONNECT
+// el broker descarta la Last Will, por eso el "offline" se publica a mano.
+void NetworkManager::disconnect() {
+    if (mqttClient.connected()) {
+        drainQueue();
+        mqttClient.publish(topicTable.get(Topic::Presence), PRESENCE_OFFLINE, true);
+        mqttClient.disconnect();
+    }
+    isConnected = false;
+}
+
 bool NetworkManager::isMQTTConnected() {
     return mqttClient.connected();
 }
 
 void NetworkManager::loop() {
-    if (!mqttClient.connected()) {
+    // Si se cae el WiFi, volver a esperarlo (el SDK reconecta solo)
+    if ((state == ConnectionState::MqttWaiting || state == ConnectionState::MqttConnected) &&
+        WiFi.status() != WL_CONNECTED) {
+        LOG_INFO("📴 WiFi perdido");
         isConnected = false;
-        Serial.println("�� MQTT desconectado, reconectando...");
-        setupMQTT();
+        wifiDirected = false;  // La reconexión del SDK reusa el mismo BSSID/canal
+        setState(ConnectionState::WiFiConnecting);
+    }
+    
+    spillToSpool();
+    
+    // El primario cambió de dirección: salud nueva y, si está en uso, a ella
+    if (broker.loop()) {
+        pool.resetHealth(0);
+        if (pool.isOnPrimary()) {
+            applyBroker();
+        }
     }
     
-    mqttClient.loop();
+    switch (state) {
+        case ConnectionState::WiFiIdle:
+            startWiFi();
+            break;
+            
+        case ConnectionState::WiFiConnecting:
+            pollWiFi();
+            break;
+            
+        case ConnectionState::MqttWaiting:
+            if ((long)(millis() - nextMQTTAttempt) >= 0) {
+                attemptMQTT();
+            }
+            break;
+            
+        case ConnectionState::MqttConnected:
+            if (!mqttClient.connected()) {
+                isConnected = false;
+                pool.recordDrop();
+                LOG_INFO("📴 MQTT desconectado, reconectando...");
+                scheduleRetry();
+                setState(ConnectionState::MqttWaiting);
+            } else {
+                // PubSubClient solo publica con QoS 0 (sin PUBACK): lo enviado en un
+                // tick anterior se da por entregado si este loop() encuentra la
+                // conexión arriba. Así los slots en vuelo no esperan un plazo fijo
+                if (mqttClient.loop()) {
+                    outbound.releaseInFlight();
+                    releaseSpool();
+                }
+                drainQueue();
+                flushSpool();
+                probePrimary();
+            }
+            break;
+    }
     
     // Log de estado cada 30 segundos
     static unsigned long lastLog = 0;
     if (millis() - lastLog > 30000) {
-        Serial.print("📡 Estado MQTT: ");
-        Serial.println(mqttClient.connected() ? "Conectado" : "Desconectado");
+        LOG_INFO("📡 Estado red: %s", stateName(state));
         lastLog = millis();
     }
 }
 
 bool NetworkManager::publish(const char* topic, const char* message) {
-    return mqttClient.publish(topic, message);
+    return countPublish(mqttClient.publish(topic, message));
+}
+
+// Contadores para el sondeo de enlace (LinkProbe)
+bool NetworkManager::countPublish(bool ok) {
+    publishAttempts++;
+    if (!ok) {
+        publishFailures++;
+    }
+    return ok;
 }
 
 bool NetworkManager::subscribe(const char* topic) {
+    if (topic[0] == '\0') {
+        return false;
+    }
     if (mqttClient.connected()) {
-        bool result = mqttClient.subscribe(topic);
+        // QoS 1: el broker reenvía lo no confirmado y encola mientras no estamos
+        bool result = mqttClient.subscribe(topic, mqttConfig.qos);
         if (result) {
-            Serial.print("✅ Suscrito a: ");
-            Serial.println(topic);
+            LOG_INFO("✅ Suscrito a: %s", topic);
         } else {
-            Serial.print("❌ Error suscribiéndose a: ");
-            Serial.println(topic);
+            LOG_ERROR("❌ Error suscribiéndose a: %s", topic);
         }
         return result;
     }
-    Serial.println("❌ MQTT no conectado para suscribirse");
+    LOG_ERROR("❌ MQTT no conectado para suscribirse");
     return false;
 }
 
-bool NetworkManager::publishWithQoS(const char* topic, const char* message, int qos) {
-    if (mqttClient.connected()) {
-        // Verificar longitud del mensaje
-        int messageLength = strlen(message);
-        if (messageLength > 512) {
-            Serial.print("⚠️ Mensaje muy largo (");
-            Serial.print(messageLength);
-            Serial.println(" bytes), truncando...");
+// Escribe en el spool; false si no hay flash disponible
+bool NetworkManager::pushSpool(const QueuedMessage& msg) {
+    unsigned long droppedBefore = spool.getDropped();
+    if (!spool.push(msg.cls, msg.topic, msg.payload, msg.correlation, msg.correlationLength)) {
+        return false;
+    }
+    if (spool.getDropped() != droppedBefore) {
+        LOG_WARN("⚠️ Spool offline lleno, se descartó el mensaje más antiguo");
+    }
+    return true;
+}
+
+// Con la RAM casi llena, respuestas/eventos/configuración pasan a flash desde
+// loop(), los más antiguos primero, detrás de lo que ya está en el spool: sin
+// broker, o con broker mientras todavía se vacía el backlog. Con broker y
+// spool vacío no se escribe flash. Los slots libres quedan para estado/stats/latido.
+void NetworkManager::spillToSpool() {
+    if ((mqttClient.connected() && spool.size() == 0) || !spool.isReady()) {
+        return;
+    }
+    while (outbound.freeSlots() <= RAM_HEADROOM) {
+        const QueuedMessage* msg = outbound.frontTracked();
+        if (!msg || !pushSpool(*msg)) {
+            return;
         }
-        
-        Serial.print("📤 Intentando publicar en ");
-        Serial.print(topic);
-        Serial.print(" (");
-        Serial.print(messageLength);
-        Serial.println(" bytes)");
-        
-        // Procesar mensajes pendientes antes de publicar
-        if (mqttClient.loop()) {
-            Serial.println("🔄 Procesando mensaje pendiente...");
-            delay(10); // Pequeña pausa para procesar
+        outbound.popFrontTracked();
+    }
+}
+
+// Siempre a la cola en RAM; el desborde a flash lo hace spillToSpool(). Solo
+// si la cola está llena de respuestas se le pide lugar ahí mismo.
+bool NetworkManager::enqueue(PublishClass cls, const char* topic, const char* message,
+                             const uint8_t* correlation, uint8_t correlationLength) {
+    // Topic vacío: no entró en la TopicTable (unitId demasiado largo)
+    if (topic[0] == '\0') {
+        return false;
+    }
+    
+    unsigned long droppedBefore = outbound.getDropped();
+    if (outbound.push(cls, topic, message, correlation, correlationLength)) {
+        if (outbound.getDropped() != droppedBefore) {
+            LOG_WARN("⚠️ Cola de publicación llena, se descartó el mensaje más antiguo");
         }
-        
-        bool result = mqttClient.publish(topic, message, qos);
-        if (result) {
-            Serial.print("✅ Publicado (QoS ");
-            Serial.print(qos);
-            Serial.print(") en ");
-            Serial.print(topic);
-            Serial.print(": ");
-            Serial.println(message);
-        } else {
-            Serial.print("❌ Error publicando (QoS ");
-            Serial.print(qos);
-            Serial.print(") en ");
-            Serial.println(topic);
-            Serial.print("📊 Estado MQTT: ");
-            Serial.println(mqttClient.state());
-            Serial.print("📊 Buffer disponible: ");
-            Serial.println(mqttClient.getBufferSize());
-            Serial.print("📊 Mensaje pendiente: ");
-            Serial.println(mqttClient.loop() ? "Sí" : "No");
-            
-            // Intentar limpiar el buffer
-            Serial.println("🧹 Limpiando buffer MQTT...");
-            for (int i = 0; i < 5; i++) {
-                mqttClient.loop();
-                delay(10);
-            }
+        return true;
+    }
+    
+    // Solo falla si el mensaje no entra en un slot o la cola está llena de respuestas.
+    // Las respuestas nunca se descartan: se intenta el envío directo.
+    LOG_WARN("⚠️ No se pudo encolar publicación en %s", topic);
+    if (cls != PublishClass::Response) {
+        return false;
+    }
+    if (mqttClient.connected() && !holdTracked()) {
+        return publishNow(topic, (const uint8_t*)message, strlen(message), correlation, correlationLength);
+    }
+    spillToSpool();
+    return outbound.push(cls, topic, message, correlation, correlationLength);
+}
+
+bool NetworkManager::enqueueResponse(const char* message) {
+#ifdef OSMO_MQTT_V5
+    // Solo dentro del callback MQTT: UDP y la parada rápida contestan en el topic propio
+    const Mqtt5Request& request = mqttClient.currentRequest();
+    if (request.active) {
+        const char* topic = request.responseTopic[0] ? request.responseTopic : topicTable.get(Topic::Response);
+        return enqueue(PublishClass::Response, topic, message, request.correlation, request.correlationLength);
+    }
+#endif
+    return enqueue(PublishClass::Response, topicTable.get(Topic::Response), message);
+}
+
+String NetworkManager::requestCorrelation() const {
+    String correlation;
+#ifdef OSMO_MQTT_V5
+    const Mqtt5Request& request = mqttClient.currentRequest();
+    if (request.active) {
+        for (uint8_t i = 0; i < request.correlationLength; i++) {
+            correlation += (char)request.correlation[i];
         }
-        return result;
     }
-    Serial.println("❌ MQTT no conectado para publicar");
-    Serial.print("📊 Estado MQTT: ");
-    Serial.println(mqttClient.state());
+#endif
+    return correlation;
+}
+
+bool NetworkManager::requestExpired() const {
+#ifdef OSMO_MQTT_V5
+    return mqttClient.requestExpired();
+#else
     return false;
+#endif
 }
 
-void NetworkManager::publishError(const char* errorType, const char* message) {
-    char topic[100];
-    sprintf(topic, "motete/osmo/%s/errors", deviceConfig.unitId);
+bool NetworkManager::publishJson(PublishClass cls, const char* topic, const JsonDocument& doc) {
+    if (topic[0] == '\0') {
+        return false;
+    }
+    size_t length = measureJson(doc);
     
+    if (state == ConnectionState::MqttConnected && mqttClient.connected()) {
+        // Lo encolado antes sale primero. Si queda algo pendiente, lo que entra
+        // en un slot se encola detrás; solo un documento más grande que un slot
+        // se adelanta a la cola.
+        drainQueue();
+        if (!outbound.front(holdTracked()) || length >= PublishQueueLimits::PAYLOAD_MAX) {
+            if (streamJson(topic, doc, length)) {
+                outbound.discard(cls, topic);
+                // Un keyframe ya enviado deja viejos los deltas que esperaban
+                if (cls == PublishClass::Status) {
+                    while (outbound.discard(PublishClass::StatusDelta, topic)) {
+                    }
+                }
+                return true;
+            }
+            LOG_ERROR("❌ Error publicando en %s (%u bytes), rc=%d", topic, (unsigned)length, mqttClient.state());
+        }
+    }
+    
+    if (length >= PublishQueueLimits::PAYLOAD_MAX) {
+        // El próximo intervalo lo reemplaza: no vale la pena reservar RAM para guardarlo
+        LOG_WARN("⚠️ %s de %u bytes no entra en la cola sin broker, se descarta", topic, (unsigned)length);
+        return false;
+    }
+    String json;
+    serializeJson(doc, json);
+    return enqueue(cls, topic, json.c_str());
+}
+
+bool NetworkManager::streamJson(const char* topic, const JsonDocument& doc, size_t length) {
+    bool ok = mqttClient.beginPublish(topic, length, false);
+    if (ok) {
+        ChunkedPublish out(mqttClient);
+        serializeJson(doc, out);
+        ok = out.flushChunk() && mqttClient.endPublish();
+    }
+    if (!ok) {
+        // Un paquete a medias deja el stream MQTT desalineado: se cierra el
+        // socket (sin DISCONNECT, que saldría pegado al resto) y loop() reconecta
+        transport.client().stop();
+    }
+    return countPublish(ok);
+}
+
+bool NetworkManager::publishNow(const QueuedMessage& msg) {
+    return publishNow(msg.topic, (const uint8_t*)msg.payload, msg.length, msg.correlation, msg.correlationLength);
+}
+
+bool NetworkManager::publishNow(const char* topic, const uint8_t* payload, unsigned int length,
+                                const uint8_t* correlation, uint8_t correlationLength) {
+    // Sin retained: el tercer parámetro de PubSubClient::publish es "retained", no QoS
+#ifdef OSMO_MQTT_V5
+    return countPublish(mqttClient.publish(topic, payload, length, false, correlation, correlationLength));
+#else
+    (void)correlation;
+    (void)correlationLength;
+    return countPublish(mqttClient.publish(topic, payload, length, false));
+#endif
+}
+
+// Envía hasta DRAIN_BUDGET mensajes por tick; ante un fallo se reintenta en el próximo.
+// Respuestas/eventos/configuración quedan en vuelo hasta el próximo loop() sano,
+// y mientras el spool tenga algo esperan: son más nuevos que lo de flash.
+void NetworkManager::drainQueue() {
+    bool untrackedOnly = holdTracked();
+    for (uint8_t sent = 0; sent < DRAIN_BUDGET; sent++) {
+        const QueuedMessage* msg = outbound.front(untrackedOnly);
+        if (!msg) {
+            return;
+        }
+        if (!publishNow(*msg)) {
+            LOG_ERROR("❌ Error publicando en %s, rc=%d", msg->topic, mqttClient.state());
+            return;
+        }
+        outbound.markSent(millis(), untrackedOnly);
+    }
+}
+
+// Envía el primero del spool, uno por intervalo. Lo de flash es más viejo que
+// las respuestas/eventos/configuración en RAM (drainQueue los retiene), así que
+// el historial llega en orden. El registro sigue en flash hasta releaseSpool().
+void NetworkManager::flushSpool() {
+    if (spool.size() == 0 || spoolInFlight) {
+        return;
+    }
+    if ((long)(millis() - nextSpoolFlush) < 0) {
+        return;
+    }
+    nextSpoolFlush = millis() + SPOOL_FLUSH_INTERVAL;
+    
+    const QueuedMessage* msg = spool.front();
+    if (!msg) {
+        // Registro ilegible: se saltea para no trabar la cola detrás
+        LOG_ERROR("❌ Registro del spool ilegible, se descarta");
+        spool.popFront();
+        return;
+    }
+    if (!publishNow(*msg)) {
+        LOG_ERROR("❌ Error publicando desde spool en %s, rc=%d", msg->topic, mqttClient.state());
+        return;
+    }
+    spoolInFlight = true;
+    spoolDroppedAtSend = spool.getDropped();
+}
+
+// Un loop() sano después del envío: el primero del spool se da por entregado
+void NetworkManager::releaseSpool() {
+    if (!spoolInFlight) {
+        return;
+    }
+    spoolInFlight = false;
+    // Si el anillo se llenó mientras tanto, el enviado ya fue sobrescrito: el
+    // primero ahora es otro y se envía (a lo sumo un repetido, nunca una pérdida)
+    if (spool.getDropped() != spoolDroppedAtSend) {
+        return;
+    }
+    spool.popFront();
+    if (spool.size() == 0) {
+        LOG_INFO("📼 Spool offline vaciado");
+    }
+}
+
+// Eventos de historial (encendido/apagado de bombas, paradas): se guardan sin broker
+void NetworkManager::publishEvent(const char* event, int pumpId) {
+    String eventJSON = createEventJSON(event, pumpId);
+    enqueue(PublishClass::Event, topicTable.get(Topic::Events), eventJSON.c_str());
+}
+
+// Pide al director los comandos [from, to] de un topic; los reenvía con el mismo seq
+void NetworkManager::publishNack(const char* sourceTopic, uint32_t from, uint32_t to) {
+    StaticJsonDocument<192> doc;
+    doc["topic"] = sourceTopic;
+    doc["from"] = from;
+    doc["to"] = to;
+    
+    String nackJSON;
+    serializeJson(doc, nackJSON);
+    enqueue(PublishClass::Event, topicTable.get(Topic::Nack), nackJSON.c_str());
+}
+
+void NetworkManager::publishError(const char* errorType, const char* message) {
     StaticJsonDocument<256> doc;
     doc["timestamp"] = millis();
     doc["error_type"] = errorType;
@@ -175,24 +689,19 @@ void NetworkManager::publishError(const char* errorType, const char* message) {
     String errorJSON;
     serializeJson(doc, errorJSON);
     
-    publishWithQoS(topic, errorJSON.c_str(), 1);
+    enqueue(PublishClass::Event, topicTable.get(Topic::Errors), errorJSON.c_str());
 }
 
 bool NetworkManager::testConnection() {
     if (mqttClient.connected()) {
         // Publicar mensaje de test
-        char topic[50];
-        sprintf(topic, "motete/osmo/%s/test", deviceConfig.unitId);
-        return publish(topic, "test_message");
+        return publish(topicTable.get(Topic::Test), "test_message");
     }
     return false;
 }
 
 void NetworkManager::sendHeartbeat() {
     if (mqttClient.connected()) {
-        char topic[50];
-        sprintf(topic, "motete/osmo/%s/heartbeat", deviceConfig.unitId);
-        
         StaticJsonDocument<128> doc;
         doc["timestamp"] = millis();
         doc["unit_id"] = deviceConfig.unitId;
@@ -201,7 +710,7 @@ void NetworkManager::sendHeartbeat() {
         String heartbeatJSON;
         serializeJson(doc, heartbeatJSON);
         
-        publishWithQoS(topic, heartbeatJSON.c_str(), 0); // QoS 0 para heartbeat
+        enqueue(PublishClass::Heartbeat, topicTable.get(Topic::Heartbeat), heartbeatJSON.c_str());
     }
 }
 //inicialización de callback
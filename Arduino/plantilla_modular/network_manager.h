@@ -2,31 +2,116 @@
 #define NETWORK_MANAGER_H
 
 #include <ESP8266WiFi.h>
+#include <ArduinoJson.h>
+#ifdef OSMO_MQTT_V5
+#include "mqtt5_client.h"
+typedef Mqtt5Client MqttClient;   // Alias de topic, response topic y correlation data
+#else
 #include <PubSubClient.h>
+typedef PubSubClient MqttClient;
+#endif
 #include "config.h"
+#include "transport.h"
+#include "reconnect_backoff.h"
+#include "publish_queue.h"
+#include "offline_spool.h"
+#include "topic_table.h"
+#include "wifi_cache.h"
+#include "broker_discovery.h"
+#include "tcp_probe.h"
+#include "broker_pool.h"
 
-
+// Estados de la conexión: loop() avanza como máximo un paso por iteración
+enum class ConnectionState {
+    WiFiIdle,        // Falta llamar a WiFi.begin
+    WiFiConnecting,  // Esperando WL_CONNECTED
+    MqttWaiting,     // WiFi listo, esperando el próximo intento MQTT
+    MqttConnected    // Operativo (MQTT_CONNECTED ya es macro de PubSubClient)
+};
 
 class NetworkManager {
 private:
-    WiFiClient espClient;
-    PubSubClient mqttClient;
+    ITransport& transport;          // Socket bajo MQTT (WiFiClient, BearSSL o POSIX)
+    MqttClient mqttClient;
     bool isConnected;
+    ConnectionState state;
+    unsigned long stateSince;       // millis() al entrar al estado actual
+    unsigned long nextMQTTAttempt;  // millis() del próximo intento MQTT
+    ReconnectBackoff backoff;       // Espera entre intentos MQTT
+    PublishQueue outbound;          // Publicaciones pendientes, se vacían en loop()
+    OfflineSpool spool;             // Desborde en flash mientras no hay broker
+    unsigned long nextSpoolFlush;   // millis() del próximo envío desde el spool
+    bool spoolInFlight;             // El primero del spool salió; se borra en el próximo loop() sano
+    unsigned long spoolDroppedAtSend;  // getDropped() del spool al enviarlo
+    WiFiCache wifiCache;            // Último AP bueno en RTC para reconexión directa
+    bool wifiDirected;              // El intento en curso usa BSSID/canal de la caché
+    BrokerDiscovery broker;         // Dirección del primario: caché, config o mDNS
+    BrokerPool pool;                // Primario y respaldos con su salud
+    TcpProbe primaryProbe;          // Connect en curso al primario mientras se usa un respaldo
+    unsigned long connects;         // Conexiones MQTT logradas desde el arranque
+    unsigned long publishAttempts;  // Publicaciones intentadas (cola, streaming y directas)
+    unsigned long publishFailures;  // ...y las que el cliente rechazó
     
-    void setupWiFi();
-    void setupMQTT();
+    void setState(ConnectionState newState);
+    void startWiFi();
+    void pollWiFi();
+    void rememberAccessPoint();
+    void attemptMQTT();
+    void scheduleRetry();
+    void publishPresence();
+    void applyBroker();
+    void probePrimary();
+    void announce();
+    void subscribeTopics();
+    void drainQueue();
+    void flushSpool();
+    void spillToSpool();
+    void releaseSpool();
+    // Con backlog en flash, respuestas/eventos/configuración en RAM esperan detrás
+    bool holdTracked() { return spool.size() > 0; }
+    bool pushSpool(const QueuedMessage& msg);
+    bool publishNow(const QueuedMessage& msg);
+    bool publishNow(const char* topic, const uint8_t* payload, unsigned int length,
+                    const uint8_t* correlation, uint8_t correlationLength);
+    bool streamJson(const char* topic, const JsonDocument& doc, size_t length);
+    bool countPublish(bool ok);
     
 public:
-    NetworkManager();
+    explicit NetworkManager(ITransport& transport);
     bool connect();
     bool isMQTTConnected();
+    void disconnect();  // Cierre ordenado: "offline" retenido sin esperar la Last Will
+    ConnectionState getState() const { return state; }
+    static const char* stateName(ConnectionState s);
     void loop();
     bool publish(const char* topic, const char* message);
     bool subscribe(const char* topic);
     void setCallback(void (*callback)(char*, uint8_t*, unsigned int));
 
-    bool publishWithQoS(const char* topic, const char* message, int qos = 1);
+    // Encola sin bloquear; el envío ocurre en el próximo tick de red
+    bool enqueue(PublishClass cls, const char* topic, const char* message,
+                 const uint8_t* correlation = nullptr, uint8_t correlationLength = 0);
+    // Estado/estadísticas: serializados directo al socket, sin String ni copia en
+    // el buffer MQTT, después de vaciar la cola; con la cola trabada o sin broker
+    // se encolan como texto si entran en un slot
+    bool publishJson(PublishClass cls, const char* topic, const JsonDocument& doc);
+    // Respuesta al comando en curso: con MQTT 5 va al response topic y con su correlación
+    bool enqueueResponse(const char* message);
+    String requestCorrelation() const;  // Correlation data del comando en curso ("" si no hay)
+    bool requestExpired() const;        // MQTT 5: el comando en curso venció antes de procesarse
+    uint8_t getQueueSize() const { return outbound.size(); }
+    unsigned long getQueueDropped() const { return outbound.getDropped(); }
+    uint16_t getSpoolSize() const { return spool.size(); }
+    uint8_t getInFlightCount() const { return outbound.inFlightCount(); }
+    // Host del broker primario (caché, config o mDNS): ahí también corren el
+    // reloj y el syslog del director. Sin asignar si server es un nombre sin resolver
+    IPAddress getDirectorIP() const { return broker.getIP(); }
+    unsigned long getReconnects() const { return connects > 0 ? connects - 1 : 0; }
+    unsigned long getPublishAttempts() const { return publishAttempts; }
+    unsigned long getPublishFailures() const { return publishFailures; }
     void publishError(const char* errorType, const char* message);
+    void publishEvent(const char* event, int pumpId = -1);
+    void publishNack(const char* sourceTopic, uint32_t from, uint32_t to);
     bool testConnection();
     void sendHeartbeat();
 };
@@ -0,0 +1,145 @@
+#include "offline_spool.h"
+#include "log.h"
+#include <LittleFS.h>
+
+namespace {
+    const char* SPOOL_PATH = "/spool.bin";
+    // La firma cambia si cambia el formato del registro
+    const uint32_t SPOOL_MAGIC = 0x53504F4CUL ^ sizeof(QueuedMessage);
+}
+
+OfflineSpool::OfflineSpool() : ready(false), recordLoaded(false), dropped(0) {
+    header.magic = SPOOL_MAGIC;
+    header.head = 0;
+    header.count = 0;
+}
+
+bool OfflineSpool::begin() {
+    if (!LittleFS.begin()) {
+        LOG_ERROR("❌ LittleFS no disponible, mensajes offline solo en RAM");
+        return false;
+    }
+    ready = true;
+    
+    // Recuperar lo pendiente de una sesión anterior
+    File file = LittleFS.open(SPOOL_PATH, "r");
+    if (file) {
+        Header stored;
+        bool valid = file.read((uint8_t*)&stored, sizeof(stored)) == sizeof(stored) &&
+                     stored.magic == SPOOL_MAGIC &&
+                     stored.head < CAPACITY && stored.count <= CAPACITY;
+        file.close();
+        if (valid) {
+            header = stored;
+            LOG_INFO("📼 Spool offline con %u mensajes pendientes", header.count);
+            return true;
+        }
+    }
+    
+    // Archivo nuevo o con formato viejo: empezar vacío
+    file = LittleFS.open(SPOOL_PATH, "w");
+    if (!file) {
+        ready = false;
+        return false;
+    }
+    file.close();
+    header.magic = SPOOL_MAGIC;
+    header.head = 0;
+    header.count = 0;
+    return writeHeader();
+}
+
+bool OfflineSpool::writeHeader() {
+    File file = LittleFS.open(SPOOL_PATH, "r+");
+    if (!file) {
+        return false;
+    }
+    bool ok = file.write((const uint8_t*)&header, sizeof(header)) == sizeof(header);
+    file.close();
+    return ok;
+}
+
+bool OfflineSpool::writeRecord(uint16_t index) {
+    File file = LittleFS.open(SPOOL_PATH, "r+");
+    if (!file) {
+        return false;
+    }
+    // Los registros se escriben en orden, así que la posición nunca supera el final del archivo
+    bool ok = file.seek(sizeof(Header) + (uint32_t)index * sizeof(QueuedMessage)) &&
+              file.write((const uint8_t*)&record, sizeof(record)) == sizeof(record);
+    file.close();
+    return ok;
+}
+
+bool OfflineSpool::readRecord(uint16_t index) {
+    File file = LittleFS.open(SPOOL_PATH, "r");
+    if (!file) {
+        return false;
+    }
+    bool ok = file.seek(sizeof(Header) + (uint32_t)index * sizeof(QueuedMessage)) &&
+              file.read((uint8_t*)&record, sizeof(record)) == sizeof(record);
+    file.close();
+    return ok;
+}
+
+bool OfflineSpool::push(PublishClass cls, const char* topic, const char* payload,
+                        const uint8_t* correlation, uint8_t correlationLength) {
+    if (!ready) {
+        return false;
+    }
+    size_t topicLength = strlen(topic);
+    size_t payloadLength = strlen(payload);
+    if (topicLength >= PublishQueueLimits::TOPIC_MAX || payloadLength >= PublishQueueLimits::PAYLOAD_MAX ||
+        correlationLength > PublishQueueLimits::CORRELATION_MAX) {
+        return false;
+    }
+    
+    record.used = true;
+    record.inFlight = false;
+    record.cls = cls;
+    record.seq = 0;
+    record.sentAt = 0;
+    record.length = payloadLength;
+    record.correlationLength = correlationLength;
+    memcpy(record.correlation, correlation, correlationLength);
+    memcpy(record.topic, topic, topicLength + 1);
+    memcpy(record.payload, payload, payloadLength + 1);
+    recordLoaded = false;
+    
+    uint16_t tail = (header.head + header.count) % CAPACITY;
+    if (!writeRecord(tail)) {
+        return false;
+    }
+    
+    if (header.count < CAPACITY) {
+        header.count++;
+    } else {
+        // Anillo lleno: se pierde el más antiguo
+        header.head = (header.head + 1) % CAPACITY;
+        dropped++;
+    }
+    return writeHeader();
+}
+
+const QueuedMessage* OfflineSpool::front() {
+    if (!ready || header.count == 0) {
+        return nullptr;
+    }
+    if (!recordLoaded) {
+        if (!readRecord(header.head)) {
+            return nullptr;
+        }
+        recordLoaded = true;
+    }
+    return &record;
+}
+
+void OfflineSpool::popFront() {
+    if (header.count == 0) {
+        return;
+    }
+    header.head = (header.head + 1) % CAPACITY;
+    header.count--;
+    recordLoaded = false;
+    writeHeader();
+}
@@ -0,0 +1,43 @@
+#ifndef OFFLINE_SPOOL_H
+#define OFFLINE_SPOOL_H
+
+#include <Arduino.h>
+#include "publish_queue.h"
+
+// Anillo de mensajes en LittleFS para cuando el broker no está disponible.
+// Registros de tamaño fijo (un QueuedMessage) detrás de una cabecera con
+// head/count; si se llena se sobrescribe el más antiguo. Sobrevive a
+// reinicios: lo pendiente se envía en la próxima conexión.
+class OfflineSpool {
+private:
+    struct Header {
+        uint32_t magic;
+        uint16_t head;   // Índice del registro más antiguo
+        uint16_t count;  // Registros pendientes
+    };
+    
+    Header header;
+    QueuedMessage record;  // Buffer de lectura/escritura (estático, sin heap)
+    bool ready;
+    bool recordLoaded;     // record contiene el registro de head
+    unsigned long dropped;
+    
+    bool writeHeader();
+    bool writeRecord(uint16_t index);
+    bool readRecord(uint16_t index);
+    
+public:
+    static const uint16_t CAPACITY = 48;
+    
+    OfflineSpool();
+    bool begin();
+    bool push(PublishClass cls, const char* topic, const char* payload,
+              const uint8_t* correlation = nullptr, uint8_t correlationLength = 0);
+    const QueuedMessage* front();  // Más antiguo, nullptr si vacío
+    void popFront();
+    uint16_t size() const { return header.count; }
+    bool isReady() const { return ready; }
+    unsigned long getDropped() const { return dropped; }
+};
+
+#endif
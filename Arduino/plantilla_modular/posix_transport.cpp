@@ -0,0 +1,178 @@
+#include "posix_transport.h"
+
+#ifdef OSMO_HOST_BUILD
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+
+PosixClient::PosixClient() : fd(-1), peeked(-1), timeoutMs(2000) {
+}
+
+PosixClient::~PosixClient() {
+    stop();
+}
+
+// connect no bloqueante con timeout; el socket queda en modo no bloqueante
+int PosixClient::connectAddress(const void* addr, unsigned int addrLength, int family) {
+    stop();
+    fd = socket(family, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return 0;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    
+    if (::connect(fd, (const struct sockaddr*)addr, addrLength) < 0) {
+        if (errno != EINPROGRESS) {
+            stop();
+            return 0;
+        }
+        struct pollfd pfd = { fd, POLLOUT, 0 };
+        int error = 0;
+        socklen_t errorLength = sizeof(error);
+        if (poll(&pfd, 1, (int)timeoutMs) <= 0 ||
+            getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &errorLength) < 0 || error != 0) {
+            stop();
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int PosixClient::connect(IPAddress ip, uint16_t port) {
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    // IPAddress guarda el primer octeto en el byte bajo: ya es orden de red
+    addr.sin_addr.s_addr = (uint32_t)ip;
+    return connectAddress(&addr, sizeof(addr), AF_INET);
+}
+
+int PosixClient::connect(const char* host, uint16_t port) {
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    char service[8];
+    snprintf(service, sizeof(service), "%u", port);
+    
+    struct addrinfo* results = nullptr;
+    if (getaddrinfo(host, service, &hints, &results) != 0) {
+        return 0;
+    }
+    int ok = 0;
+    for (struct addrinfo* it = results; it && !ok; it = it->ai_next) {
+        ok = connectAddress(it->ai_addr, it->ai_addrlen, it->ai_family);
+    }
+    freeaddrinfo(results);
+    return ok;
+}
+
+size_t PosixClient::write(uint8_t b) {
+    return write(&b, 1);
+}
+
+// Escribe todo o nada dentro de timeoutMs (PubSubClient asume escritura completa)
+size_t PosixClient::write(const uint8_t* buf, size_t size) {
+    size_t sent = 0;
+    while (fd >= 0 && sent < size) {
+        ssize_t n = send(fd, buf + sent, size - sent, MSG_NOSIGNAL);
+        if (n > 0) {
+            sent += n;
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            struct pollfd pfd = { fd, POLLOUT, 0 };
+            if (poll(&pfd, 1, (int)timeoutMs) > 0) {
+                continue;
+            }
+        }
+        stop();
+        break;
+    }
+    return sent;
+}
+
+int PosixClient::available() {
+    if (fd < 0) {
+        return 0;
+    }
+    int pending = 0;
+    if (ioctl(fd, FIONREAD, &pending) < 0) {
+        return 0;
+    }
+    return pending + (peeked >= 0 ? 1 : 0);
+}
+
+int PosixClient::read() {
+    uint8_t b;
+    return read(&b, 1) == 1 ? b : -1;
+}
+
+int PosixClient::read(uint8_t* buf, size_t size) {
+    if (fd < 0 || size == 0) {
+        return -1;
+    }
+    size_t offset = 0;
+    if (peeked >= 0) {
+        buf[offset++] = (uint8_t)peeked;
+        peeked = -1;
+    }
+    if (offset < size) {
+        ssize_t n = recv(fd, buf + offset, size - offset, MSG_DONTWAIT);
+        if (n > 0) {
+            offset += n;
+        } else if (n == 0) {
+            stop();  // El broker cerró la conexión
+        }
+    }
+    return offset > 0 ? (int)offset : -1;
+}
+
+int PosixClient::peek() {
+    if (peeked < 0) {
+        uint8_t b;
+        if (fd >= 0 && recv(fd, &b, 1, MSG_DONTWAIT) == 1) {
+            peeked = b;
+        }
+    }
+    return peeked;
+}
+
+void PosixClient::stop() {
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+    peeked = -1;
+}
+
+uint8_t PosixClient::connected() {
+    if (fd < 0) {
+        return 0;
+    }
+    if (peeked >= 0) {
+        return 1;
+    }
+    // recv == 0 sin datos pendientes significa que el otro extremo cerró
+    uint8_t b;
+    ssize_t n = recv(fd, &b, 1, MSG_PEEK | MSG_DONTWAIT);
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+        stop();
+        return 0;
+    }
+    return 1;
+}
+
+#endif
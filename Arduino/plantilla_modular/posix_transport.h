@@ -0,0 +1,54 @@
+#ifndef POSIX_TRANSPORT_H
+#define POSIX_TRANSPORT_H
+
+#ifdef OSMO_HOST_BUILD
+
+#include "transport.h"
+
+// Client de Arduino sobre un socket TCP POSIX, base para correr NetworkManager
+// y PubSubClient en Linux. Todavía no hay build de host: el resto del sketch
+// depende del core ESP8266 (WiFi, LittleFS, user_interface.h).
+// Lecturas no bloqueantes (como WiFiClient); escrituras acotadas por timeout.
+class PosixClient : public Client {
+private:
+    int fd;
+    int peeked;  // Byte leído por peek(), -1 si no hay
+    unsigned long timeoutMs;
+    
+    int connectAddress(const void* addr, unsigned int addrLength, int family);
+    
+public:
+    PosixClient();
+    ~PosixClient();
+    void setTimeoutMs(unsigned long ms) { timeoutMs = ms; }
+    
+    int connect(IPAddress ip, uint16_t port) override;
+    int connect(const char* host, uint16_t port) override;
+    size_t write(uint8_t b) override;
+    size_t write(const uint8_t* buf, size_t size) override;
+    int available() override;
+    int read() override;
+    int read(uint8_t* buf, size_t size) override;
+    int peek() override;
+    void flush() override {}
+    void stop() override;
+    uint8_t connected() override;
+    operator bool() override { return fd >= 0; }
+};
+
+class PosixTcpTransport : public ITransport {
+private:
+    PosixClient socketClient;
+    
+public:
+    Client& client() override { return socketClient; }
+    void setConnectTimeout(unsigned long timeoutMs) override { socketClient.setTimeoutMs(timeoutMs); }
+    const char* name() const override { return "posix-tcp"; }
+};
+
+// Backend por defecto del build de host
+typedef PosixTcpTransport PlatformTransport;
+
+#endif
+
+#endif
@@ -0,0 +1,105 @@
+#include "power_profile.h"
+#include "config.h"
+#include "log.h"
+#include "clock_sync.h"
+#include <ESP8266WiFi.h>
+#include <user_interface.h>
+
+PowerManager powerManager;
+
+PowerManager::PowerManager()
+    : profile(PowerProfile::Show), source(PowerSource::Boot), applied(false),
+      lastWindow(-1), lastScheduleCheck(0), switches(0) {
+}
+
+void PowerManager::begin() {
+    PowerProfile initial = PowerProfile::Show;
+    if (!parse(powerConfig.bootProfile, initial)) {
+        LOG_WARN("⚠️ Perfil de energía inválido en config: %s, se usa show", powerConfig.bootProfile);
+    }
+    apply(initial, PowerSource::Boot);
+}
+
+void PowerManager::apply(PowerProfile next, PowerSource from) {
+    source = from;
+    if (applied && next == profile) {
+        return;
+    }
+
+    if (next == PowerProfile::Show) {
+        // Sin sleep el módem escucha todo el tiempo: nada espera al próximo beacon
+        WiFi.setSleepMode(WIFI_NONE_SLEEP);
+        system_update_cpu_freq(SYS_CPU_160MHZ);
+    } else {
+        // El listen interval (en beacons DTIM) se negocia al asociarse: rige desde la próxima conexión
+        WiFi.setSleepMode(WIFI_LIGHT_SLEEP, powerConfig.idleListenInterval);
+        system_update_cpu_freq(SYS_CPU_80MHZ);
+    }
+
+    if (applied) {
+        switches++;
+    }
+    applied = true;
+    profile = next;
+    LOG_INFO("⚡ Perfil de energía: %s (%s, CPU %d MHz)", name(profile), sourceName(source), ESP.getCpuFreqMHz());
+}
+
+int8_t PowerManager::inShowWindow() const {
+    uint64_t now = synced_time();
+    if (now == 0) {
+        return -1;
+    }
+    // synced_time() es UTC; la franja se escribe en hora local
+    long minute = (long)((now / 60000ULL) % 1440) + powerConfig.utcOffsetMinutes;
+    minute = ((minute % 1440) + 1440) % 1440;
+
+    if (powerConfig.showFrom <= powerConfig.showTo) {
+        return minute >= powerConfig.showFrom && minute < powerConfig.showTo;
+    }
+    // Franja que cruza la medianoche (p. ej. 20:00 a 02:00)
+    return minute >= powerConfig.showFrom || minute < powerConfig.showTo;
+}
+
+void PowerManager::loop() {
+    if (!powerConfig.scheduleEnabled) {
+        return;
+    }
+    if (millis() - lastScheduleCheck < SCHEDULE_CHECK_INTERVAL) {
+        return;
+    }
+    lastScheduleCheck = millis();
+
+    int8_t window = inShowWindow();
+    if (window < 0 || window == lastWindow) {
+        return;
+    }
+    lastWindow = window;
+    apply(window ? PowerProfile::Show : PowerProfile::Idle, PowerSource::Schedule);
+}
+
+const char* PowerManager::name(PowerProfile value) {
+    return value == PowerProfile::Show ? "show" : "idle";
+}
+
+const char* PowerManager::sourceName(PowerSource value) {
+    switch (value) {
+        case PowerSource::Schedule: return "schedule";
+        case PowerSource::Command: return "command";
+        default: return "boot";
+    }
+}
+
+bool PowerManager::parse(const char* text, PowerProfile& value) {
+    if (!text) {
+        return false;
+    }
+    if (strcmp(text, "show") == 0) {
+        value = PowerProfile::Show;
+        return true;
+    }
+    if (strcmp(text, "idle") == 0) {
+        value = PowerProfile::Idle;
+        return true;
+    }
+    return false;
+}
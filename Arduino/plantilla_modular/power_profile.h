@@ -0,0 +1,54 @@
+#ifndef POWER_PROFILE_H
+#define POWER_PROFILE_H
+
+#include <Arduino.h>
+
+// Perfil de energía/latencia de la radio y la CPU
+enum class PowerProfile : uint8_t {
+    Show,  // Sin sleep del módem, CPU a 160 MHz: recepción inmediata
+    Idle   // Light sleep entre beacons DTIM, CPU a 80 MHz: menos consumo y calor
+};
+
+// Quién fijó el perfil vigente (se reporta en stats)
+enum class PowerSource : uint8_t {
+    Boot,
+    Schedule,
+    Command
+};
+
+// Aplica el perfil y sigue el horario de función de PowerConfig. El horario
+// actúa por flancos (entrar o salir de la franja): un comando set_power_profile
+// manda hasta el próximo cambio de franja, no lo pisa el chequeo siguiente.
+class PowerManager {
+private:
+    static const unsigned long SCHEDULE_CHECK_INTERVAL = 10000;
+
+    PowerProfile profile;
+    PowerSource source;
+    bool applied;
+    int8_t lastWindow;                 // -1 = sin hora todavía, 0 fuera, 1 dentro de la franja
+    unsigned long lastScheduleCheck;
+    unsigned long switches;
+
+    void apply(PowerProfile next, PowerSource from);
+    int8_t inShowWindow() const;       // -1 si no hay reloj sincronizado
+
+public:
+    PowerManager();
+    void begin();
+    void loop();
+    void set(PowerProfile next) { apply(next, PowerSource::Command); }
+
+    PowerProfile get() const { return profile; }
+    PowerSource getSource() const { return source; }
+    unsigned long getSwitches() const { return switches; }
+
+    static const char* name(PowerProfile value);
+    static const char* sourceName(PowerSource value);
+    // false si text no es "show" ni "idle"
+    static bool parse(const char* text, PowerProfile& value);
+};
+
+extern PowerManager powerManager;
+
+#endif
@@ -0,0 +1,212 @@
+#include "publish_queue.h"
+
+PublishQueue::PublishQueue() : nextSeq(0), count(0), dropped(0) {
+    for (uint8_t i = 0; i < PublishQueueLimits::CAPACITY; i++) {
+        slots[i].used = false;
+        slots[i].inFlight = false;
+    }
+}
+
+bool PublishQueue::coalesces(PublishClass cls) {
+    return cls == PublishClass::Status || cls == PublishClass::Stats || cls == PublishClass::Heartbeat;
+}
+
+int PublishQueue::findFree() const {
+    for (uint8_t i = 0; i < PublishQueueLimits::CAPACITY; i++) {
+        if (!slots[i].used) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Respuestas, eventos y configuración equivalen a QoS 1: se reenvían si la conexión cae
+bool PublishQueue::tracksDelivery(PublishClass cls) {
+    return cls == PublishClass::Response || cls == PublishClass::Event || cls == PublishClass::Config;
+}
+
+int PublishQueue::findOldest(bool droppableOnly, bool pendingOnly, bool untrackedOnly) const {
+    int oldest = -1;
+    for (uint8_t i = 0; i < PublishQueueLimits::CAPACITY; i++) {
+        if (!slots[i].used) {
+            continue;
+        }
+        if (untrackedOnly && tracksDelivery(slots[i].cls)) {
+            continue;
+        }
+        if (pendingOnly && slots[i].inFlight) {
+            continue;
+        }
+        if (droppableOnly && slots[i].cls == PublishClass::Response) {
+            continue;
+        }
+        // Resta con signo: tolera el desborde de seq
+        if (oldest < 0 || (int32_t)(slots[i].seq - slots[oldest].seq) < 0) {
+            oldest = i;
+        }
+    }
+    return oldest;
+}
+
+int PublishQueue::findCoalescible(PublishClass cls, const char* topic) const {
+    for (uint8_t i = 0; i < PublishQueueLimits::CAPACITY; i++) {
+        if (slots[i].used && slots[i].cls == cls && strcmp(slots[i].topic, topic) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+bool PublishQueue::push(PublishClass cls, const char* topic, const char* payload,
+                        const uint8_t* correlation, uint8_t correlationLength) {
+    size_t topicLength = strlen(topic);
+    size_t payloadLength = strlen(payload);
+    if (topicLength >= PublishQueueLimits::TOPIC_MAX || payloadLength >= PublishQueueLimits::PAYLOAD_MAX ||
+        correlationLength > PublishQueueLimits::CORRELATION_MAX) {
+        return false;
+    }
+    
+    int index = -1;
+    bool reused = false;
+    
+    // Estado/estadísticas: el más nuevo reemplaza al pendiente, conservando su turno
+    if (coalesces(cls)) {
+        index = findCoalescible(cls, topic);
+        reused = index >= 0;
+    }
+    if (index < 0) {
+        index = findFree();
+    }
+    if (index < 0) {
+        // Cola llena: se descarta el más antiguo pendiente que no sea una respuesta.
+        // Lo que está en vuelo no se toca: ya salió y se libera en el próximo tick
+        index = findOldest(true, true);
+        if (index < 0) {
+            return false;  // Solo quedan respuestas o mensajes en vuelo
+        }
+        slots[index].used = false;
+        count--;
+        dropped++;
+    }
+    
+    QueuedMessage& slot = slots[index];
+    slot.cls = cls;
+    slot.length = payloadLength;
+    slot.correlationLength = correlationLength;
+    memcpy(slot.correlation, correlation, correlationLength);
+    memcpy(slot.topic, topic, topicLength + 1);
+    memcpy(slot.payload, payload, payloadLength + 1);
+    if (!reused) {
+        slot.used = true;
+        slot.inFlight = false;
+        slot.seq = nextSeq++;
+        count++;
+    }
+    return true;
+}
+
+// Estado/estadísticas enviados por otra vía: el pendiente encolado ya es viejo
+bool PublishQueue::discard(PublishClass cls, const char* topic) {
+    int index = findCoalescible(cls, topic);
+    if (index < 0 || slots[index].inFlight) {
+        return false;
+    }
+    slots[index].used = false;
+    count--;
+    return true;
+}
+
+int PublishQueue::findOldestTracked() const {
+    int oldest = -1;
+    for (uint8_t i = 0; i < PublishQueueLimits::CAPACITY; i++) {
+        if (!slots[i].used || slots[i].inFlight || !tracksDelivery(slots[i].cls)) {
+            continue;
+        }
+        if (oldest < 0 || (int32_t)(slots[i].seq - slots[oldest].seq) < 0) {
+            oldest = i;
+        }
+    }
+    return oldest;
+}
+
+const QueuedMessage* PublishQueue::frontTracked() const {
+    int index = findOldestTracked();
+    return index >= 0 ? &slots[index] : nullptr;
+}
+
+void PublishQueue::popFrontTracked() {
+    int index = findOldestTracked();
+    if (index >= 0) {
+        slots[index].used = false;
+        count--;
+    }
+}
+
+const QueuedMessage* PublishQueue::front(bool untrackedOnly) const {
+    int index = findOldest(false, true, untrackedOnly);
+    return index >= 0 ? &slots[index] : nullptr;
+}
+
+void PublishQueue::popFront() {
+    int index = findOldest(false, true);
+    if (index >= 0) {
+        slots[index].used = false;
+        count--;
+    }
+}
+
+void PublishQueue::markSent(unsigned long now, bool untrackedOnly) {
+    int index = findOldest(false, true, untrackedOnly);
+    if (index < 0) {
+        return;
+    }
+    if (tracksDelivery(slots[index].cls)) {
+        slots[index].inFlight = true;
+        slots[index].sentAt = now;
+    } else {
+        slots[index].used = false;
+        count--;
+    }
+}
+
+// Libera todo lo enviado: se llama cuando un loop() posterior al envío
+// confirma que la conexión sigue arriba
+uint8_t PublishQueue::releaseInFlight() {
+    uint8_t released = 0;
+    for (uint8_t i = 0; i < PublishQueueLimits::CAPACITY; i++) {
+        if (slots[i].used && slots[i].inFlight) {
+            slots[i].used = false;
+            count--;
+            released++;
+        }
+    }
+    return released;
+}
+
+uint8_t PublishQueue::requeueInFlight() {
+    uint8_t requeued = 0;
+    for (uint8_t i = 0; i < PublishQueueLimits::CAPACITY; i++) {
+        if (slots[i].used && slots[i].inFlight) {
+            slots[i].inFlight = false;
+            requeued++;
+        }
+    }
+    return requeued;
+}
+
+uint8_t PublishQueue::inFlightCount() const {
+    uint8_t inFlight = 0;
+    for (uint8_t i = 0; i < PublishQueueLimits::CAPACITY; i++) {
+        if (slots[i].used && slots[i].inFlight) {
+            inFlight++;
+        }
+    }
+    return inFlight;
+}
+
+void PublishQueue::clear() {
+    for (uint8_t i = 0; i < PublishQueueLimits::CAPACITY; i++) {
+        slots[i].used = false;
+    }
+    count = 0;
+}
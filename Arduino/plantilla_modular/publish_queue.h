@@ -0,0 +1,79 @@
+#ifndef PUBLISH_QUEUE_H
+#define PUBLISH_QUEUE_H
+
+#include <Arduino.h>
+
+// Clases de mensaje saliente, cada una con su política de descarte
+enum class PublishClass : uint8_t {
+    Response,   // Respuestas a comandos: nunca se descartan
+    Event,      // Errores y eventos: si no hay lugar se descarta el más antiguo
+    Config,     // Configuración inicial de bombas: igual que Event
+    Status,     // Estado periódico: el más nuevo reemplaza al encolado
+    Stats,      // Estadísticas: el más nuevo reemplaza al encolado
+    Heartbeat,  // Latido: el más nuevo reemplaza al encolado
+    StatusDelta // Delta de estado: no se reemplaza (cada uno lleva solo sus campos)
+};
+
+// Límites de la cola (almacenamiento estático, sin heap)
+namespace PublishQueueLimits {
+    const uint8_t CAPACITY = 8;
+    const uint16_t TOPIC_MAX = 64;
+    const uint16_t PAYLOAD_MAX = 640;
+    const uint8_t CORRELATION_MAX = 32;  // Correlation data de MQTT 5 (command_id del director)
+}
+
+struct QueuedMessage {
+    bool used;
+    bool inFlight;       // Enviado, esperando confirmación (ver releaseInFlight)
+    PublishClass cls;
+    uint32_t seq;        // Orden de llegada (FIFO)
+    unsigned long sentAt;
+    uint16_t length;
+    uint8_t correlationLength;  // 0 = sin correlation data (MQTT 3.1.1 o mensaje propio)
+    uint8_t correlation[PublishQueueLimits::CORRELATION_MAX];
+    char topic[PublishQueueLimits::TOPIC_MAX];
+    char payload[PublishQueueLimits::PAYLOAD_MAX];
+};
+
+// Cola de publicaciones de capacidad fija. push() es O(CAPACITY) con
+// CAPACITY constante, nunca bloquea ni toca la red; el vaciado ocurre
+// en el tick de red (NetworkManager::loop).
+class PublishQueue {
+private:
+    QueuedMessage slots[PublishQueueLimits::CAPACITY];
+    uint32_t nextSeq;
+    uint8_t count;
+    unsigned long dropped;
+    
+    static bool coalesces(PublishClass cls);
+    int findFree() const;
+    int findOldest(bool droppableOnly, bool pendingOnly, bool untrackedOnly = false) const;
+    int findOldestTracked() const;
+    int findCoalescible(PublishClass cls, const char* topic) const;
+    
+public:
+    PublishQueue();
+    bool push(PublishClass cls, const char* topic, const char* payload,
+              const uint8_t* correlation = nullptr, uint8_t correlationLength = 0);
+    static bool tracksDelivery(PublishClass cls);
+    
+    // Más antiguo sin enviar, nullptr si no hay. Con untrackedOnly solo estado,
+    // stats y latido: lo demás espera detrás del spool
+    const QueuedMessage* front(bool untrackedOnly = false) const;
+    void popFront();
+    // Más antiguo sin enviar de las clases con entrega garantizada (desborde a flash)
+    const QueuedMessage* frontTracked() const;
+    void popFrontTracked();
+    // Al enviar: las clases con entrega garantizada quedan en vuelo, el resto se libera
+    void markSent(unsigned long now, bool untrackedOnly = false);  // El mismo que front()
+    uint8_t releaseInFlight();
+    uint8_t requeueInFlight();  // Tras una desconexión: se reenvían en orden
+    bool discard(PublishClass cls, const char* topic);  // Quita el pendiente que quedó viejo
+    uint8_t inFlightCount() const;
+    void clear();
+    uint8_t size() const { return count; }
+    uint8_t freeSlots() const { return PublishQueueLimits::CAPACITY - count; }
+    unsigned long getDropped() const { return dropped; }
+};
+
+#endif
@@ -1,17 +1,20 @@
 #include "pump_controller.h"
 #include "network_manager.h"
 #include "command_definition.h"
+#include "log.h"
 #include <Arduino.h>
 #include <ArduinoJson.h>
 
 PumpController::PumpController(int count, NetworkManager* netMgr) 
-    : pumpCount(count), networkManager(netMgr), initialConfigSent(false) {
+    : outputMask(0), pumpCount(count), networkManager(netMgr), initialConfigSent(false) {
     pumpPins = new int[count];
     pumpStates = new bool[count];
     pumpLevels = new int[count];
     pumpActivationTimes = new int[count];
     pumpCooldownTimes = new int[count];
     pumpLastActivation = new unsigned long[count];
+    pumpRunStart = new unsigned long[count];
+    pumpStats = new PumpStatsData[count];
     
     for (int i = 0; i < count; i++) {
         pumpPins[i] = deviceConfig.pumpPins[i];  // Pines configurables
@@ -20,6 +23,13 @@ PumpController::PumpController(int count, NetworkManager* netMgr)
         pumpActivationTimes[i] = deviceConfig.pumpDefaults.activationTime;  // Usar configuración
         pumpCooldownTimes[i] = deviceConfig.pumpDefaults.cooldownTime;      // Usar configuración
         pumpLastActivation[i] = 0;      // Nunca activado
+        pumpRunStart[i] = 0;
+        pumpStats[i] = PumpStatsData{0, 0, 0, 0, 0};
+        
+        // GPIO16 no está en el registro GPOC, se apaga con digitalWrite
+        if (pumpPins[i] < 16) {
+            outputMask |= (1UL << pumpPins[i]);
+        }
     }
 }
 
@@ -31,6 +41,8 @@ PumpController::~PumpController() {
     delete[] pumpActivationTimes;
     delete[] pumpCooldownTimes;
     delete[] pumpLastActivation;
+    delete[] pumpRunStart;
+    delete[] pumpStats;
 }
 
 void PumpController::initialize() {
@@ -52,24 +64,63 @@ void PumpController::initialize() {
 
 void PumpController::setPumpState(int pumpId, bool state) {
     if (pumpId >= 0 && pumpId < pumpCount) {
+        bool wasActive = pumpStates[pumpId];
+        unsigned long now = millis();
         pumpStates[pumpId] = state;
 
         digitalWrite(pumpPins[pumpId], state ? HIGH : LOW);
         
         // Registrar timestamp de activación
         if (state) {
-            pumpLastActivation[pumpId] = millis();
+            pumpLastActivation[pumpId] = now;
+            pumpStats[pumpId].activations++;
+            // Una reactivación extiende la activación en curso
+            if (!wasActive) {
+                pumpRunStart[pumpId] = now;
+                publishPumpEvent("pump_on", pumpId);
+            }
+        } else if (wasActive) {
+            closeRun(pumpId, now);
+            publishPumpEvent("pump_off", pumpId);
         }
         
-        // Log para LEDs de prueba
-        Serial.print("💡 LED ");
-        Serial.print(pumpId);
-        Serial.print(" (pin ");
-        Serial.print(pumpPins[pumpId]);
-        Serial.print(") ");
-        Serial.print(state ? "ENCENDIDO" : "APAGADO");
-        Serial.print(" - Estado digital: ");
-        Serial.println(digitalRead(pumpPins[pumpId]));
+        // Log para LEDs de prueba (una línea, diferida)
+        LOG_DEBUG("💡 LED %d (pin %d) %s", pumpId, pumpPins[pumpId], state ? "ENCENDIDO" : "APAGADO");
+    }
+}
+
+// Historial de encendidos/apagados (se conserva aunque no haya broker)
+void PumpController::publishPumpEvent(const char* event, int pumpId) {
+    if (networkManager) {
+        networkManager->publishEvent(event, pumpId);
+    }
+}
+
+// Cerrar la activación continua y acumular tiempo encendida
+void PumpController::closeRun(int pumpId, unsigned long now) {
+    unsigned long run = now - pumpRunStart[pumpId];
+    pumpStats[pumpId].totalOnTime += run;
+    if (run > pumpStats[pumpId].longestRun) {
+        pumpStats[pumpId].longestRun = run;
+    }
+}
+
+// Parada de emergencia: se llama desde el callback MQTT, así que primero
+// se apagan las salidas y recién después se actualiza el estado. Sin logs.
+void PumpController::emergencyStopAll() {
+    GPOC = outputMask;  // Todas las bombas en GPIO 0-15 a LOW de una vez
+    for (int i = 0; i < pumpCount; i++) {
+        if (pumpPins[i] >= 16) {
+            digitalWrite(pumpPins[i], LOW);
+        }
+    }
+    
+    unsigned long now = millis();
+    for (int i = 0; i < pumpCount; i++) {
+        if (pumpStates[i]) {
+            pumpStates[i] = false;
+            closeRun(i, now);
+        }
     }
 }
 
@@ -102,7 +153,7 @@ void PumpController::updatePumps() {
             
             if (activationDuration >= pumpActivationTimes[i]) {
                 setPumpState(i, false);
-                Serial.printf("⏰ Bomba %d desactivada por tiempo (%lu ms)\n", i, activationDuration);
+                LOG_INFO("⏰ Bomba %d desactivada por tiempo (%lu ms)", i, activationDuration);
             }
         }
     }
@@ -126,7 +177,7 @@ void PumpController::setPumpConfig(int pumpId, int activationTime, int cooldownT
         pumpActivationTimes[pumpId] = activationTime;
         pumpCooldownTimes[pumpId] = cooldownTime;
         
-        Serial.printf("🔧 Bomba %d configurada - Activación: %d ms, Cooldown: %d ms\n", 
+        LOG_INFO("🔧 Bomba %d configurada - Activación: %d ms, Cooldown: %d ms", 
                      pumpId, activationTime, cooldownTime);
     }
 }
@@ -174,7 +225,7 @@ void PumpController::resetPumpConfig(int pumpId) {
         pumpCooldownTimes[pumpId] = 5000;    // 5 segundos por defecto
         pumpLastActivation[pumpId] = 0;      // Reset timestamp
         
-        Serial.printf("🔄 Configuración de bomba %d restablecida\n", pumpId);
+        LOG_INFO("🔄 Configuración de bomba %d restablecida", pumpId);
     }
 }
 
@@ -182,41 +233,40 @@ void PumpController::resetAllPumpConfigs() {
     for (int i = 0; i < pumpCount; i++) {
         resetPumpConfig(i);
     }
-    Serial.println("🔄 Todas las configuraciones de bombas restablecidas");
+    LOG_INFO("🔄 Todas las configuraciones de bombas restablecidas");
 }
 
 void PumpController::performInitialMQTTConfig() {
     if (initialConfigSent) {
-        Serial.println("⚠️ Configuración inicial MQTT ya enviada");
+        LOG_WARN("⚠️ Configuración inicial MQTT ya enviada");
         return;
     }
     
     if (!networkManager) {
-        Serial.println("❌ NetworkManager no disponible para configuración MQTT");
+        LOG_ERROR("❌ NetworkManager no disponible para configuración MQTT");
         return;
     }
     
     if (!networkManager->isMQTTConnected()) {
-        Serial.println("❌ MQTT no conectado, no se puede enviar configuración");
+        LOG_ERROR("❌ MQTT no conectado, no se puede enviar configuración");
         return;
     }
     
-    Serial.println("🔧 Enviando configuración inicial de bombas vía MQTT...");
-    Serial.printf("🔧 Valores por defecto: activación=%dms, cooldown=%dms\n", 
+    LOG_INFO("🔧 Enviando configuración inicial de bombas vía MQTT...");
+    LOG_INFO("🔧 Valores por defecto: activación=%dms, cooldown=%dms", 
                   deviceConfig.pumpDefaults.activationTime, 
                   deviceConfig.pumpDefaults.cooldownTime);
     
     // Enviar configuración para cada bomba
     for (int i = 0; i < pumpCount; i++) {
-        Serial.printf("🔧 Enviando configuración para bomba %d...\n", i);
+        LOG_INFO("🔧 Enviando configuración para bomba %d...", i);
         sendPumpConfigCommand(i, 
                             deviceConfig.pumpDefaults.activationTime, 
                             deviceConfig.pumpDefaults.cooldownTime);
-        delay(100); // Pequeña pausa entre comandos
     }
     
     initialConfigSent = true;
-    Serial.println("✅ Configuración inicial MQTT completada");
+    LOG_INFO("✅ Configuración inicial MQTT completada");
 }
 
 void PumpController::sendPumpConfigCommand(int pumpId, int activationTime, int cooldownTime) {
@@ -235,18 +285,26 @@ void PumpController::sendPumpConfigCommand(int pumpId, int activationTime, int c
     String commandJSON;
     serializeJson(doc, commandJSON);
     
-    // Crear topic de configuración
-    char topic[50];
-    sprintf(topic, "motete/osmo/%s/config", deviceConfig.unitId);
-    
-    Serial.printf("📤 Enviando configuración para bomba %d: activación=%dms, cooldown=%dms\n", 
+    LOG_INFO("📤 Enviando configuración para bomba %d: activación=%dms, cooldown=%dms", 
                   pumpId, activationTime, cooldownTime);
     
-    // Enviar comando (usar QoS 0 para evitar problemas de buffer)
-    if (networkManager->publishWithQoS(topic, commandJSON.c_str(), 0)) {
-        Serial.printf("✅ Comando de configuración enviado para bomba %d\n", pumpId);
+    // Encolar: se envía en el tick de red sin frenar la inicialización
+    if (networkManager->enqueue(PublishClass::Config, topicTable.get(Topic::Config), commandJSON.c_str())) {
+        LOG_INFO("✅ Comando de configuración encolado para bomba %d", pumpId);
     } else {
-        Serial.printf("❌ Error enviando configuración para bomba %d\n", pumpId);
+        LOG_ERROR("❌ Error enviando configuración para bomba %d", pumpId);
+    }
+}
+
+void PumpController::recordCooldownReject(int pumpId) {
+    if (pumpId >= 0 && pumpId < pumpCount) {
+        pumpStats[pumpId].cooldownRejects++;
+    }
+}
+
+void PumpController::recordForcedActivation(int pumpId) {
+    if (pumpId >= 0 && pumpId < pumpCount) {
+        pumpStats[pumpId].forcedActivations++;
     }
 }
 
@@ -256,5 +314,5 @@ bool PumpController::isInitialConfigSent() const {
 
 void PumpController::resetInitialConfig() {
     initialConfigSent = false;
-    Serial.println("🔄 Configuración inicial MQTT reiniciada");
+    LOG_INFO("🔄 Configuración inicial MQTT reiniciada");
 }
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include "config.h"
 #include <Arduino.h>
 #include "network_manager.h"
+#include "command_definition.h"
 class PumpController {
 private:
     int* pumpPins;        
@@ -12,12 +13,17 @@ private:
     int* pumpActivationTimes;  // Tiempo de activación por bomba
     int* pumpCooldownTimes;    // Tiempo de cooldown por bomba
     unsigned long* pumpLastActivation; // Última activación por bomba
+    unsigned long* pumpRunStart;       // Inicio de la activación continua en curso
+    PumpStatsData* pumpStats;          // Estadísticas de uso por bomba
+    uint32_t outputMask;               // Máscara GPIO 0-15 de todas las bombas
     int pumpCount;  // Número real de bombas
     NetworkManager* networkManager;  // Para enviar comandos MQTT
     bool initialConfigSent;  // Flag para configuración inicial
     
     // Método privado para enviar comandos de configuración
     void sendPumpConfigCommand(int pumpId, int activationTime, int cooldownTime);
+    void closeRun(int pumpId, unsigned long now);
+    void publishPumpEvent(const char* event, int pumpId);
     
 public:
     PumpController(int count, NetworkManager* netMgr = nullptr);  // Constructor con NetworkManager opcional
@@ -25,6 +31,7 @@ public:
     void initialize();
     void performInitialMQTTConfig();  // Configuración inicial vía MQTT
     void setPumpState(int pumpId, bool state);
+    void emergencyStopAll();  // Apaga todas las salidas en una escritura de registro
     bool getPumpState(int pumpId);
     void setPumpLevel(int pumpId, int level);
     int getPumpLevel(int pumpId);
@@ -42,6 +49,11 @@ public:
     void resetAllPumpConfigs();
     bool isInitialConfigSent() const;
     void resetInitialConfig();
+    
+    // Estadísticas de uso
+    void recordCooldownReject(int pumpId);
+    void recordForcedActivation(int pumpId);
+    const PumpStatsData* getAllPumpStats() const { return pumpStats; }
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,47 @@
+#include "reconnect_backoff.h"
+
+ReconnectBackoff::ReconnectBackoff(unsigned long base, unsigned long max)
+    : baseDelay(base), maxDelay(max), rngState(0x9E3779B9), attempts(0) {}
+
+void ReconnectBackoff::seed(uint32_t value) {
+    // Mezclar los bits del chip ID (24 bits) y evitar el estado 0
+    value ^= value << 13;
+    value ^= 0x9E3779B9;
+    rngState = value ? value : 0x9E3779B9;
+}
+
+uint32_t ReconnectBackoff::nextRandom() {
+    uint32_t x = rngState;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    rngState = x;
+    return x;
+}
+
+// "Equal jitter": mitad fija + mitad aleatoria, nunca reintenta de inmediato
+unsigned long ReconnectBackoff::jitter(unsigned long ceiling) {
+    unsigned long half = ceiling / 2;
+    return half + nextRandom() % (half + 1);
+}
+
+unsigned long ReconnectBackoff::initialDelay() {
+    // Tras un corte de energía todas las unidades arrancan juntas
+    return nextRandom() % (baseDelay + 1);
+}
+
+unsigned long ReconnectBackoff::nextDelay() {
+    uint8_t shift = attempts < 16 ? attempts : 16;
+    unsigned long ceiling = baseDelay << shift;
+    if (ceiling > maxDelay || ceiling < baseDelay) {
+        ceiling = maxDelay;
+    }
+    if (attempts < 255) {
+        attempts++;
+    }
+    return jitter(ceiling);
+}
+
+void ReconnectBackoff::reset() {
+    attempts = 0;
+}
@@ -0,0 +1,28 @@
+#ifndef RECONNECT_BACKOFF_H
+#define RECONNECT_BACKOFF_H
+
+#include <Arduino.h>
+
+// Backoff exponencial con jitter para reconexiones.
+// Cada unidad siembra su generador con el chip ID, así una flota que
+// pierde el broker a la vez no reintenta en el mismo instante.
+class ReconnectBackoff {
+private:
+    unsigned long baseDelay;  // ms del primer reintento
+    unsigned long maxDelay;   // ms máximo entre reintentos
+    uint32_t rngState;        // xorshift32, nunca 0
+    uint8_t attempts;         // reintentos fallidos consecutivos
+    
+    uint32_t nextRandom();
+    unsigned long jitter(unsigned long ceiling);
+    
+public:
+    ReconnectBackoff(unsigned long base, unsigned long max);
+    void seed(uint32_t value);
+    unsigned long initialDelay();  // Espera antes del primer intento
+    unsigned long nextDelay();     // Espera tras un intento fallido
+    void reset();                  // Llamar al conectar
+    uint8_t getAttempts() const { return attempts; }
+};
+
+#endif
@@ -1,14 +1,14 @@
 #include "status_publisher.h"
+#include "log.h"
 #include "pump_controller.h"
 #include "command_definition.h"
 
 StatusPublisher::StatusPublisher(PumpController* pumpCtrl, NetworkManager* netMgr) 
-    : pumpController(pumpCtrl), networkManager(netMgr) {}
-    
-String StatusPublisher::createStatusJSON() {
-    // Crear array de datos de bombas
-    PumpStatusData pumpData[deviceConfig.pumpCount];
+    : pumpController(pumpCtrl), networkManager(netMgr), primed(false), seq(0),
+      intervalsSinceKeyframe(0), lastInterval(0), lastDelta(0) {}
     
+// Llena pumpData (deviceConfig.pumpCount entradas) y arma el estado que apunta a él
+DeviceStatusData StatusPublisher::collectStatus(PumpStatusData* pumpData, bool includeStats) {
     // Recopilar datos de cada bomba
     for (int i = 0; i < deviceConfig.pumpCount; i++) {
         pumpData[i].active = pumpController->getPumpState(i);
@@ -17,13 +17,8 @@ String StatusPublisher::createStatusJSON() {
         pumpData[i].level = pumpController->getPumpLevel(i);
         
         // Debug: mostrar estado de cada bomba
-        Serial.print("🔍 Bomba ");
-        Serial.print(i);
-        Serial.print(": active=");
-        Serial.print(pumpData[i].active ? "true" : "false");
-        Serial.print(", available=");
-        Serial.print(pumpData[i].available ? "true" : "false");
-        
+        LOG_DEBUG("🔍 Bomba %d: active=%s, available=%s", i,
+                  pumpData[i].active ? "true" : "false", pumpData[i].available ? "true" : "false");
     }
     
     // Crear estructura de datos del dispositivo
@@ -31,22 +26,114 @@ String StatusPublisher::createStatusJSON() {
     statusData.unitId = deviceConfig.unitId;
     statusData.status = "ready";
     statusData.pumps = pumpData;
+    statusData.stats = includeStats ? pumpController->getAllPumpStats() : nullptr;
     statusData.pumpCount = deviceConfig.pumpCount;
     statusData.timestamp = millis();
-    
+    return statusData;
+}
+
+String StatusPublisher::createStatusJSON(bool includeStats) {
+    PumpStatusData pumpData[deviceConfig.pumpCount];
     // Usar la función de utilidad de command_definition
-    return ::createStatusJSON(statusData);
+    return ::createStatusJSON(collectStatus(pumpData, includeStats));
+}
+
+void StatusPublisher::loop() {
+    if (millis() - lastInterval > (unsigned long)deviceConfig.statusInterval) {
+        lastInterval = millis();
+        if (++intervalsSinceKeyframe >= deviceConfig.statusKeyframeEvery) {
+            publishStatus();
+            return;
+        }
+    }
+    
+    // Sin broker no hay deltas: la diferencia con lastSent se sigue acumulando
+    if (!networkManager->isMQTTConnected()) {
+        primed = false;
+        return;
+    }
+    // Conexión nueva: lo publicado antes pudo no llegar, se empieza de un keyframe
+    if (!primed) {
+        publishStatus();
+        return;
+    }
+    if (millis() - lastDelta < DELTA_MIN_GAP) {
+        return;
+    }
+    
+    PumpStatusData pumpData[deviceConfig.pumpCount];
+    DeviceStatusData statusData = collectStatus(pumpData, false);
+    uint32_t fields = dirtyFields(pumpData);
+    if (fields == 0) {
+        return;
+    }
+    lastDelta = millis();
+    if (!send(statusData, fields, false)) {
+        // Un delta perdido deja al director con un estado viejo
+        primed = false;
+    }
+}
+
+void StatusPublisher::publishStatus(bool includeStats) {
+    PumpStatusData pumpData[deviceConfig.pumpCount];
+    DeviceStatusData statusData = collectStatus(pumpData, includeStats);
+    intervalsSinceKeyframe = 0;
+    // Sin broker queda encolado (el más nuevo reemplaza al anterior) y se repite al conectar
+    bool ok = send(statusData, StatusFields::ALL, true);
+    primed = ok && networkManager->isMQTTConnected();
+    if (ok) {
+        LOG_INFO("✅ Estado publicado correctamente");
+    } else {
+        LOG_ERROR("❌ Error al publicar estado");
+    }
 }
 
-void StatusPublisher::publishStatus() {
-    String statusJSON = createStatusJSON();
-    char topic[50];
-    sprintf(topic, "motete/osmo/%s/status", deviceConfig.unitId);
+// Bits de los campos que difieren de lo último publicado
+uint32_t StatusPublisher::dirtyFields(const PumpStatusData* pumpData) const {
+    uint32_t fields = 0;
+    int count = min(deviceConfig.pumpCount, (int)StatusFields::MAX_PUMPS);
+    for (int i = 0; i < count; i++) {
+        if (pumpData[i].active != lastSent[i].active) {
+            fields |= StatusFields::pumpActive(i);
+        }
+        if (pumpData[i].available != lastSent[i].available) {
+            fields |= StatusFields::pumpAvailable(i);
+        }
+    }
+    return fields;
+}
+
+bool StatusPublisher::send(const DeviceStatusData& statusData, uint32_t fields, bool keyframe) {
+    DynamicJsonDocument doc(statusJSONCapacity(statusData.pumpCount, statusData.stats != nullptr));
+    buildStatusJSON(statusData, doc, fields);
+    doc["seq"] = ++seq;
+    doc["keyframe"] = keyframe;
+    // Directo al socket si hay broker. Un delta encolado no puede reemplazar a
+    // otro (lastSent ya cuenta con los campos del primero): va en su propia clase
+    PublishClass cls = keyframe ? PublishClass::Status : PublishClass::StatusDelta;
+    if (!networkManager->publishJson(cls, topicTable.get(Topic::Status), doc)) {
+        return false;
+    }
     
-    // Publicar con QoS 1 para garantizar entrega
-    if (networkManager->publishWithQoS(topic, statusJSON.c_str(), 1)) {
-        Serial.println("✅ Estado publicado correctamente");
+    int count = min(statusData.pumpCount, (int)StatusFields::MAX_PUMPS);
+    for (int i = 0; i < count; i++) {
+        if (fields & StatusFields::pumpActive(i)) {
+            lastSent[i].active = statusData.pumps[i].active;
+        }
+        if (fields & StatusFields::pumpAvailable(i)) {
+            lastSent[i].available = statusData.pumps[i].available;
+        }
+    }
+    return true;
+}
+
+void StatusPublisher::publishStats() {
+    DynamicJsonDocument doc(statsJSONCapacity(pumpController->getPumpCount()));
+    buildStatsJSON(deviceConfig.unitId, pumpController->getAllPumpStats(), pumpController->getPumpCount(), doc);
+    // Contadores acumulados: basta con el más nuevo
+    if (networkManager->publishJson(PublishClass::Stats, topicTable.get(Topic::Stats), doc)) {
+        LOG_INFO("✅ Estadísticas publicadas correctamente");
     } else {
-        Serial.println("❌ Error al publicar estado");
+        LOG_ERROR("❌ Error al publicar estadísticas");
     }
 }
\ No newline at end of file
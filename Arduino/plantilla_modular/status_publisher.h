@@ -4,19 +4,39 @@
 #include <ArduinoJson.h>
 #include "config.h"
 #include "network_manager.h"
+#include "command_definition.h"
 
 // Forward declaration para evitar dependencias circulares
 class PumpController;
 
+// Estado por deltas: loop() compara cada bomba con lo último publicado y los
+// campos distintos (bitmap de StatusFields) salen al instante y solos. Cada
+// statusKeyframeEvery intervalos, al (re)conectar y ante get_status sale el
+// estado completo (keyframe). "seq" crece en cada publicación: un hueco en los
+// deltas le indica al director que pida un keyframe.
 class StatusPublisher {
 private:
+    static const unsigned long DELTA_MIN_GAP = 50;  // ms: cambios más seguidos salen juntos
+    
     PumpController* pumpController;
     NetworkManager* networkManager;
+    PumpStatusData lastSent[StatusFields::MAX_PUMPS];  // Lo que el director ya tiene
+    bool primed;                     // Hubo keyframe en esta conexión: los deltas tienen base
+    uint32_t seq;
+    int intervalsSinceKeyframe;
+    unsigned long lastInterval;
+    unsigned long lastDelta;
+    
+    DeviceStatusData collectStatus(PumpStatusData* pumpData, bool includeStats);
+    uint32_t dirtyFields(const PumpStatusData* pumpData) const;
+    bool send(const DeviceStatusData& statusData, uint32_t fields, bool keyframe);
     
 public:
     StatusPublisher(PumpController* pumpCtrl, NetworkManager* netMgr);
-    void publishStatus();
-    String createStatusJSON();
+    void loop();
+    void publishStatus(bool includeStats = false);  // Siempre keyframe
+    void publishStats();
+    String createStatusJSON(bool includeStats = false);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,241 @@
+#include "tcp_probe.h"
+
+#ifdef OSMO_HOST_BUILD
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+TcpProbe::TcpProbe()
+    : result(Result::Idle), startedAt(0), timeoutMs(0), latencyMs(0), port(0), fd(-1) {
+}
+
+TcpProbe::~TcpProbe() {
+    abort();
+}
+
+void TcpProbe::abort() {
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+}
+
+// En el host el DNS bloquea: solo se usa para pruebas de carga
+bool TcpProbe::start(const char* host, uint16_t port, unsigned long timeoutMs) {
+    struct addrinfo hints;
+    struct addrinfo* found = nullptr;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host, nullptr, &hints, &found) != 0 || !found) {
+        result = Result::Down;
+        return false;
+    }
+    IPAddress ip((uint32_t)((struct sockaddr_in*)found->ai_addr)->sin_addr.s_addr);
+    freeaddrinfo(found);
+    return start(ip, port, timeoutMs);
+}
+
+bool TcpProbe::start(const IPAddress& ip, uint16_t port, unsigned long timeoutMs) {
+    if (isBusy()) {
+        return false;
+    }
+    this->port = port;
+    this->timeoutMs = timeoutMs;
+    startedAt = millis();
+    result = Result::Pending;
+
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        result = Result::Down;
+        return false;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = (uint32_t)ip;
+    if (::connect(fd, (const struct sockaddr*)&addr, sizeof(addr)) == 0) {
+        abort();
+        latencyMs = millis() - startedAt;
+        result = Result::Up;
+    } else if (errno != EINPROGRESS) {
+        abort();
+        result = Result::Down;
+        return false;
+    }
+    return true;
+}
+
+TcpProbe::Result TcpProbe::poll() {
+    if (result == Result::Pending && fd >= 0) {
+        struct pollfd pfd = { fd, POLLOUT, 0 };
+        if (::poll(&pfd, 1, 0) > 0) {
+            int error = 0;
+            socklen_t errorLength = sizeof(error);
+            bool ok = getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &errorLength) == 0 && error == 0;
+            abort();
+            latencyMs = millis() - startedAt;
+            result = ok ? Result::Up : Result::Down;
+        }
+    }
+    if (result == Result::Pending && millis() - startedAt >= timeoutMs) {
+        abort();
+        latencyMs = millis() - startedAt;
+        result = Result::Down;
+    }
+    if (result == Result::Up || result == Result::Down) {
+        Result done = result;
+        result = Result::Idle;
+        return done;
+    }
+    return result;
+}
+
+#else
+
+#include <lwip/tcp.h>
+#include <lwip/dns.h>
+
+// Los callbacks de lwIP corren en la tarea del sistema, entre vueltas de
+// loop(): no hay concurrencia real con poll()
+struct TcpProbeCallbacks {
+    static void dnsFound(const char* name, const ip_addr_t* ipaddr, void* arg) {
+        (void)name;
+        TcpProbe* self = (TcpProbe*)arg;
+        if (!self->resolving) {
+            return;  // Respuesta de un sondeo que ya venció
+        }
+        self->resolving = false;
+        if (!ipaddr) {
+            self->finish(TcpProbe::Result::Down);
+            return;
+        }
+        self->connectTo(IPAddress(*ipaddr));
+    }
+
+    static err_t connected(void* arg, tcp_pcb* pcb, err_t err) {
+        (void)err;
+        TcpProbe* self = (TcpProbe*)arg;
+        tcp_arg(pcb, nullptr);
+        tcp_err(pcb, nullptr);
+        self->pcb = nullptr;
+        self->finish(TcpProbe::Result::Up);
+        if (tcp_close(pcb) != ERR_OK) {
+            tcp_abort(pcb);
+            return ERR_ABRT;
+        }
+        return ERR_OK;
+    }
+
+    // lwIP ya liberó el pcb (RST, sin ruta o abort)
+    static void error(void* arg, err_t err) {
+        (void)err;
+        TcpProbe* self = (TcpProbe*)arg;
+        if (!self) {
+            return;
+        }
+        self->pcb = nullptr;
+        self->finish(TcpProbe::Result::Down);
+    }
+};
+
+TcpProbe::TcpProbe()
+    : result(Result::Idle), startedAt(0), timeoutMs(0), latencyMs(0), port(0),
+      pcb(nullptr), resolving(false) {
+}
+
+TcpProbe::~TcpProbe() {
+    abort();
+}
+
+void TcpProbe::finish(Result value) {
+    latencyMs = millis() - startedAt;
+    result = value;
+}
+
+void TcpProbe::abort() {
+    resolving = false;
+    if (pcb) {
+        tcp_arg(pcb, nullptr);
+        tcp_err(pcb, nullptr);
+        tcp_abort(pcb);
+        pcb = nullptr;
+    }
+}
+
+void TcpProbe::connectTo(const IPAddress& ip) {
+    pcb = tcp_new();
+    if (!pcb) {
+        finish(Result::Down);
+        return;
+    }
+    tcp_arg(pcb, this);
+    tcp_err(pcb, TcpProbeCallbacks::error);
+    if (tcp_connect(pcb, ip, port, TcpProbeCallbacks::connected) != ERR_OK) {
+        abort();
+        finish(Result::Down);
+    }
+}
+
+bool TcpProbe::start(const char* host, uint16_t port, unsigned long timeoutMs) {
+    IPAddress ip;
+    if (ip.fromString(host)) {
+        return start(ip, port, timeoutMs);
+    }
+    if (isBusy()) {
+        return false;
+    }
+    this->port = port;
+    this->timeoutMs = timeoutMs;
+    startedAt = millis();
+    result = Result::Pending;
+
+    // Sin WiFi.hostByName: esa espera bloquea hasta la respuesta del DNS
+    ip_addr_t addr;
+    resolving = true;
+    err_t err = dns_gethostbyname(host, &addr, TcpProbeCallbacks::dnsFound, this);
+    if (err == ERR_OK) {
+        resolving = false;
+        connectTo(IPAddress(addr));
+    } else if (err != ERR_INPROGRESS) {
+        resolving = false;
+        finish(Result::Down);
+        return false;
+    }
+    return true;
+}
+
+bool TcpProbe::start(const IPAddress& ip, uint16_t port, unsigned long timeoutMs) {
+    if (isBusy()) {
+        return false;
+    }
+    this->port = port;
+    this->timeoutMs = timeoutMs;
+    startedAt = millis();
+    result = Result::Pending;
+    connectTo(ip);
+    return result == Result::Pending || result == Result::Up;
+}
+
+TcpProbe::Result TcpProbe::poll() {
+    if (result == Result::Pending && millis() - startedAt >= timeoutMs) {
+        abort();
+        finish(Result::Down);
+    }
+    if (result == Result::Up || result == Result::Down) {
+        Result done = result;
+        result = Result::Idle;
+        return done;
+    }
+    return result;
+}
+
+#endif
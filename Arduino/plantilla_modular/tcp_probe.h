@@ -0,0 +1,55 @@
+#ifndef TCP_PROBE_H
+#define TCP_PROBE_H
+
+#include <Arduino.h>
+#include <IPAddress.h>
+
+#ifndef OSMO_HOST_BUILD
+struct tcp_pcb;
+#endif
+
+// Connect TCP no bloqueante para sondear un broker sin frenar loop(): start()
+// lanza el SYN (y la consulta DNS si hace falta) y poll() devuelve el
+// resultado cuando llega. En el ESP8266 usa la API raw de lwIP; en el build
+// de host, un socket POSIX no bloqueante.
+class TcpProbe {
+public:
+    enum class Result : uint8_t {
+        Idle,     // Sin sondeo en curso
+        Pending,  // Esperando DNS o el SYN-ACK
+        Up,       // El puerto aceptó la conexión
+        Down      // Rechazo, error o timeout
+    };
+
+private:
+    volatile Result result;
+    unsigned long startedAt;
+    unsigned long timeoutMs;
+    unsigned long latencyMs;
+    uint16_t port;
+#ifdef OSMO_HOST_BUILD
+    int fd;
+#else
+    tcp_pcb* pcb;
+    volatile bool resolving;
+
+    void connectTo(const IPAddress& ip);
+    void finish(Result value);
+    friend struct TcpProbeCallbacks;  // Callbacks de lwIP, en tcp_probe.cpp
+#endif
+
+    void abort();
+
+public:
+    TcpProbe();
+    ~TcpProbe();
+    // false si ya hay uno en curso o no se pudo lanzar (el resultado queda en Down)
+    bool start(const char* host, uint16_t port, unsigned long timeoutMs);
+    bool start(const IPAddress& ip, uint16_t port, unsigned long timeoutMs);
+    // Up/Down una sola vez al terminar (después vuelve a Idle); Pending mientras tanto
+    Result poll();
+    bool isBusy() const { return result == Result::Pending; }
+    unsigned long getLatencyMs() const { return latencyMs; }
+};
+
+#endif
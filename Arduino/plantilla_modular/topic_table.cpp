@@ -0,0 +1,69 @@
+#include "topic_table.h"
+#include "log.h"
+#include "command_definition.h"
+
+TopicTable topicTable;
+
+TopicTable::TopicTable() : groupCount(0), built(false) {
+    for (uint8_t i = 0; i < (uint8_t)Topic::Count; i++) {
+        entries[i].name[0] = '\0';
+        entries[i].length = 0;
+    }
+}
+
+bool TopicTable::set(Topic topic, const char* prefix, const char* unitId, const char* suffix) {
+    return fill(entries[(uint8_t)topic], prefix, unitId, suffix);
+}
+
+bool TopicTable::fill(Entry& entry, const char* prefix, const char* unitId, const char* suffix) {
+    int written = snprintf(entry.name, sizeof(entry.name), "%s%s%s", prefix, unitId, suffix);
+    if (written < 0 || written >= (int)sizeof(entry.name)) {
+        entry.name[0] = '\0';
+        entry.length = 0;
+        LOG_ERROR("❌ Topic demasiado largo para unitId %s", unitId);
+        return false;
+    }
+    entry.length = written;
+    return true;
+}
+
+uint8_t TopicTable::commandSource(const char* topic) const {
+    if (strcmp(topic, get(Topic::Commands)) == 0) {
+        return 0;
+    }
+    for (uint8_t i = 0; i < groupCount; i++) {
+        if (strcmp(topic, groups[i].name) == 0) {
+            return i + 1;
+        }
+    }
+    return 0xFF;
+}
+
+bool TopicTable::build(const char* unitId, const char* const* groupNames, uint8_t groupSlots) {
+    bool ok = true;
+    ok &= set(Topic::Status, "motete/osmo/", unitId, "/status");
+    ok &= set(Topic::Stats, "motete/osmo/", unitId, "/stats");
+    ok &= set(Topic::Response, "motete/osmo/", unitId, "/response");
+    ok &= set(Topic::Errors, "motete/osmo/", unitId, "/errors");
+    ok &= set(Topic::Events, "motete/osmo/", unitId, "/events");
+    ok &= set(Topic::Config, "motete/osmo/", unitId, "/config");
+    ok &= set(Topic::Test, "motete/osmo/", unitId, "/test");
+    ok &= set(Topic::Heartbeat, "motete/osmo/", unitId, "/heartbeat");
+    ok &= set(Topic::Presence, "motete/osmo/", unitId, "/presence");
+    ok &= set(Topic::Discovery, "motete/osmo/discovery", "", "");
+    ok &= set(Topic::Nack, "motete/osmo/", unitId, "/nack");
+    ok &= set(Topic::Probe, "motete/osmo/", unitId, "/probe");
+    ok &= set(Topic::Echo, "motete/osmo/", unitId, "/echo");
+    ok &= set(Topic::Commands, "motete/director/commands/", unitId, "");
+    ok &= set(Topic::StopUnit, StopAll::UNIT_TOPIC_PREFIX, unitId, "");
+    
+    // Grupos: los slots vacíos o que no entran se saltean
+    groupCount = 0;
+    for (uint8_t i = 0; i < groupSlots && groupCount < MAX_GROUPS; i++) {
+        if (groupNames[i] && fill(groups[groupCount], "motete/director/group/", groupNames[i], "")) {
+            groupCount++;
+        }
+    }
+    built = true;
+    return ok;
+}
@@ -0,0 +1,63 @@
+#ifndef TOPIC_TABLE_H
+#define TOPIC_TABLE_H
+
+#include <Arduino.h>
+#include "publish_queue.h"
+
+// Topics propios de la unidad
+enum class Topic : uint8_t {
+    Status,
+    Stats,
+    Response,
+    Errors,
+    Events,
+    Config,
+    Test,
+    Heartbeat,
+    Presence,   // "online"/"offline" retenido (Last Will)
+    Discovery,  // motete/osmo/discovery (común a todas las unidades)
+    Nack,       // Rangos de seq de comandos que no llegaron
+    Probe,      // Resultado del sondeo de enlace
+    Echo,       // Pings del sondeo: la unidad publica y se escucha a sí misma
+    Commands,   // motete/director/commands/<unit> (suscripción)
+    StopUnit,   // motete/director/stop/<unit> (suscripción)
+    Count
+};
+
+// Tabla de topics construida una sola vez desde deviceConfig.unitId.
+// Los publicadores reciben punteros a almacenamiento estático: sin sprintf
+// por mensaje y sin buffers en la pila que un unitId largo pueda desbordar.
+class TopicTable {
+public:
+    static const uint8_t MAX_GROUPS = 4;  // Igual que deviceConfig.groups
+    
+private:
+    struct Entry {
+        char name[PublishQueueLimits::TOPIC_MAX];  // Todo topic debe entrar en la cola
+        uint8_t length;
+    };
+    
+    Entry entries[(uint8_t)Topic::Count];
+    Entry groups[MAX_GROUPS];  // motete/director/group/<g> (suscripción)
+    uint8_t groupCount;
+    bool built;
+    
+    bool fill(Entry& entry, const char* prefix, const char* unitId, const char* suffix);
+    bool set(Topic topic, const char* prefix, const char* unitId, const char* suffix);
+    
+public:
+    TopicTable();
+    // false si algún topic no entra: esos quedan vacíos y no se publican
+    bool build(const char* unitId, const char* const* groupNames, uint8_t groupSlots);
+    const char* get(Topic topic) const { return entries[(uint8_t)topic].name; }
+    uint8_t getGroupCount() const { return groupCount; }
+    const char* getGroup(uint8_t index) const { return groups[index].name; }
+    // Fuente de un comando para CommandSequence: 0 el topic propio, 1.. los grupos
+    uint8_t commandSource(const char* topic) const;
+    uint8_t length(Topic topic) const { return entries[(uint8_t)topic].length; }
+    bool isBuilt() const { return built; }
+};
+
+extern TopicTable topicTable;
+
+#endif
@@ -0,0 +1,206 @@
+#include "udp_command.h"
+#include "config.h"
+#include "log.h"
+#include "clock_sync.h"
+#include <ESP8266WiFi.h>
+
+namespace {
+    uint16_t readU16(const uint8_t* p) {
+        return p[0] | (p[1] << 8);
+    }
+    
+    uint32_t readU32(const uint8_t* p) {
+        return p[0] | (p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+    }
+}
+
+UdpCommandChannel::UdpCommandChannel()
+    : listening(false), accepted(0), rejected(0), stale(0) {
+    memset(peers, 0, sizeof(peers));
+}
+
+bool UdpCommandChannel::start() {
+    br_hmac_key_init(&macKey, &br_sha256_vtable, udpCommandConfig.key, strlen(udpCommandConfig.key));
+    
+    // En ESP8266 beginMulticast escucha en IP_ANY: también recibe unicast
+    IPAddress group;
+    bool multicast = udpCommandConfig.multicastGroup[0] != '\0' && group.fromString(udpCommandConfig.multicastGroup);
+    if (multicast) {
+        listening = udp.beginMulticast(WiFi.localIP(), group, udpCommandConfig.port);
+    } else {
+        listening = udp.begin(udpCommandConfig.port);
+    }
+    
+    if (listening) {
+        LOG_INFO("🎹 Comandos UDP en puerto %d%s%s", udpCommandConfig.port,
+                 multicast ? ", multicast " : "", multicast ? udpCommandConfig.multicastGroup : "");
+    } else {
+        LOG_ERROR("❌ No se pudo abrir el puerto UDP %d", udpCommandConfig.port);
+    }
+    return listening;
+}
+
+void UdpCommandChannel::stop() {
+    if (listening) {
+        udp.stop();
+        listening = false;
+    }
+}
+
+// Comparación en tiempo constante: no revela cuántos bytes coinciden
+bool UdpCommandChannel::verify(const uint8_t* packet) const {
+    br_hmac_context ctx;
+    uint8_t mac[br_sha256_SIZE];
+    br_hmac_init(&ctx, &macKey, 0);
+    br_hmac_update(&ctx, packet, UdpDatagram::MAC_OFFSET);
+    br_hmac_out(&ctx, mac);
+    
+    uint8_t diff = 0;
+    for (size_t i = 0; i < UdpDatagram::MAC_LEN; i++) {
+        diff |= mac[i] ^ packet[UdpDatagram::MAC_OFFSET + i];
+    }
+    return diff == 0;
+}
+
+// La hora de envío firmada debe estar a menos de MAX_AGE_S del reloj del director.
+// Sin ClockSync en la config, o mientras no sincronizó (director movido, servidor
+// caído), no hay con qué comparar y solo cuenta la secuencia: perder los
+// comandos UDP para siempre es peor que esa ventana de repetición.
+bool UdpCommandChannel::isFresh(const uint8_t* packet) const {
+    if (!clockSyncConfig.enabled || !clockSync.isSynced()) {
+        return true;
+    }
+    int64_t now = (int64_t)(synced_time() / 1000);
+    int64_t sent = readU32(packet + UdpDatagram::SENT_OFFSET);
+    int64_t age = now - sent;
+    return age <= (int64_t)UdpDatagram::MAX_AGE_S && age >= -(int64_t)UdpDatagram::MAX_AGE_S;
+}
+
+// Solo avanza: la secuencia debe ser mayor que la última aceptada de ese emisor
+// (aritmética de números de serie, tolera la vuelta de 32 bits)
+bool UdpCommandChannel::acceptSequence(uint32_t sender, uint32_t seq) {
+    uint8_t oldest = 0;
+    for (uint8_t i = 0; i < PEER_COUNT; i++) {
+        if (peers[i].sender == sender) {
+            if ((int32_t)(seq - peers[i].lastSeq) <= 0) {
+                return false;
+            }
+            peers[i].lastSeq = seq;
+            peers[i].lastUsed = millis();
+            return true;
+        }
+        if (peers[i].sender == 0) {
+            oldest = i;
+        } else if (peers[oldest].sender != 0 && millis() - peers[i].lastUsed > millis() - peers[oldest].lastUsed) {
+            oldest = i;
+        }
+    }
+    // Emisor nuevo (firmado con la clave): ocupa un slot libre o el menos usado.
+    // Si era un emisor desalojado, lo viejo ya no pasa isFresh.
+    peers[oldest].sender = sender;
+    peers[oldest].lastSeq = seq;
+    peers[oldest].lastUsed = millis();
+    return true;
+}
+
+bool UdpCommandChannel::decode(const uint8_t* packet, MQTTCommand& cmd) const {
+    uint32_t seq = readU32(packet + 4);
+    uint8_t pumpId = packet[8];
+    bool force = packet[9] & UdpDatagram::FLAG_FORCE;
+    uint16_t duration = readU16(packet + 10);
+    char params[64];
+    
+    switch ((UdpOpcode)packet[3]) {
+        case UdpOpcode::ActivatePump:
+            cmd.action = Commands::ACTIVATE_PUMP;
+            snprintf(params, sizeof(params), "{\"pump_id\":%u,\"duration\":%u,\"force\":%s}",
+                     pumpId, duration, force ? "true" : "false");
+            break;
+        case UdpOpcode::DeactivatePump:
+            cmd.action = Commands::DEACTIVATE_PUMP;
+            snprintf(params, sizeof(params), "{\"pump_id\":%u}", pumpId);
+            break;
+        case UdpOpcode::StopAllPumps:
+            cmd.action = Commands::STOP_ALL;
+            params[0] = '\0';
+            break;
+        case UdpOpcode::GetStatus:
+            cmd.action = Commands::GET_STATUS;
+            strcpy(params, "{}");
+            break;
+        default:
+            return false;
+    }
+    
+    // El command_id correlaciona la respuesta MQTT con el datagrama. Lleva el
+    // emisor: dos emisores (o un director reiniciado) pueden repetir seq y el
+    // anillo de command_id recientes lo tomaría como reentrega
+    char commandId[24];
+    snprintf(commandId, sizeof(commandId), "udp-%08lx-%lu",
+             (unsigned long)readU32(packet + UdpDatagram::SENDER_OFFSET), (unsigned long)seq);
+    cmd.commandId = commandId;
+    cmd.params = params;
+    cmd.timestamp = 0;
+    cmd.seq = 0;  // La secuencia UDP ya se validó en poll()
+    return true;
+}
+
+bool UdpCommandChannel::poll(MQTTCommand& cmd) {
+    if (!udpCommandConfig.enabled) {
+        return false;
+    }
+    // Sin WiFi el socket queda inválido: se reabre al volver
+    if (WiFi.status() != WL_CONNECTED) {
+        stop();
+        return false;
+    }
+    if (!listening && !start()) {
+        return false;
+    }
+    
+    int size = udp.parsePacket();
+    if (size <= 0) {
+        return false;
+    }
+    
+    uint8_t packet[UdpDatagram::SIZE];
+    if (size != (int)UdpDatagram::SIZE || udp.read(packet, sizeof(packet)) != (int)sizeof(packet) ||
+        packet[0] != UdpDatagram::MAGIC_0 || packet[1] != UdpDatagram::MAGIC_1 ||
+        packet[2] != UdpDatagram::VERSION) {
+        rejected++;
+        LOG_DEBUG("UDP: datagrama con formato inválido (%d bytes)", size);
+        return false;
+    }
+    if (!verify(packet)) {
+        rejected++;
+        LOG_WARN("⚠️ UDP: firma inválida desde %s", udp.remoteIP().toString().c_str());
+        return false;
+    }
+    
+    // Destino: vacío = todas las unidades (multicast)
+    const char* unit = (const char*)packet + 12;
+    if (unit[0] != '\0' && strncmp(unit, deviceConfig.unitId, UdpDatagram::UNIT_LEN) != 0) {
+        return false;
+    }
+    
+    if (!isFresh(packet)) {
+        stale++;
+        LOG_DEBUG("UDP: datagrama fuera de hora o sin reloj sincronizado, descartado");
+        return false;
+    }
+    
+    uint32_t seq = readU32(packet + 4);
+    uint32_t sender = readU32(packet + UdpDatagram::SENDER_OFFSET);
+    if (sender == 0 || !acceptSequence(sender, seq)) {
+        stale++;
+        LOG_DEBUG("UDP: secuencia %lu vieja o repetida, descartada", (unsigned long)seq);
+        return false;
+    }
+    
+    if (!decode(packet, cmd)) {
+        rejected++;
+        return false;
+    }
+    accepted++;
+    return true;
+}
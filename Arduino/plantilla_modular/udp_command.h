@@ -0,0 +1,78 @@
+#ifndef UDP_COMMAND_H
+#define UDP_COMMAND_H
+
+#include <Arduino.h>
+#include <WiFiUdp.h>
+#include <bearssl/bearssl.h>
+#include "command_definition.h"
+
+// Datagrama de comando (44 bytes, enteros little-endian):
+//   0  magic "OS"        2  versión         3  opcode (UdpOpcode)
+//   4  secuencia u32     8  pump_id         9  flags (bit 0 = force)
+//  10  duración ms u16  12  unit_id (16 bytes, relleno con 0; vacío = todas)
+//  28  emisor u32       32  envío u32 (segundos desde epoch, reloj del director)
+//  36  HMAC-SHA256 de los bytes 0..35, truncado a 8 bytes
+// Emisor y envío van firmados: la secuencia se lleva por emisor (no por IP,
+// que se puede falsificar) y un datagrama capturado deja de valer a los
+// MAX_AGE_S segundos, también después de un reinicio que borra las secuencias.
+namespace UdpDatagram {
+    constexpr uint8_t MAGIC_0 = 'O';
+    constexpr uint8_t MAGIC_1 = 'S';
+    constexpr uint8_t VERSION = 2;
+    constexpr size_t UNIT_LEN = 16;
+    constexpr size_t SENDER_OFFSET = 28;
+    constexpr size_t SENT_OFFSET = 32;
+    constexpr size_t MAC_OFFSET = 36;
+    constexpr size_t MAC_LEN = 8;
+    constexpr size_t SIZE = MAC_OFFSET + MAC_LEN;
+    constexpr uint8_t FLAG_FORCE = 0x01;
+    constexpr uint32_t MAX_AGE_S = 30;  // Diferencia tolerada con synced_time()
+}
+
+enum class UdpOpcode : uint8_t {
+    ActivatePump = 1,
+    DeactivatePump = 2,
+    StopAllPumps = 3,
+    GetStatus = 4
+};
+
+// Canal de comandos por UDP (unicast y multicast en el mismo puerto) para el
+// modo en vivo: sin broker ni TCP en el medio. Cada emisor lleva su secuencia;
+// lo repetido, viejo o fuera de orden se descarta en vez de ejecutarse tarde.
+// Los comandos válidos salen como MQTTCommand hacia el mismo despachador.
+// Con ClockSync activo no se acepta nada hasta sincronizar: sin reloj no se
+// puede saber si un datagrama es viejo.
+class UdpCommandChannel {
+private:
+    struct Peer {
+        uint32_t sender;       // Id firmado del emisor; 0 = slot libre
+        uint32_t lastSeq;
+        unsigned long lastUsed;
+    };
+    static const uint8_t PEER_COUNT = 4;
+    
+    WiFiUDP udp;
+    bool listening;
+    br_hmac_key_context macKey;
+    Peer peers[PEER_COUNT];  // Solo quien tiene la clave ocupa slots
+    unsigned long accepted;
+    unsigned long rejected;  // Firma inválida, formato o destino ajeno
+    unsigned long stale;     // Secuencia repetida o vieja
+    
+    bool start();
+    bool verify(const uint8_t* packet) const;
+    bool isFresh(const uint8_t* packet) const;
+    bool acceptSequence(uint32_t sender, uint32_t seq);
+    bool decode(const uint8_t* packet, MQTTCommand& cmd) const;
+    
+public:
+    UdpCommandChannel();
+    // Lee a lo sumo un datagrama; true si trae un comando para esta unidad
+    bool poll(MQTTCommand& cmd);
+    void stop();
+    unsigned long getAccepted() const { return accepted; }
+    unsigned long getRejected() const { return rejected; }
+    unsigned long getStale() const { return stale; }
+};
+
+#endif
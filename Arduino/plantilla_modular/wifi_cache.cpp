@@ -0,0 +1,64 @@
+#include "wifi_cache.h"
+
+namespace {
+    // Offset en bloques de 4 bytes dentro de la RTC de usuario. Los primeros
+    // 128 bytes los usa eboot para la orden de OTA: no pisarlos
+    const uint32_t RTC_OFFSET = 32;
+}
+
+WiFiCache::WiFiCache() : valid(false) {
+    memset(&record, 0, sizeof(record));
+}
+
+uint32_t WiFiCache::crc32(const uint8_t* data, size_t length) {
+    uint32_t crc = 0xFFFFFFFF;
+    while (length--) {
+        crc ^= *data++;
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320 : crc >> 1;
+        }
+    }
+    return ~crc;
+}
+
+// FNV-1a: basta para detectar que cambió el SSID configurado
+uint32_t WiFiCache::hashSsid(const char* ssid) {
+    uint32_t hash = 2166136261UL;
+    while (*ssid) {
+        hash ^= (uint8_t)*ssid++;
+        hash *= 16777619UL;
+    }
+    return hash;
+}
+
+bool WiFiCache::load(const char* ssid) {
+    valid = false;
+    if (!ESP.rtcUserMemoryRead(RTC_OFFSET, (uint32_t*)&record, sizeof(record))) {
+        return false;
+    }
+    // Tras un corte de energía la RTC trae basura: el CRC lo descarta
+    const uint8_t* body = (const uint8_t*)&record + sizeof(record.crc);
+    valid = record.crc == crc32(body, sizeof(record) - sizeof(record.crc)) &&
+            record.ssidHash == hashSsid(ssid) &&
+            record.channel >= 1 && record.channel <= 14;
+    return valid;
+}
+
+void WiFiCache::save(const char* ssid, const uint8_t* bssid, int32_t channel) {
+    if (bssid == nullptr) {
+        return;
+    }
+    record.ssidHash = hashSsid(ssid);
+    memcpy(record.bssid, bssid, sizeof(record.bssid));
+    record.channel = (uint8_t)channel;
+    record.reserved = 0;
+    const uint8_t* body = (const uint8_t*)&record + sizeof(record.crc);
+    record.crc = crc32(body, sizeof(record) - sizeof(record.crc));
+    valid = ESP.rtcUserMemoryWrite(RTC_OFFSET, (uint32_t*)&record, sizeof(record));
+}
+
+void WiFiCache::invalidate() {
+    valid = false;
+    record.crc = 0;
+    ESP.rtcUserMemoryWrite(RTC_OFFSET, (uint32_t*)&record, sizeof(record));
+}
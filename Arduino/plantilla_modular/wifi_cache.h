@@ -0,0 +1,37 @@
+#ifndef WIFI_CACHE_H
+#define WIFI_CACHE_H
+
+#include <Arduino.h>
+
+// Último AP bueno (BSSID y canal) en la memoria RTC. Sobrevive a reset,
+// watchdog y brownout pero no a un corte de energía: con un registro válido
+// se conecta directo al AP sin escanear; si no, se hace el WiFi.begin
+// completo. La IP siempre sale de DHCP: una IP guardada no sabe cuándo
+// vence su lease y podría chocar con la de otro equipo.
+class WiFiCache {
+private:
+    struct Record {
+        uint32_t crc;        // CRC32 del resto del registro
+        uint32_t ssidHash;   // Otro SSID en config invalida el registro
+        uint8_t bssid[6];
+        uint8_t channel;
+        uint8_t reserved;
+    };
+    
+    Record record;
+    bool valid;
+    
+    static uint32_t crc32(const uint8_t* data, size_t length);
+    static uint32_t hashSsid(const char* ssid);
+    
+public:
+    WiFiCache();
+    bool load(const char* ssid);  // true si hay un AP guardado para ese SSID
+    void save(const char* ssid, const uint8_t* bssid, int32_t channel);
+    void invalidate();
+    bool isValid() const { return valid; }
+    const uint8_t* getBssid() const { return record.bssid; }
+    int32_t getChannel() const { return record.channel; }
+};
+
+#endif
@@ -0,0 +1,133 @@
+// Simulador de tormenta de reconexión tras reiniciar el broker.
+//
+// Reproduce la lógica de reintento del firmware (ReconnectBackoff en
+// Arduino/plantilla_modular) para N unidades que pierden el broker a la vez,
+// y la compara con el reintento fijo anterior (cada 1 s, en sincronía).
+//
+// Uso (desde local-test):
+//   node simulation/reconnect_storm.js [--units 20] [--outage 30000] [--capacity 5]
+//
+// --capacity es la cantidad de CONNECT por segundo que el broker acepta;
+// el resto falla y la unidad vuelve a esperar según su estrategia.
+
+const args = process.argv.slice(2);
+function arg(name, def) {
+  const i = args.indexOf(`--${name}`);
+  return i >= 0 ? Number(args[i + 1]) : def;
+}
+
+const UNITS = arg('units', 20);
+const OUTAGE_MS = arg('outage', 30000);
+const CAPACITY = arg('capacity', 5);
+const BASE_MS = 1000;
+const MAX_MS = 60000;
+const HORIZON_MS = OUTAGE_MS + 10 * MAX_MS;
+
+// ===== Port de ReconnectBackoff (xorshift32 + equal jitter) =====
+class ReconnectBackoff {
+  constructor(base, max, chipId) {
+    this.base = base;
+    this.max = max;
+    this.attempts = 0;
+    let v = chipId >>> 0;
+    v = (v ^ (v << 13)) >>> 0;
+    v = (v ^ 0x9E3779B9) >>> 0;
+    this.state = v || 0x9E3779B9;
+  }
+
+  nextRandom() {
+    let x = this.state;
+    x = (x ^ (x << 13)) >>> 0;
+    x = (x ^ (x >>> 17)) >>> 0;
+    x = (x ^ (x << 5)) >>> 0;
+    this.state = x;
+    return x;
+  }
+
+  jitter(ceiling) {
+    const half = Math.floor(ceiling / 2);
+    return half + (this.nextRandom() % (half + 1));
+  }
+
+  nextDelay() {
+    const shift = Math.min(this.attempts, 16);
+    const ceiling = Math.min(this.base * 2 ** shift, this.max);
+    if (this.attempts < 255) this.attempts += 1;
+    return this.jitter(ceiling);
+  }
+}
+
+// Reintento fijo anterior: todas las unidades cada 1 s, en el mismo instante
+class FixedRetry {
+  nextDelay() {
+    return 1000;
+  }
+}
+
+function simulate(strategyName, makeStrategy) {
+  const units = [];
+  for (let i = 0; i < UNITS; i++) {
+    const chipId = Math.floor(Math.random() * 0xFFFFFF);
+    const strategy = makeStrategy(chipId);
+    // Todas detectan la caída en t=0 y agendan su primer reintento
+    units.push({ strategy, nextAttempt: strategy.nextDelay(), connectedAt: null, attempts: 0 });
+  }
+
+  const attemptsPerSecond = new Map();
+  const acceptedPerSecond = new Map();
+
+  for (let t = 0; t <= HORIZON_MS; t++) {
+    for (const unit of units) {
+      if (unit.connectedAt !== null || unit.nextAttempt !== t) continue;
+
+      unit.attempts += 1;
+      const second = Math.floor(t / 1000);
+      attemptsPerSecond.set(second, (attemptsPerSecond.get(second) || 0) + 1);
+
+      const accepted = acceptedPerSecond.get(second) || 0;
+      if (t >= OUTAGE_MS && accepted < CAPACITY) {
+        acceptedPerSecond.set(second, accepted + 1);
+        unit.connectedAt = t;
+      } else {
+        unit.nextAttempt = t + unit.strategy.nextDelay();
+      }
+    }
+    if (units.every((u) => u.connectedAt !== null)) break;
+  }
+
+  const times = units
+    .filter((u) => u.connectedAt !== null)
+    .map((u) => u.connectedAt - OUTAGE_MS)
+    .sort((a, b) => a - b);
+  const pct = (p) => times[Math.min(times.length - 1, Math.floor((p / 100) * times.length))];
+  const peak = Math.max(...attemptsPerSecond.values());
+  const restartSecond = Math.floor(OUTAGE_MS / 1000);
+  const peakAfterRestart = Math.max(0, ...[...attemptsPerSecond.entries()]
+    .filter(([second]) => second >= restartSecond)
+    .map(([, count]) => count));
+  const totalAttempts = units.reduce((sum, u) => sum + u.attempts, 0);
+
+  console.log(`\n📊 Estrategia: ${strategyName}`);
+  console.log(`   Reconectadas: ${times.length}/${UNITS}`);
+  if (times.length > 0) {
+    console.log(`   Tiempo de reconexión tras reinicio del broker: p50=${pct(50)}ms p90=${pct(90)}ms max=${times[times.length - 1]}ms`);
+  }
+  console.log(`   Intentos totales: ${totalAttempts}, pico de CONNECT/s: ${peak} (tras reinicio: ${peakAfterRestart})`);
+
+  // Histograma de reconexiones por segundo desde que vuelve el broker
+  const buckets = new Map();
+  times.forEach((ms) => {
+    const s = Math.floor(ms / 1000);
+    buckets.set(s, (buckets.get(s) || 0) + 1);
+  });
+  console.log('   Reconexiones por segundo:');
+  [...buckets.keys()].sort((a, b) => a - b).forEach((s) => {
+    console.log(`   ${String(s).padStart(4)}s | ${'#'.repeat(buckets.get(s))} ${buckets.get(s)}`);
+  });
+
+  return { times, peak, peakAfterRestart, totalAttempts };
+}
+
+console.log(`🎭 ${UNITS} unidades, broker caído ${OUTAGE_MS}ms, capacidad ${CAPACITY} CONNECT/s`);
+simulate('fijo 1s (anterior)', () => new FixedRetry());
+simulate('backoff exponencial + jitter', (chipId) => new ReconnectBackoff(BASE_MS, MAX_MS, chipId));
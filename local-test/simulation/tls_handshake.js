@@ -0,0 +1,79 @@
+// Mide el handshake TLS contra un broker (p. ej. Mosquitto con
+// config/mosquitto_tls.conf): completo vs reanudado, RSA vs ECDSA.
+//
+// Uso (desde local-test):
+//   node simulation/tls_handshake.js --host localhost --port 8883 \
+//     --ca certs/ca.crt --cert certs/osmo_ec.crt --key certs/osmo_ec.key [--runs 20]
+//
+// Es la contraparte de host de los logs "⏱️ Handshake TLS+MQTT" del firmware
+// AWS: compara tiempos antes (RSA, sin sesión) y después (ECDSA, reanudación).
+
+const tls = require('tls');
+const fs = require('fs');
+
+const args = process.argv.slice(2);
+function arg(name, def) {
+  const i = args.indexOf(`--${name}`);
+  return i >= 0 ? args[i + 1] : def;
+}
+
+const HOST = arg('host', 'localhost');
+const PORT = Number(arg('port', 8883));
+const RUNS = Number(arg('runs', 20));
+const options = {
+  host: HOST,
+  port: PORT,
+  servername: HOST,
+  ca: arg('ca') ? fs.readFileSync(arg('ca')) : undefined,
+  cert: arg('cert') ? fs.readFileSync(arg('cert')) : undefined,
+  key: arg('key') ? fs.readFileSync(arg('key')) : undefined,
+  // Como el firmware: solo ECDHE, TLS 1.2 (BearSSL no hace TLS 1.3)
+  ciphers: 'ECDHE-ECDSA-AES128-GCM-SHA256:ECDHE-ECDSA-CHACHA20-POLY1305:ECDHE-RSA-AES128-GCM-SHA256:ECDHE-RSA-CHACHA20-POLY1305',
+  maxVersion: 'TLSv1.2',
+  rejectUnauthorized: arg('insecure') === undefined
+};
+
+function handshake(session) {
+  return new Promise((resolve, reject) => {
+    const start = process.hrtime.bigint();
+    let saved = null;
+    const socket = tls.connect({ ...options, session }, () => {
+      const ms = Number(process.hrtime.bigint() - start) / 1e6;
+      const result = { ms, reused: socket.isSessionReused(), cipher: socket.getCipher().name };
+      // En TLS 1.2 la sesión está disponible al terminar el handshake
+      saved = socket.getSession();
+      socket.end();
+      resolve({ ...result, session: saved });
+    });
+    socket.on('error', reject);
+  });
+}
+
+function summary(name, samples) {
+  const sorted = samples.map((s) => s.ms).sort((a, b) => a - b);
+  const p = (q) => sorted[Math.min(sorted.length - 1, Math.floor(q * sorted.length))].toFixed(2);
+  const reused = samples.filter((s) => s.reused).length;
+  console.log(`📊 ${name}: p50=${p(0.5)}ms p90=${p(0.9)}ms max=${sorted[sorted.length - 1].toFixed(2)}ms (reanudadas ${reused}/${samples.length}, ${samples[0].cipher})`);
+}
+
+async function main() {
+  console.log(`🔐 ${RUNS} handshakes contra ${HOST}:${PORT}`);
+
+  const full = [];
+  for (let i = 0; i < RUNS; i++) full.push(await handshake(undefined));
+  summary('completo', full);
+
+  const resumed = [];
+  let session = full[full.length - 1].session;
+  for (let i = 0; i < RUNS; i++) {
+    const r = await handshake(session);
+    session = r.session;
+    resumed.push(r);
+  }
+  summary('con sesión', resumed);
+}
+
+main().catch((error) => {
+  console.error('❌ Error midiendo handshake:', error.message);
+  process.exit(1);
+});
@@ -0,0 +1,159 @@
+// Emisor de comandos UDP firmados (canal en vivo del firmware, udp_command.h)
+// y medición de latencia contra la ruta MQTT.
+//
+// Uso (desde local-test):
+//   node simulation/udp_command.js --host 192.168.1.50 --unit osmo_norte \
+//     --key motete-udp-cambiar [--action get_status] [--pump 0] [--duration 500] [--runs 20]
+//   node simulation/udp_command.js --multicast 239.255.77.1 --unit "" --action stop_all --once
+//
+// Por cada ronda manda el mismo comando por UDP y por MQTT
+// (motete/director/commands/<unit>) y mide hasta la respuesta en
+// motete/osmo/<unit>/response. La subida es la misma en ambos casos: la
+// diferencia es la bajada (navegador/Express/mqtt.js/Mosquitto/TCP contra un
+// datagrama). Con --unit "" el comando va a todas las unidades y no se mide.
+
+const dgram = require('dgram');
+const crypto = require('crypto');
+const path = require('path');
+const mqtt = require(require.resolve('mqtt', { paths: [path.join(__dirname, '../src')] }));
+
+const args = process.argv.slice(2);
+function arg(name, def) {
+  const i = args.indexOf(`--${name}`);
+  return i >= 0 ? args[i + 1] : def;
+}
+
+const HOST = arg('host');
+const MULTICAST = arg('multicast');
+const PORT = Number(arg('port', 5520));
+const KEY = arg('key', 'motete-udp-cambiar');
+const UNIT = arg('unit', 'osmo_norte');
+const ACTION = arg('action', 'get_status');
+const PUMP = Number(arg('pump', 0));
+const DURATION = Number(arg('duration', 500));
+const FORCE = args.includes('--force');
+const RUNS = Number(arg('runs', 20));
+const BROKER = arg('broker', 'mqtt://localhost:1883');
+const RESPONSE_TIMEOUT_MS = 3000;
+
+// Mismo orden que UdpOpcode en el firmware
+const OPCODES = { activate_pump: 1, deactivate_pump: 2, stop_all: 3, get_status: 4 };
+
+// Secuencia sembrada con el reloj: tras reiniciar el emisor sigue siendo
+// mayor que la última que vio la unidad
+let seq = Math.floor(Date.now() / 10) >>> 0;
+// Id de emisor firmado: la unidad lleva la secuencia por emisor, no por IP
+const SENDER = Number(arg('sender', crypto.randomBytes(4).readUInt32LE(0) || 1)) >>> 0;
+
+// Correr en la máquina del director: la hora de envío se compara con su reloj
+function buildDatagram(sequence) {
+  const buf = Buffer.alloc(44);
+  buf.write('OS', 0, 'ascii');
+  buf[2] = 2;
+  buf[3] = OPCODES[ACTION];
+  buf.writeUInt32LE(sequence >>> 0, 4);
+  buf[8] = PUMP;
+  buf[9] = FORCE ? 1 : 0;
+  buf.writeUInt16LE(DURATION, 10);
+  buf.write(UNIT.slice(0, 16), 12, 'ascii');
+  buf.writeUInt32LE(SENDER, 28);
+  buf.writeUInt32LE(Math.floor(Date.now() / 1000) >>> 0, 32);
+  const mac = crypto.createHmac('sha256', KEY).update(buf.subarray(0, 36)).digest();
+  mac.copy(buf, 36, 0, 8);
+  return buf;
+}
+
+function commandParams() {
+  if (ACTION === 'activate_pump') return { pump_id: PUMP, duration: DURATION, force: FORCE };
+  if (ACTION === 'deactivate_pump') return { pump_id: PUMP };
+  return {};
+}
+
+function summary(name, samples) {
+  if (samples.length === 0) {
+    console.log(`📊 ${name}: sin respuestas`);
+    return;
+  }
+  const sorted = [...samples].sort((a, b) => a - b);
+  const p = (q) => sorted[Math.min(sorted.length - 1, Math.floor(q * sorted.length))].toFixed(2);
+  console.log(`📊 ${name}: p50=${p(0.5)}ms p90=${p(0.9)}ms min=${sorted[0].toFixed(2)}ms (${samples.length} respuestas)`);
+}
+
+async function main() {
+  if (!OPCODES[ACTION]) throw new Error(`acción desconocida: ${ACTION}`);
+  if (!HOST && !MULTICAST) throw new Error('falta --host o --multicast');
+  const target = MULTICAST || HOST;
+
+  const udp = dgram.createSocket('udp4');
+  await new Promise((resolve) => udp.bind(resolve));
+  if (MULTICAST) udp.setMulticastTTL(1);
+  const sendUdp = (sequence) => new Promise((resolve, reject) => {
+    udp.send(buildDatagram(sequence), PORT, target, (err) => (err ? reject(err) : resolve()));
+  });
+
+  if (args.includes('--once') || UNIT === '') {
+    await sendUdp(seq);
+    console.log(`🎹 ${ACTION} (seq ${seq}) enviado a ${target}:${PORT}`);
+    udp.close();
+    return;
+  }
+
+  const client = mqtt.connect(BROKER, {
+    username: arg('user', 'director'),
+    password: arg('password', 'director')
+  });
+  await new Promise((resolve, reject) => {
+    client.once('connect', resolve);
+    client.once('error', reject);
+  });
+  const pending = new Map();
+  client.subscribe(`motete/osmo/${UNIT}/response`, { qos: 0 });
+  client.on('message', (topic, message) => {
+    try {
+      const { command_id: id } = JSON.parse(message.toString());
+      const waiter = pending.get(id);
+      if (waiter) waiter(process.hrtime.bigint());
+    } catch (e) {
+      // Respuesta que no es JSON: no es nuestra
+    }
+  });
+
+  const roundTrip = (id, send) => new Promise((resolve) => {
+    const start = process.hrtime.bigint();
+    const timer = setTimeout(() => {
+      pending.delete(id);
+      resolve(null);
+    }, RESPONSE_TIMEOUT_MS);
+    pending.set(id, (end) => {
+      clearTimeout(timer);
+      pending.delete(id);
+      resolve(Number(end - start) / 1e6);
+    });
+    send();
+  });
+
+  console.log(`🎹 ${RUNS} rondas de ${ACTION} a ${UNIT} (UDP ${target}:${PORT} vs MQTT ${BROKER})`);
+  const udpSamples = [];
+  const mqttSamples = [];
+  for (let i = 0; i < RUNS; i++) {
+    seq = (seq + 1) >>> 0;
+    const sequence = seq;
+    const udpMs = await roundTrip(`udp-${SENDER.toString(16).padStart(8, '0')}-${sequence}`, () => sendUdp(sequence));
+    if (udpMs !== null) udpSamples.push(udpMs);
+
+    const id = `mqtt_${Date.now()}_${i}`;
+    const command = { command_id: id, action: ACTION, params: commandParams(), timestamp: Date.now() };
+    const mqttMs = await roundTrip(id, () => client.publish(`motete/director/commands/${UNIT}`, JSON.stringify(command), { qos: 1 }));
+    if (mqttMs !== null) mqttSamples.push(mqttMs);
+  }
+
+  summary('UDP ', udpSamples);
+  summary('MQTT', mqttSamples);
+  udp.close();
+  client.end();
+}
+
+main().catch((error) => {
+  console.error('❌ Error enviando comandos UDP:', error.message);
+  process.exit(1);
+});
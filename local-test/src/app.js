@@ -2,6 +2,8 @@ const express = require("express");
 const path = require("path");
 const http = require('http');
 const OsmoMQTTClient = require("./services/mqttClient");
+const SyslogReceiver = require("./services/syslogReceiver");
+const ClockServer = require("./services/clockServer");
 
 const app = express();
 const server = http.createServer(app);
@@ -12,6 +14,8 @@ app.use(express.json());
 app.use(express.static(path.join(__dirname, "public")));
 
 const mqttClient = new OsmoMQTTClient();
+const syslogReceiver = new SyslogReceiver(Number(process.env.SYSLOG_PORT) || 5514);
+const clockServer = new ClockServer(Number(process.env.CLOCK_PORT) || 5521);
 
 app.get("/api/status", (req, res) => {
   const simulate = req.query.simulate === 'true';
@@ -24,12 +28,14 @@ app.get("/api/status", (req, res) => {
   const osmoConfigs = simulate ? {} : mqttClient.getOsmoConfigs();
   console.log('📊 Configuraciones obtenidas del mqttClient:', osmoConfigs);
   const cooldowns = simulate ? {} : mqttClient.getCooldownsSnapshot();
+  const osmoStats = simulate ? {} : mqttClient.getOsmoStats();
   
   const response = {
     mqtt_connected: mqttClient.isConnectionHealthy(),
     connected_osmos: osmos,
     osmo_configs: osmoConfigs, // ✅ Agregado: configuraciones de bombas
-    cooldowns // ✅ Cooldowns autoritativos del servidor { unitId: { pumpId: { remainingMs, totalMs } } }
+    cooldowns, // ✅ Cooldowns autoritativos del servidor { unitId: { pumpId: { remainingMs, totalMs } } }
+    osmo_stats: osmoStats // Estadísticas de uso por bomba { unitId: { pumps: { pumpId: {...} } } }
   };
   
   console.log('📊 Respuesta /api/status:', response);
@@ -68,6 +74,71 @@ app.post("/api/command/:unitId", (req, res) => {
   }
 });
 
+app.post("/api/group/:group/command", (req, res) => {
+  try {
+    const command = req.body;
+    if (!command.action) {
+      return res.status(400).json({ success: false, error: "Comando debe incluir 'action'" });
+    }
+    const commandId = mqttClient.sendGroupCommand(req.params.group, command.action, command.params);
+    res.json({ success: true, command_id: commandId });
+  } catch (error) {
+    console.error(`❌ Error enviando comando al grupo ${req.params.group}:`, error);
+    res.status(500).json({ success: false, error: error.message });
+  }
+});
+
+// Body: { group: "all", units: { osmo_norte: { action, params }, "*": { action, params } } }
+app.post("/api/bundle", (req, res) => {
+  try {
+    const { group = 'all', units } = req.body || {};
+    if (!units || Object.values(units).some((command) => !command?.action)) {
+      return res.status(400).json({ success: false, error: "Cada unidad del bundle debe incluir 'action'" });
+    }
+    const commandIds = mqttClient.sendBundle(group, units);
+    res.json({ success: true, command_ids: commandIds });
+  } catch (error) {
+    console.error('❌ Error enviando bundle:', error);
+    res.status(500).json({ success: false, error: error.message });
+  }
+});
+
+app.post("/api/stop_all", (req, res) => {
+  try {
+    const unitId = req.body?.unit_id || null;
+    const topic = mqttClient.sendStopAll(unitId);
+    res.json({ success: true, topic });
+  } catch (error) {
+    console.error('❌ Error enviando parada de emergencia:', error);
+    res.status(500).json({ success: false, error: error.message });
+  }
+});
+
+app.get("/api/events/:unitId", (req, res) => {
+  res.json({ unit_id: req.params.unitId, events: mqttClient.getOsmoEvents(req.params.unitId) });
+});
+
+app.get("/api/discovery", (req, res) => {
+  res.json(mqttClient.getOsmoDiscovery());
+});
+
+// Último sondeo de cada unidad; se dispara con action "probe" en /api/command/:unitId
+app.get("/api/probe", (req, res) => {
+  res.json(mqttClient.getOsmoProbes());
+});
+
+app.get("/api/presence", (req, res) => {
+  res.json(mqttClient.getOsmoPresence());
+});
+
+app.get("/api/clock", (req, res) => {
+  res.json(clockServer.getStats());
+});
+
+app.get("/api/logs/:unitId", (req, res) => {
+  res.json({ unit_id: req.params.unitId, logs: syslogReceiver.getLogs(req.params.unitId) });
+});
+
 function broadcast(event, payload) {
   if (!wss) return;
   const msg = JSON.stringify({ event, payload });
@@ -81,6 +152,8 @@ function broadcast(event, payload) {
 async function startServer() {
   try {
     await mqttClient.connect();
+    syslogReceiver.start();
+    clockServer.start();
     // WebSocket Server
     const { WebSocketServer } = require('ws');
     wss = new WebSocketServer({ server });
@@ -95,6 +168,11 @@ async function startServer() {
       broadcast('cooldowns', mqttClient.getCooldownsSnapshot());
     };
 
+    // Hook: altas y bajas por presencia (Last Will), sin esperar al prune
+    mqttClient.onPresenceChanged = (unitId, online) => {
+      broadcast('presence', { unit_id: unitId, online });
+    };
+
     server.listen(PORT, () => {
       console.log(`🌐 Servidor web + WS en http://localhost:${PORT}`);
     });
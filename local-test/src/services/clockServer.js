@@ -0,0 +1,59 @@
+const dgram = require('dgram');
+
+// Servidor de hora para los Osmos (contraparte de clock_sync.h en el firmware).
+// Responde cada pedido de 16 bytes con t2 (recepción) y t3 (envío) en µs
+// desde epoch; el dispositivo calcula offset y deriva con t1..t4.
+const MAGIC = 'OC';
+const VERSION = 1;
+const TYPE_REQUEST = 1;
+const TYPE_RESPONSE = 2;
+
+class ClockServer {
+  constructor(port = 5521) {
+    this.port = port;
+    this.socket = null;
+    this.requests = 0;
+    // Reloj monotónico anclado a epoch: no salta si cambia la hora del sistema
+    this.epochBaseUs = BigInt(Date.now()) * 1000n - process.hrtime.bigint() / 1000n;
+  }
+
+  nowUs() {
+    return this.epochBaseUs + process.hrtime.bigint() / 1000n;
+  }
+
+  start() {
+    this.socket = dgram.createSocket('udp4');
+    this.socket.on('message', (msg, rinfo) => this._handle(msg, rinfo));
+    this.socket.on('error', (error) => {
+      console.error('❌ Error en servidor de hora:', error.message);
+    });
+    this.socket.bind(this.port, () => {
+      console.log(`⏱️ Servidor de hora escuchando en UDP ${this.port}`);
+    });
+  }
+
+  _handle(msg, rinfo) {
+    // t2 lo antes posible tras la llegada
+    const t2 = this.nowUs();
+    if (msg.length !== 16 || msg.toString('ascii', 0, 2) !== MAGIC ||
+        msg[2] !== VERSION || msg[3] !== TYPE_REQUEST) {
+      return;
+    }
+
+    const reply = Buffer.alloc(32);
+    reply.write(MAGIC, 0, 'ascii');
+    reply[2] = VERSION;
+    reply[3] = TYPE_RESPONSE;
+    msg.copy(reply, 4, 4, 16); // secuencia y t1, tal cual
+    reply.writeBigUInt64LE(t2, 16);
+    reply.writeBigUInt64LE(this.nowUs(), 24);
+    this.socket.send(reply, rinfo.port, rinfo.address);
+    this.requests += 1;
+  }
+
+  getStats() {
+    return { port: this.port, requests: this.requests, now_ms: Number(this.nowUs() / 1000n) };
+  }
+}
+
+module.exports = ClockServer;
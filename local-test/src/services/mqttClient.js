@@ -1,13 +1,26 @@
 const mqtt = require('mqtt');
 const { v4: uuidv4 } = require('uuid');
 
+const MAX_EVENT_HISTORY = 200; // Eventos guardados por unidad
+// MQTT 5: segundos que un comando puede esperar en la cola del broker; vencido, no se entrega
+const COMMAND_EXPIRY_S = Number(process.env.COMMAND_EXPIRY_S) || 10;
+const COMMAND_HISTORY = 64; // Comandos guardados por topic para reenviar ante un NACK
+
 class OsmoMQTTClient {
   constructor(password) {
     this.client = null;
     this.connectedOsmos = new Map();
     this.osmoConfigs = new Map(); // ✅ Nuevo: almacenar configuraciones
     this.cooldowns = new Map(); // ✅ unitId -> Map<pumpId, { startedAt, durationMs }>
+    this.osmoStats = new Map(); // unitId -> estadísticas de uso publicadas por el dispositivo
+    this.osmoEvents = new Map(); // unitId -> historial de eventos en orden de llegada (el firmware vacía su spool antes que lo nuevo)
+    this.osmoPresence = new Map(); // unitId -> { online, since } (retenido + Last Will del broker)
+    this.osmoDiscovery = new Map(); // unitId -> anuncio en motete/osmo/discovery (IP, MAC, broker usado)
+    this.osmoProbes = new Map(); // unitId -> último sondeo de enlace (RSSI, ida y vuelta, fallos)
+    this.commandSeq = new Map(); // topic de comandos -> último seq enviado
+    this.commandHistory = new Map(); // topic de comandos -> últimos { seq, payload, options } para NACK
     this.isConnected = false;
+    this.protocolVersion = Number(process.env.MQTT_PROTOCOL_VERSION) === 5 ? 5 : 4; // 5 con firmware -DOSMO_MQTT_V5
     this.password = password || 'director'; // Fallback por si no se provee
     console.log('🔧 Constructor OsmoMQTTClient iniciado');
     console.log('🔧 Password configurado:', this.password);
@@ -27,6 +40,9 @@ class OsmoMQTTClient {
         clientId: 'director_' + Math.random().toString(16).substr(2, 8),
         connectTimeout: 5000, // 5 segundos de timeout
         reconnectPeriod: 0, // No reconectar automáticamente
+        protocolVersion: this.protocolVersion,
+        // MQTT 5: alias automáticos para los topics de comandos que se repiten
+        autoAssignTopicAlias: this.protocolVersion === 5,
       });
 
       this.client.on('connect', () => {
@@ -52,8 +68,8 @@ class OsmoMQTTClient {
         this.isConnected = false;
       });
 
-      this.client.on('message', (topic, message) => {
-        this.handleMessage(topic, message);
+      this.client.on('message', (topic, message, packet) => {
+        this.handleMessage(topic, message, packet);
       });
     });
   }
@@ -67,6 +83,11 @@ class OsmoMQTTClient {
       'motete/osmo/+/response',  // ✅ Agregado para respuestas de comandos
       'motete/osmo/+/command',   // ✅ Agregado para comandos operativos
       'motete/osmo/+/config',    // ✅ Agregado para configuración
+      'motete/osmo/+/stats',     // Estadísticas de uso por bomba (cadencia lenta)
+      'motete/osmo/+/events',    // Historial de encendidos/apagados y paradas
+      'motete/osmo/+/presence',  // "online"/"offline" retenido; "offline" lo publica el broker (Last Will)
+      'motete/osmo/+/nack',      // Rangos de seq de comandos que la unidad no recibió
+      'motete/osmo/+/probe',     // Resultado del comando probe (histogramas de RSSI y latencia)
       'motete/osmo/discovery'
     ];
 
@@ -88,20 +109,42 @@ class OsmoMQTTClient {
     console.log('✅ Todas las suscripciones configuradas');
   }
 
-  handleMessage(topic, message) {
+  handleMessage(topic, message, packet) {
     try {
       console.log(`📩 Mensaje MQTT recibido en topic: ${topic}`);
       console.log(`📩 Contenido del mensaje:`, message.toString());
+
+      // Presencia: texto plano, no JSON
+      if (topic.endsWith('/presence')) {
+        this.handlePresence(topic.split('/')[2], message.toString());
+        return;
+      }
       
       const data = JSON.parse(message.toString());
       console.log(`📩 Mensaje parseado:`, data);
 
+      if (topic.endsWith('/nack')) {
+        this.handleNack(topic.split('/')[2], data);
+        return;
+      }
+
+      if (topic.endsWith('/probe')) {
+        this.handleProbe(topic.split('/')[2], data);
+        return;
+      }
+
+      // Topic común: la unidad va en el payload, no en el topic
+      if (topic === 'motete/osmo/discovery') {
+        this.handleDiscovery(data);
+        return;
+      }
+
       if (topic.includes('/status')) {
         const unitId = topic.split('/')[2];
         console.log(`🔍 Procesando status para unitId: ${unitId}`);
         
         this.connectedOsmos.set(unitId, {
-          ...data,
+          ...this.mergeStatus(unitId, data),
           lastSeen: new Date()
         });
         console.log(`💚 Estado actualizado para ${unitId}`);
@@ -146,6 +189,11 @@ class OsmoMQTTClient {
 
       if (topic.includes('/response')) {
         const unitId = topic.split('/')[2];
+        // MQTT 5: el command_id vuelve como correlation data
+        const correlation = packet?.properties?.correlationData;
+        if (!data.command_id && correlation) {
+          data.command_id = correlation.toString();
+        }
         console.log(`📨 Respuesta de comando recibida de ${unitId}:`, data);
         
         // Actualizar estado del Osmo con la respuesta
@@ -200,6 +248,27 @@ class OsmoMQTTClient {
         }
       }
 
+      if (topic.includes('/stats')) {
+        const unitId = topic.split('/')[2];
+        // El dispositivo publica contadores acumulados: basta con guardar el último
+        this.osmoStats.set(unitId, {
+          ...data,
+          receivedAt: new Date()
+        });
+        console.log(`📈 Estadísticas actualizadas para ${unitId}`);
+      }
+
+      if (topic.includes('/events')) {
+        const unitId = topic.split('/')[2];
+        const history = this.osmoEvents.get(unitId) || [];
+        // Orden de llegada: tras un corte el firmware manda primero lo guardado en flash.
+        // timestamp es millis() del dispositivo y vuelve a 0 al reiniciar: no sirve para ordenar
+        history.push({ ...data, receivedAt: new Date() });
+        if (history.length > MAX_EVENT_HISTORY) history.shift();
+        this.osmoEvents.set(unitId, history);
+        console.log(`📜 Evento de ${unitId}: ${data.event}${data.pump_id !== undefined ? ` bomba ${data.pump_id}` : ''}`);
+      }
+
       if (topic.includes('/sensors')) {
         const unitId = topic.split('/')[2];
         console.log(`🌡️ Datos de sensores de ${unitId}:`, data);
@@ -209,6 +278,66 @@ class OsmoMQTTClient {
     }
   }
 
+  handleDiscovery(data) {
+    const unitId = data.unit_id;
+    if (!unitId) return;
+    this.osmoDiscovery.set(unitId, { ...data, announcedAt: new Date() });
+    if (!this.connectedOsmos.has(unitId)) {
+      this.connectedOsmos.set(unitId, { unit_id: unitId, status: 'online', lastSeen: new Date() });
+    }
+    console.log(`🔎 ${unitId} anunciado desde ${data.ip} (broker ${data.broker} vía ${data.broker_source})`);
+  }
+
+  // keyframe: false = delta con solo los campos que cambiaron desde el anterior.
+  // Sin base o con un hueco en seq se pide el estado completo con get_status.
+  mergeStatus(unitId, data) {
+    if (data.keyframe !== false) return data;
+
+    const previous = this.connectedOsmos.get(unitId);
+    if (!previous || typeof previous.seq !== 'number' || data.seq !== previous.seq + 1) {
+      console.warn(`⚠️ Delta de ${unitId} sin base (seq ${data.seq}), pidiendo estado completo`);
+      try {
+        this.sendCommand(unitId, 'get_status', {});
+      } catch (error) {
+        console.warn(`⚠️ No se pudo pedir estado completo a ${unitId}:`, error.message);
+      }
+    }
+
+    const pumps = { ...(previous && previous.pumps) };
+    Object.keys(data.pumps || {}).forEach((pumpKey) => {
+      pumps[pumpKey] = { ...pumps[pumpKey], ...data.pumps[pumpKey] };
+    });
+    return { ...previous, ...data, pumps };
+  }
+
+  handleProbe(unitId, report) {
+    this.osmoProbes.set(unitId, { ...report, receivedAt: new Date() });
+    const rtt = report.rtt || {};
+    const rssi = report.rssi || {};
+    console.log(`📶 Sondeo de ${unitId}: RSSI medio ${rssi.avg} dBm, eco ${rtt.received}/${rtt.sent} (medio ${rtt.avg_ms} ms, máx ${rtt.max_ms} ms), reconexiones ${report.reconnects}`);
+  }
+
+  handlePresence(unitId, state) {
+    // Mensaje retenido vacío = alguien limpió el topic
+    if (state !== 'online' && state !== 'offline') return;
+
+    const online = state === 'online';
+    this.osmoPresence.set(unitId, { online, since: new Date() });
+    if (online) {
+      // Visible ya, sin esperar al próximo status
+      if (!this.connectedOsmos.has(unitId)) {
+        this.connectedOsmos.set(unitId, { unit_id: unitId, status: 'online', lastSeen: new Date() });
+      }
+      console.log(`🟢 ${unitId} online`);
+    } else {
+      this.connectedOsmos.delete(unitId);
+      console.log(`🔴 ${unitId} offline`);
+    }
+    if (typeof this.onPresenceChanged === 'function') {
+      this.onPresenceChanged(unitId, online);
+    }
+  }
+
   sendCommand(unitId, action, params, simulate = false) {
     // ✅ Usar la estructura de comando que espera el Arduino
     const command = {
@@ -230,24 +359,127 @@ class OsmoMQTTClient {
     }
     
     const topic = `motete/director/commands/${unitId}`;
-    this.client.publish(topic, JSON.stringify(command), { qos: 1 });
+    if (this.protocolVersion === 5) {
+      // El id va como correlation data y no en el cuerpo; el broker descarta el comando si vence en cola
+      const { command_id: commandId, timestamp, ...body } = command;
+      this.publishCommand(topic, body, {
+        qos: 1,
+        properties: {
+          responseTopic: `motete/osmo/${unitId}/response`,
+          correlationData: Buffer.from(commandId),
+          messageExpiryInterval: COMMAND_EXPIRY_S
+        }
+      });
+    } else {
+      this.publishCommand(topic, command, { qos: 1 });
+    }
     console.log(`📤 Comando enviado a ${unitId}:`, command);
 
     // ✅ Si es activate_pump y NO estamos en simulación, iniciar cooldown en servidor inmediatamente
-    if (!simulate && action === 'activate_pump') {
-      const pumpId = params?.pump_id;
-      if (typeof pumpId === 'number') {
-        // Duración total basada en config: activación + cooldown
-        const cfg = this.osmoConfigs.get(unitId)?.[`pump_${pumpId}`];
-        const activation = cfg?.activationTime ?? 1000;
-        const cooldown = cfg?.cooldownTime ?? 3000;
-        const total = activation + cooldown;
-        this.startCooldown(unitId, pumpId, total);
-      }
+    this.trackActivation(unitId, action, params);
+    return command.command_id;
+  }
+
+  trackActivation(unitId, action, params) {
+    if (action !== 'activate_pump') return;
+    const pumpId = params?.pump_id;
+    if (typeof pumpId === 'number') {
+      // Duración total basada en config: activación + cooldown
+      const cfg = this.osmoConfigs.get(unitId)?.[`pump_${pumpId}`];
+      const activation = cfg?.activationTime ?? 1000;
+      const cooldown = cfg?.cooldownTime ?? 3000;
+      const total = activation + cooldown;
+      this.startCooldown(unitId, pumpId, total);
     }
+  }
+
+  // Un publish para todo un grupo (deviceConfig.groups en el firmware, "all" por defecto).
+  // La respuesta llega por unidad en motete/osmo/<unit>/response con el mismo command_id.
+  sendGroupCommand(group, action, params) {
+    if (!this.isConnectionHealthy()) {
+      throw new Error('MQTT no conectado o conexión no saludable');
+    }
+
+    const command = {
+      command_id: `grp_${Date.now()}_${Math.random().toString(36).substr(2, 9)}`,
+      action: action,
+      params: params,
+      timestamp: Date.now()
+    };
+    this.publishCommand(`motete/director/group/${group}`, command, { qos: 1 });
+    console.log(`📤 Comando enviado al grupo ${group}:`, command);
     return command.command_id;
   }
 
+  // Bundle: un sub-comando por unidad en un solo publish; "*" vale para las
+  // unidades del grupo sin entrada propia. Cada unidad extrae solo su parte.
+  sendBundle(group, units) {
+    if (!this.isConnectionHealthy()) {
+      throw new Error('MQTT no conectado o conexión no saludable');
+    }
+
+    const bundleId = `bdl_${Date.now()}_${Math.random().toString(36).substr(2, 9)}`;
+    const bundle = { bundle: bundleId, units: {} };
+    const commandIds = {};
+    Object.entries(units).forEach(([unitId, { action, params }]) => {
+      const commandId = `${bundleId}_${unitId}`;
+      bundle.units[unitId] = { command_id: commandId, action, params };
+      commandIds[unitId] = commandId;
+      if (unitId !== '*') this.trackActivation(unitId, action, params);
+    });
+
+    // El seq va en el bundle: cuenta para todas las unidades del grupo
+    this.publishCommand(`motete/director/group/${group}`, bundle, { qos: 1 });
+    console.log(`📦 Bundle ${bundleId} enviado al grupo ${group} (${Object.keys(units).length} unidades)`);
+    return commandIds;
+  }
+
+  // Numera cada comando por topic y lo guarda para reenviarlo si una unidad
+  // pide un hueco. El primer seq sale del reloj: tras reiniciar el director
+  // sigue siendo mayor que el último que vio cada unidad, que toma una nueva base.
+  publishCommand(topic, body, options) {
+    const last = this.commandSeq.get(topic) ?? Math.floor(Date.now() / 10);
+    const seq = ((last + 1) >>> 0) || 1; // 0 = sin seq en el firmware
+    this.commandSeq.set(topic, seq);
+
+    const payload = JSON.stringify({ ...body, seq });
+    if (!this.commandHistory.has(topic)) this.commandHistory.set(topic, []);
+    const history = this.commandHistory.get(topic);
+    history.push({ seq, payload, options });
+    if (history.length > COMMAND_HISTORY) history.shift();
+
+    this.client.publish(topic, payload, options);
+    return seq;
+  }
+
+  // NACK: { topic, from, to }. Se reenvía con el mismo seq; en un grupo las
+  // unidades que ya lo tenían lo descartan como repetido.
+  handleNack(unitId, nack) {
+    const history = this.commandHistory.get(nack.topic) || [];
+    const resent = history.filter((entry) => entry.seq >= nack.from && entry.seq <= nack.to);
+    resent.forEach((entry) => this.client.publish(nack.topic, entry.payload, entry.options));
+
+    const requested = nack.to - nack.from + 1;
+    console.warn(`📮 NACK de ${unitId} en ${nack.topic}: seq ${nack.from}-${nack.to}, reenviados ${resent.length}/${requested}`);
+    if (resent.length < requested) {
+      console.warn(`⚠️ ${requested - resent.length} comandos ya no están en el historial de ${nack.topic}`);
+    }
+  }
+
+  // Parada de emergencia: topic dedicado y payload corto, el firmware lo
+  // reconoce por prefijo en el callback sin parsear JSON.
+  // Sin unitId se detienen todas las unidades.
+  sendStopAll(unitId = null) {
+    if (!this.isConnectionHealthy()) {
+      throw new Error('MQTT no conectado o conexión no saludable');
+    }
+
+    const topic = unitId ? `motete/director/stop/${unitId}` : 'motete/director/stop';
+    this.client.publish(topic, 'stop_all', { qos: 1 });
+    console.log(`🛑 Parada de emergencia enviada a ${unitId || 'todas las unidades'}`);
+    return topic;
+  }
+
   getSimulatedOsmos() {
     console.log('🎭 Devolviendo Osmos simulados');
     return [
@@ -311,6 +543,42 @@ class OsmoMQTTClient {
     return configs;
   }
 
+  getOsmoStats() {
+    const stats = {};
+    this.osmoStats.forEach((data, unitId) => {
+      stats[unitId] = data;
+    });
+    return stats;
+  }
+
+  getOsmoEvents(unitId) {
+    return this.osmoEvents.get(unitId) || [];
+  }
+
+  getOsmoDiscovery() {
+    const discovery = {};
+    this.osmoDiscovery.forEach((data, unitId) => {
+      discovery[unitId] = data;
+    });
+    return discovery;
+  }
+
+  getOsmoProbes() {
+    const probes = {};
+    this.osmoProbes.forEach((data, unitId) => {
+      probes[unitId] = data;
+    });
+    return probes;
+  }
+
+  getOsmoPresence() {
+    const presence = {};
+    this.osmoPresence.forEach((data, unitId) => {
+      presence[unitId] = data;
+    });
+    return presence;
+  }
+
   // ===== Cooldowns (servidor autoritativo) =====
   _getCooldownDurationMs(unitId, pumpId) {
     const cfg = this.osmoConfigs.get(unitId)?.[`pump_${pumpId}`];
@@ -356,6 +624,8 @@ class OsmoMQTTClient {
       const now = Date.now();
       let removed = 0;
       this.connectedOsmos.forEach((osmo, unitId) => {
+        // Con presencia "online" el broker avisa la caída: no hace falta el status periódico
+        if (this.osmoPresence.get(unitId)?.online) return;
         const lastSeenTs = osmo?.lastSeen instanceof Date ? osmo.lastSeen.getTime() : Number(new Date(osmo?.lastSeen).getTime());
         const age = now - (Number.isFinite(lastSeenTs) ? lastSeenTs : 0);
         console.log(`⏱️ Freshness check ${unitId} -> lastSeenTs=${lastSeenTs} age=${age}ms (threshold=${maxAgeMs}ms)`);
@@ -0,0 +1,48 @@
+const dgram = require('dgram');
+
+const MAX_LOG_LINES = 300; // Líneas guardadas por unidad
+
+// Receptor syslog UDP (RFC 3164) para los logs de los Osmos.
+// El firmware envía "<PRI>unitId: [millis N] texto" si logConfig.syslogEnabled.
+class SyslogReceiver {
+  constructor(port = 5514) {
+    this.port = port;
+    this.socket = null;
+    this.logs = new Map(); // unitId -> [{ severity, line, receivedAt }]
+  }
+
+  start() {
+    this.socket = dgram.createSocket('udp4');
+    this.socket.on('message', (msg, rinfo) => this._handle(msg.toString('utf8'), rinfo));
+    this.socket.on('error', (error) => {
+      console.error('❌ Error en receptor syslog:', error.message);
+    });
+    this.socket.bind(this.port, () => {
+      console.log(`📝 Receptor syslog escuchando en UDP ${this.port}`);
+    });
+  }
+
+  _handle(text, rinfo) {
+    const match = /^<(\d+)>([^:]+): (.*)$/s.exec(text);
+    if (!match) return;
+    const severity = Number(match[1]) % 8;
+    const unitId = match[2];
+    const line = match[3];
+
+    const history = this.logs.get(unitId) || [];
+    history.push({ severity, line, from: rinfo.address, receivedAt: new Date() });
+    if (history.length > MAX_LOG_LINES) history.shift();
+    this.logs.set(unitId, history);
+
+    // Errores y advertencias también a la consola del director
+    if (severity <= 4) {
+      console.log(`📝 ${unitId}: ${line}`);
+    }
+  }
+
+  getLogs(unitId) {
+    return this.logs.get(unitId) || [];
+  }
+}
+
+module.exports = SyslogReceiver;